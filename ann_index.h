@@ -0,0 +1,373 @@
+// ann_index.h
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "retrieval.h"
+
+// ---- 近似最近邻索引（IVF + PQ，内积度量）----
+// 离线：k-means 把物品分到 nlist 个倒排桶，桶内残差按 m 个子空间做乘积量化，每个子空间 256 个码字，
+//       每个物品只存 m 字节的编码。整份索引写成一个文件。
+// 在线：mmap 打开（MAP_POPULATE），和 OperatorHolder 一样用 shared_ptr + atomic_store 发布，
+//       正在查询旧索引的线程持有引用，用完后旧索引才 munmap，替换不阻塞查询。
+// 查询：内积可拆成 <q, 中心> + <q, 残差>，残差项的查找表只与 q 有关，每次查询算一次，
+//       选 <q, 中心> 最大的 nprobe 个桶，桶内每个物品只需 m 次查表相加。
+//
+// 文件格式（小端）：
+//   AnnFileHeader (64 字节)
+//   粗聚类中心      nlist x dim        float
+//   PQ 码本         m x 256 x dsub     float
+//   桶偏移          nlist + 1          uint64（起点只保证 4 字节对齐，用 memcpy 读）
+//   物品 id         count              uint32（按桶排列）
+//   PQ 编码         count x m          uint8（与物品 id 同序）
+
+struct AnnFileHeader {
+    char magic[8];  // "HPIVFPQ\0"
+    uint32_t dim;
+    uint32_t nlist;
+    uint32_t m;
+    uint32_t ksub;
+    uint64_t count;
+    uint8_t reserved[32];
+};
+static_assert(sizeof(AnnFileHeader) == 64, "header must stay 64 bytes");
+
+struct AnnBuildParams {
+    uint32_t nlist = 256;
+    uint32_t m = 16;               // 子空间数，须整除 dim
+    size_t train_samples = 20000;  // 训练用样本数
+    int kmeans_iters = 8;
+    uint32_t seed = 1;
+};
+
+namespace ann_detail {
+
+inline float l2_sqr(const float* a, const float* b, uint32_t dim) {
+    float s = 0;
+    for (uint32_t d = 0; d < dim; ++d) {
+        float diff = a[d] - b[d];
+        s += diff * diff;
+    }
+    return s;
+}
+
+inline uint32_t nearest(const float* x, const float* centroids, uint32_t k, uint32_t dim) {
+    uint32_t best = 0;
+    float best_dist = FLT_MAX;
+    for (uint32_t c = 0; c < k; ++c) {
+        float dist = l2_sqr(x, centroids + size_t(c) * dim, dim);
+        if (dist < best_dist) {
+            best_dist = dist;
+            best = c;
+        }
+    }
+    return best;
+}
+
+// 朴素 Lloyd k-means；样本比 k 少时重复使用样本
+inline std::vector<float> kmeans(const std::vector<float>& samples, uint32_t dim, uint32_t k, int iters,
+                                 std::mt19937& rng) {
+    size_t n = samples.size() / dim;
+    std::vector<float> centroids(size_t(k) * dim);
+    for (uint32_t c = 0; c < k; ++c) {
+        size_t pick = rng() % n;
+        std::copy(samples.begin() + pick * dim, samples.begin() + (pick + 1) * dim, centroids.begin() + size_t(c) * dim);
+    }
+    std::vector<uint32_t> assign(n);
+    std::vector<double> sums(size_t(k) * dim);
+    std::vector<size_t> counts(k);
+    for (int it = 0; it < iters; ++it) {
+        for (size_t i = 0; i < n; ++i) assign[i] = nearest(samples.data() + i * dim, centroids.data(), k, dim);
+        std::fill(sums.begin(), sums.end(), 0.0);
+        std::fill(counts.begin(), counts.end(), 0);
+        for (size_t i = 0; i < n; ++i) {
+            counts[assign[i]]++;
+            for (uint32_t d = 0; d < dim; ++d) sums[size_t(assign[i]) * dim + d] += samples[i * dim + d];
+        }
+        for (uint32_t c = 0; c < k; ++c) {
+            if (counts[c] == 0) {  // 空簇：重新随机取一个样本
+                size_t pick = rng() % n;
+                std::copy(samples.begin() + pick * dim, samples.begin() + (pick + 1) * dim,
+                          centroids.begin() + size_t(c) * dim);
+                continue;
+            }
+            for (uint32_t d = 0; d < dim; ++d) centroids[size_t(c) * dim + d] = float(sums[size_t(c) * dim + d] / counts[c]);
+        }
+    }
+    return centroids;
+}
+
+}  // namespace ann_detail
+
+// 离线构建并写文件
+inline bool build_ann_index(const std::string& path, const float* rows, size_t count, uint32_t dim,
+                            const AnnBuildParams& params) {
+    using namespace ann_detail;
+    const uint32_t ksub = 256;
+    if (count == 0 || params.m == 0 || dim % params.m != 0 || params.nlist == 0) {
+        std::cerr << "[ANN] 参数无效: dim=" << dim << " m=" << params.m << std::endl;
+        return false;
+    }
+    const uint32_t dsub = dim / params.m;
+    std::mt19937 rng(params.seed);
+
+    // 1. 训练粗聚类中心
+    size_t train_n = std::min(count, params.train_samples);
+    std::vector<float> train(train_n * dim);
+    for (size_t i = 0; i < train_n; ++i) {
+        size_t pick = train_n == count ? i : rng() % count;
+        std::copy(rows + pick * dim, rows + (pick + 1) * dim, train.begin() + i * dim);
+    }
+    std::vector<float> coarse = kmeans(train, dim, params.nlist, params.kmeans_iters, rng);
+
+    // 2. 训练各子空间的 PQ 码本（在训练样本的残差上）
+    for (size_t i = 0; i < train_n; ++i) {
+        uint32_t c = nearest(train.data() + i * dim, coarse.data(), params.nlist, dim);
+        for (uint32_t d = 0; d < dim; ++d) train[i * dim + d] -= coarse[size_t(c) * dim + d];
+    }
+    std::vector<float> codebooks(size_t(params.m) * ksub * dsub);
+    for (uint32_t j = 0; j < params.m; ++j) {
+        std::vector<float> sub(train_n * dsub);
+        for (size_t i = 0; i < train_n; ++i) {
+            std::copy(train.begin() + i * dim + j * dsub, train.begin() + i * dim + (j + 1) * dsub, sub.begin() + i * dsub);
+        }
+        std::vector<float> book = kmeans(sub, dsub, ksub, params.kmeans_iters, rng);
+        std::copy(book.begin(), book.end(), codebooks.begin() + size_t(j) * ksub * dsub);
+    }
+
+    // 3. 全量分桶 + 编码
+    std::vector<uint32_t> list_of(count);
+    std::vector<uint8_t> codes_by_item(count * params.m);
+    std::vector<float> residual(dim);
+    for (size_t i = 0; i < count; ++i) {
+        const float* x = rows + i * dim;
+        uint32_t c = nearest(x, coarse.data(), params.nlist, dim);
+        list_of[i] = c;
+        for (uint32_t d = 0; d < dim; ++d) residual[d] = x[d] - coarse[size_t(c) * dim + d];
+        for (uint32_t j = 0; j < params.m; ++j) {
+            codes_by_item[i * params.m + j] =
+                uint8_t(nearest(residual.data() + j * dsub, codebooks.data() + size_t(j) * ksub * dsub, ksub, dsub));
+        }
+    }
+    std::vector<uint64_t> offsets(params.nlist + 1, 0);
+    for (size_t i = 0; i < count; ++i) offsets[list_of[i] + 1]++;
+    for (uint32_t l = 0; l < params.nlist; ++l) offsets[l + 1] += offsets[l];
+    std::vector<uint64_t> cursor(offsets.begin(), offsets.end() - 1);
+    std::vector<uint32_t> ids(count);
+    std::vector<uint8_t> codes(count * params.m);
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t pos = cursor[list_of[i]]++;
+        ids[pos] = uint32_t(i);
+        std::copy(codes_by_item.begin() + i * params.m, codes_by_item.begin() + (i + 1) * params.m,
+                  codes.begin() + pos * params.m);
+    }
+
+    // 4. 写文件
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) return false;
+    AnnFileHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, "HPIVFPQ", 8);
+    h.dim = dim;
+    h.nlist = params.nlist;
+    h.m = params.m;
+    h.ksub = ksub;
+    h.count = count;
+    bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1;
+    ok = ok && std::fwrite(coarse.data(), sizeof(float), coarse.size(), f) == coarse.size();
+    ok = ok && std::fwrite(codebooks.data(), sizeof(float), codebooks.size(), f) == codebooks.size();
+    ok = ok && std::fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), f) == offsets.size();
+    ok = ok && std::fwrite(ids.data(), sizeof(uint32_t), ids.size(), f) == ids.size();
+    ok = ok && std::fwrite(codes.data(), 1, codes.size(), f) == codes.size();
+    return std::fclose(f) == 0 && ok;
+}
+
+class AnnIndex {
+public:
+    ~AnnIndex() {
+        if (base_) munmap(base_, size_);
+    }
+
+    static std::shared_ptr<AnnIndex> open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "[ANN] 无法打开: " << path << std::endl;
+            return nullptr;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            std::cerr << "[ANN] fstat 失败: " << path << std::endl;
+            ::close(fd);
+            return nullptr;
+        }
+        std::shared_ptr<AnnIndex> index(new AnnIndex());
+        index->size_ = size_t(st.st_size);
+        void* base = index->size_ >= sizeof(AnnFileHeader)
+                         ? mmap(nullptr, index->size_, PROT_READ, MAP_SHARED | MAP_POPULATE, fd, 0)
+                         : MAP_FAILED;
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            std::cerr << "[ANN] mmap 失败: " << path << std::endl;
+            return nullptr;
+        }
+        index->base_ = base;
+        index->path_ = path;
+
+        const AnnFileHeader* h = static_cast<const AnnFileHeader*>(base);
+        if (std::memcmp(h->magic, "HPIVFPQ", 8) != 0 || h->ksub != 256 || h->m == 0 || h->dim == 0 ||
+            h->dim % h->m != 0 || h->nlist == 0) {
+            std::cerr << "[ANN] 文件格式错误: " << path << std::endl;
+            return nullptr;
+        }
+        index->header_ = *h;
+        index->dsub_ = h->dim / h->m;
+
+        // 按段依次切出各数组：每段先用除法检查 n * elem 不超过剩余字节，头部字段再大也不会溢出
+        const char* file = static_cast<const char*>(base);
+        size_t offset = sizeof(AnnFileHeader);
+        auto take = [&](uint64_t n, uint64_t elem, const char** out) {
+            if (elem != 0 && n > (index->size_ - offset) / elem) return false;
+            *out = file + offset;
+            offset += size_t(n * elem);
+            return true;
+        };
+        const char *coarse, *codebooks, *offsets, *ids, *codes;
+        if (!take(h->nlist, uint64_t(h->dim) * sizeof(float), &coarse) ||
+            !take(uint64_t(h->m) * h->ksub, uint64_t(index->dsub_) * sizeof(float), &codebooks) ||
+            !take(uint64_t(h->nlist) + 1, sizeof(uint64_t), &offsets) ||
+            !take(h->count, sizeof(uint32_t), &ids) || !take(h->count, h->m, &codes)) {
+            std::cerr << "[ANN] 文件被截断: " << path << std::endl;
+            return nullptr;
+        }
+        index->coarse_ = reinterpret_cast<const float*>(coarse);
+        index->codebooks_ = reinterpret_cast<const float*>(codebooks);
+        index->offsets_ = offsets;
+        index->ids_ = reinterpret_cast<const uint32_t*>(ids);
+        index->codes_ = reinterpret_cast<const uint8_t*>(codes);
+
+        // 桶边界从 0 单调不减到 count、物品 id 都小于 count，search 和 refine 才不会越界
+        bool valid = index->list_offset(0) == 0 && index->list_offset(h->nlist) == h->count;
+        for (uint32_t l = 0; valid && l < h->nlist; ++l) valid = index->list_offset(l) <= index->list_offset(l + 1);
+        for (uint64_t i = 0; valid && i < h->count; ++i) valid = index->ids_[i] < h->count;
+        if (!valid) {
+            std::cerr << "[ANN] 桶偏移或物品 id 越界: " << path << std::endl;
+            return nullptr;
+        }
+        return index;
+    }
+
+    uint32_t dim() const { return header_.dim; }
+    uint32_t nlist() const { return header_.nlist; }
+    size_t count() const { return header_.count; }
+    const std::string& path() const { return path_; }
+
+    // 内积 top-N，nprobe 越大召回越高、越慢。
+    // 传入 refine（同一批物品的 float32 embedding）时，先按 PQ 近似分取 topn * refine_factor 个候选，
+    // 再用精确内积重排，弥补 PQ 量化误差。
+    std::vector<RetrievedItem> search(const float* q, size_t topn, uint32_t nprobe,
+                                      const EmbeddingIndex* refine = nullptr, size_t refine_factor = 8) const {
+        if (refine && (refine->type() != EmbeddingType::Float32 || refine->dim() != header_.dim ||
+                       refine->count() != count())) {
+            refine = nullptr;  // 与索引不匹配时不做重排
+        }
+        const size_t final_n = std::min(topn, count());
+        topn = refine ? std::min(count(), final_n * std::max<size_t>(refine_factor, 1)) : final_n;
+        const uint32_t dim = header_.dim, m = header_.m, ksub = header_.ksub;
+        nprobe = std::max(1u, std::min(nprobe, header_.nlist));
+        if (topn == 0) return {};
+
+        // 1. 查找表：lut[j][k] = <q 的第 j 段, 码字 k>
+        std::vector<float> lut(size_t(m) * ksub);
+        for (uint32_t j = 0; j < m; ++j) {
+            const float* qj = q + j * dsub_;
+            for (uint32_t k = 0; k < ksub; ++k) {
+                const float* cw = codebooks_ + (size_t(j) * ksub + k) * dsub_;
+                float s = 0;
+                for (uint32_t d = 0; d < dsub_; ++d) s += qj[d] * cw[d];
+                lut[size_t(j) * ksub + k] = s;
+            }
+        }
+
+        // 2. 选 <q, 中心> 最大的 nprobe 个桶
+        std::vector<std::pair<float, uint32_t>> lists(header_.nlist);
+        for (uint32_t l = 0; l < header_.nlist; ++l) {
+            const float* c = coarse_ + size_t(l) * dim;
+            float s = 0;
+            for (uint32_t d = 0; d < dim; ++d) s += q[d] * c[d];
+            lists[l] = std::make_pair(s, l);
+        }
+        std::partial_sort(lists.begin(), lists.begin() + nprobe, lists.end(),
+                          [](const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b) {
+                              return a.first > b.first;
+                          });
+
+        // 3. 扫描桶内编码，查表累加
+        auto cmp = [](const RetrievedItem& a, const RetrievedItem& b) { return a.score > b.score; };
+        std::vector<RetrievedItem> heap;
+        heap.reserve(topn + 1);
+        for (uint32_t p = 0; p < nprobe; ++p) {
+            const uint32_t l = lists[p].second;
+            const float base_score = lists[p].first;
+            const uint64_t end = list_offset(l + 1);
+            for (uint64_t pos = list_offset(l); pos < end; ++pos) {
+                const uint8_t* code = codes_ + pos * m;
+                float s = base_score;
+                for (uint32_t j = 0; j < m; ++j) s += lut[size_t(j) * ksub + code[j]];
+                if (heap.size() < topn) {
+                    heap.push_back(RetrievedItem{int(ids_[pos]), s});
+                    std::push_heap(heap.begin(), heap.end(), cmp);
+                } else if (s > heap.front().score) {
+                    std::pop_heap(heap.begin(), heap.end(), cmp);
+                    heap.back() = RetrievedItem{int(ids_[pos]), s};
+                    std::push_heap(heap.begin(), heap.end(), cmp);
+                }
+            }
+        }
+        if (refine) {
+            for (RetrievedItem& item : heap) {
+                const float* row = refine->f32_rows() + size_t(item.item_id) * dim;
+                float s = 0;
+                for (uint32_t d = 0; d < dim; ++d) s += q[d] * row[d];
+                item.score = s;
+            }
+        }
+        std::sort(heap.begin(), heap.end(), [](const RetrievedItem& a, const RetrievedItem& b) { return a.score > b.score; });
+        if (heap.size() > final_n) heap.resize(final_n);
+        return heap;
+    }
+
+private:
+    AnnIndex() = default;
+
+    // 桶偏移段前面是 float 数组，nlist * dim 为奇数时起点不是 8 字节对齐，不能直接当 uint64_t* 解引用
+    uint64_t list_offset(uint32_t l) const {
+        uint64_t v;
+        std::memcpy(&v, offsets_ + size_t(l) * sizeof(uint64_t), sizeof(v));
+        return v;
+    }
+
+    void* base_ = nullptr;
+    size_t size_ = 0;
+    std::string path_;
+    AnnFileHeader header_;
+    uint32_t dsub_ = 0;
+    const float* coarse_ = nullptr;
+    const float* codebooks_ = nullptr;
+    const char* offsets_ = nullptr;  // nlist + 1 个 uint64，经 list_offset 读取
+    const uint32_t* ids_ = nullptr;
+    const uint8_t* codes_ = nullptr;
+};
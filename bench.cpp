@@ -0,0 +1,1188 @@
+// bench.cpp
+// 性能基准：./bench <名称> [参数...]，不带参数列出全部基准
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "conformance.h"
+#include "diversity.h"
+#include "gather.h"
+#include "huge_pages.h"
+#include "ann_index.h"
+#include "eligibility.h"
+#include "feature_client.h"
+#include "left_right.h"
+#include "operator_holder.h"
+#include "param_file.h"
+#include "retrieval.h"
+#include "smt_pipeline.h"
+#include "timeseries.h"
+#include "worker_pool.h"
+
+using BenchClock = std::chrono::steady_clock;
+
+static double elapsed_seconds(BenchClock::time_point since) {
+    return std::chrono::duration<double>(BenchClock::now() - since).count();
+}
+
+// ---- 路由表读取：left-right vs shared_ptr atomic_load（g_operator 的模式）----
+// 参数：[读线程数=4] [写间隔us=100] [时长ms=1000]
+static int bench_left_right(int argc, char** argv) {
+    const int readers = argc > 0 ? std::atoi(argv[0]) : 4;
+    const int write_interval_us = argc > 1 ? std::atoi(argv[1]) : 100;
+    const int duration_ms = argc > 2 ? std::atoi(argv[2]) : 1000;
+
+    std::cout << "读线程: " << readers << " | 写间隔: " << write_interval_us << "us | 时长: " << duration_ms << "ms\n";
+
+    // 两种实现跑同样的负载：读者不停 route，写者按间隔改权重
+    auto run = [&](const char* label, std::function<int(uint64_t)> read_fn, std::function<void(uint64_t)> write_fn) {
+        std::atomic<bool> stop{false};
+        std::atomic<uint64_t> total_reads{0};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < readers; ++t) {
+            threads.emplace_back([&, t] {
+                uint64_t reads = 0, sink = 0, h = uint64_t(t) * 0x9E3779B97F4A7C15ULL;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    sink += read_fn(h += 0x9E3779B97F4A7C15ULL);
+                    reads++;
+                }
+                total_reads += reads + (sink == uint64_t(-1));
+            });
+        }
+
+        uint64_t writes = 0;
+        double max_write_us = 0, total_write_us = 0;
+        auto start = BenchClock::now();
+        while (elapsed_seconds(start) * 1000 < duration_ms) {
+            auto w0 = BenchClock::now();
+            write_fn(++writes);
+            double cost = elapsed_seconds(w0) * 1e6;
+            total_write_us += cost;
+            if (cost > max_write_us) max_write_us = cost;
+            std::this_thread::sleep_for(std::chrono::microseconds(write_interval_us));
+        }
+        stop = true;
+        for (auto& th : threads) th.join();
+        double seconds = elapsed_seconds(start);
+
+        std::cout << std::setw(22) << label << " | 读: " << std::fixed << std::setprecision(1)
+                  << total_reads.load() / seconds / 1e6 << " M/s"
+                  << " | 写: " << writes << " 次, 平均 " << std::setprecision(2) << total_write_us / writes
+                  << "us, 最大 " << max_write_us << "us\n";
+    };
+
+    LeftRight<RoutingTable> lr;
+    run("left-right",
+        [&](uint64_t h) { return lr.read([&](const RoutingTable& t) { return t.route(int(h % 80), h); }); },
+        [&](uint64_t i) {
+            lr.modify([&](RoutingTable& t) {
+                t.epoch = i;
+                t.slot_weight[1] = double(i % 10) / 10.0;
+            });
+        });
+
+    std::shared_ptr<RoutingTable> table = std::make_shared<RoutingTable>();
+    run("shared_ptr atomic_load",
+        [&](uint64_t h) { return std::atomic_load(&table)->route(int(h % 80), h); },
+        [&](uint64_t i) {
+            auto next = std::make_shared<RoutingTable>(*std::atomic_load(&table));  // 写时复制
+            next->epoch = i;
+            next->slot_weight[1] = double(i % 10) / 10.0;
+            std::atomic_store(&table, next);
+        });
+    return 0;
+}
+
+// ---- 列裁剪：宽特征表下，全量物化 vs 只 gather 算子声明的列 ----
+// 参数：[物品数=200000] [宽列数=64] [读取列数=2] [batch 数=2000]
+static int bench_projection(int argc, char** argv) {
+    const size_t items = argc > 0 ? std::strtoull(argv[0], nullptr, 10) : 200000;
+    const int wide = argc > 1 ? std::atoi(argv[1]) : 64;
+    const int used = argc > 2 ? std::atoi(argv[2]) : 2;
+    const int batches = argc > 3 ? std::atoi(argv[3]) : 2000;
+    const size_t batch_size = 1000;
+
+    ItemCatalog catalog;
+    catalog.item_feature.resize(items, 0.5);
+    for (int c = 0; c < wide; ++c) {
+        catalog.column_names.push_back("item_f" + std::to_string(c));
+        catalog.columns.emplace_back(items, double(c));
+    }
+    std::cout << "物品: " << items << " | 宽列: " << wide << " | 算子读取: " << used
+              << " | batch: " << batches << " x " << batch_size << "\n";
+
+    std::mt19937 rng(42);
+    std::vector<int> item_ids(batch_size);
+
+    auto run = [&](const char* label, const ColumnProjection& projection) {
+        FeatureBatchBuffer buf;
+        double sink = 0;
+        rng.seed(42);
+        auto start = BenchClock::now();
+        for (int b = 0; b < batches; ++b) {
+            for (auto& id : item_ids) id = int(rng() % items);
+            gather_features(projection, catalog, UserContext{1, 0.5}, item_ids.data(), batch_size, buf);
+            FeatureBatch view = buf.view();
+            sink += view.item_feature ? view.item_feature[0] : 0;
+        }
+        double seconds = elapsed_seconds(start);
+        double bytes = double(gathered_bytes(projection, batch_size)) * batches;
+        std::cout << std::setw(10) << label << " | 耗时: " << std::fixed << std::setprecision(1) << seconds * 1000
+                  << "ms | 搬运: " << std::setprecision(2) << bytes / 1e9 << "GB | 吞吐: "
+                  << batches * batch_size / seconds / 1e6 << " M 行/s" << (sink < 0 ? " " : "") << "\n";
+        return seconds;
+    };
+
+    ColumnProjection full;
+    for (int c = 0; c < wide; ++c) full.catalog_columns.push_back(size_t(c));
+    ColumnProjection projected;
+    projected.base_mask = COL_USER_FEATURE | COL_ITEM_FEATURE;
+    for (int c = 0; c < used && c < wide; ++c) projected.catalog_columns.push_back(size_t(c));
+
+    double t_full = run("全量物化", full);
+    double t_proj = run("列裁剪", projected);
+    std::cout << "加速比: " << std::setprecision(2) << t_full / t_proj << "x\n";
+    return 0;
+}
+
+// ---- 暴力检索：float32 / int8 全量内积 top-N，int8 相对 float32 的召回 ----
+// 参数：[物品数=1000000] [维度=64] [线程数=硬件线程数] [top-N=100] [查询数=20]
+static int bench_retrieval(int argc, char** argv) {
+    const size_t items = argc > 0 ? std::strtoull(argv[0], nullptr, 10) : 1000000;
+    const uint32_t dim = argc > 1 ? uint32_t(std::atoi(argv[1])) : 64;
+    const int threads = argc > 2 ? std::atoi(argv[2]) : std::max(1, int(std::thread::hardware_concurrency()));
+    const size_t topn = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 100;
+    const int queries = argc > 4 ? std::atoi(argv[4]) : 20;
+
+    std::cout << "物品: " << items << " | 维度: " << dim << " | 线程: " << threads << " | top-N: " << topn
+              << " | AVX2: " << cpu_has_avx2() << " AVX-512: " << cpu_has_avx512() << "\n";
+    std::mt19937 rng(7);
+    std::normal_distribution<float> dist(0, 1);
+    std::vector<float> rows(items * dim);
+    for (auto& v : rows) v = dist(rng);
+    const std::string f32_path = "/tmp/bench_emb_f32.bin", i8_path = "/tmp/bench_emb_i8.bin";
+    if (!write_embedding_file(f32_path, EmbeddingType::Float32, dim, rows.data(), items) ||
+        !write_embedding_file(i8_path, EmbeddingType::Int8, dim, rows.data(), items)) {
+        std::cerr << "写 embedding 文件失败\n";
+        return 1;
+    }
+    rows.clear();
+    rows.shrink_to_fit();
+
+    std::vector<std::vector<float>> users(queries, std::vector<float>(dim));
+    for (auto& u : users) for (auto& v : u) v = dist(rng);
+
+    std::vector<std::vector<RetrievedItem>> exact;
+    for (const std::string& path : {f32_path, i8_path}) {
+        auto index = EmbeddingIndex::open(path);
+        if (!index) return 1;
+        double total_ms = 0, worst_ms = 0, recall = 0;
+        for (int q = 0; q < queries; ++q) {
+            auto start = BenchClock::now();
+            auto result = retrieve_topn(*index, users[q].data(), topn, threads);
+            double ms = elapsed_seconds(start) * 1000;
+            total_ms += ms;
+            worst_ms = std::max(worst_ms, ms);
+            if (index->type() == EmbeddingType::Float32) {
+                exact.push_back(result);
+            } else {
+                size_t hit = 0;
+                for (const auto& r : result) {
+                    for (const auto& e : exact[q]) hit += (e.item_id == r.item_id);
+                }
+                recall += double(hit) / topn;
+            }
+        }
+        double bytes = double(index->count()) * dim * (index->type() == EmbeddingType::Float32 ? 4 : 1);
+        std::cout << std::setw(8) << (index->type() == EmbeddingType::Float32 ? "float32" : "int8")
+                  << " | 平均: " << std::fixed << std::setprecision(2) << total_ms / queries << "ms"
+                  << " | 最差: " << worst_ms << "ms | 扫描: " << std::setprecision(1)
+                  << bytes / (total_ms / queries / 1000) / 1e9 << " GB/s";
+        if (index->type() == EmbeddingType::Int8) std::cout << " | recall@" << topn << ": " << std::setprecision(3) << recall / queries;
+        std::cout << "\n";
+    }
+    std::remove(f32_path.c_str());
+    std::remove(i8_path.c_str());
+    return 0;
+}
+
+// ---- ANN：IVF-PQ 在不同 nprobe 下的 recall@K 与延迟，真值来自 float32 暴力检索 ----
+// 参数：[物品数=200000] [维度=64] [nlist=256] [m=16] [K=10] [查询数=200]
+static int bench_ann(int argc, char** argv) {
+    const size_t items = argc > 0 ? std::strtoull(argv[0], nullptr, 10) : 200000;
+    const uint32_t dim = argc > 1 ? uint32_t(std::atoi(argv[1])) : 64;
+    AnnBuildParams params;
+    params.nlist = argc > 2 ? uint32_t(std::atoi(argv[2])) : 256;
+    params.m = argc > 3 ? uint32_t(std::atoi(argv[3])) : 16;
+    const size_t k = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 10;
+    const int queries = argc > 5 ? std::atoi(argv[5]) : 200;
+
+    // 带簇结构的合成数据，更接近真实 embedding 分布
+    std::mt19937 rng(11);
+    std::normal_distribution<float> dist(0, 1);
+    const size_t clusters = 1000;
+    std::vector<float> centers(clusters * dim);
+    for (auto& v : centers) v = dist(rng);
+    std::vector<float> rows(items * dim);
+    for (size_t i = 0; i < items; ++i) {
+        size_t c = rng() % clusters;
+        for (uint32_t d = 0; d < dim; ++d) rows[i * dim + d] = centers[c * dim + d] + 0.3f * dist(rng);
+    }
+    // 查询向量同样落在数据分布附近（用户与其兴趣簇相近）
+    std::vector<std::vector<float>> users(queries, std::vector<float>(dim));
+    for (auto& u : users) {
+        size_t c = rng() % clusters;
+        for (uint32_t d = 0; d < dim; ++d) u[d] = centers[c * dim + d] + 0.3f * dist(rng);
+    }
+
+    const std::string ann_path = "/tmp/bench_ann.bin", f32_path = "/tmp/bench_ann_f32.bin";
+    auto build_start = BenchClock::now();
+    if (!build_ann_index(ann_path, rows.data(), items, dim, params) ||
+        !write_embedding_file(f32_path, EmbeddingType::Float32, dim, rows.data(), items)) {
+        std::cerr << "构建索引失败\n";
+        return 1;
+    }
+    std::cout << "物品: " << items << " | 维度: " << dim << " | nlist: " << params.nlist << " | m: " << params.m
+              << " | 构建: " << std::fixed << std::setprecision(1) << elapsed_seconds(build_start) << "s\n";
+
+    auto exact_index = EmbeddingIndex::open(f32_path);
+    auto ann = AnnIndex::open(ann_path);
+    if (!exact_index || !ann) return 1;
+
+    std::vector<std::vector<RetrievedItem>> truth(queries);
+    auto exact_start = BenchClock::now();
+    for (int q = 0; q < queries; ++q) truth[q] = retrieve_topn(*exact_index, users[q].data(), k, 1);
+    std::cout << std::setw(10) << "暴力" << " | recall@" << k << ": 1.000 | 平均: " << std::setprecision(3)
+              << elapsed_seconds(exact_start) * 1000 / queries << "ms\n";
+
+    for (int refine = 0; refine <= 1; ++refine) {
+        std::cout << (refine ? "-- PQ 候选 + float32 精排 (x8) --\n" : "-- 纯 PQ 近似分 --\n");
+        for (uint32_t nprobe = 1; nprobe <= params.nlist && nprobe <= 128; nprobe *= 2) {
+            double recall = 0;
+            auto start = BenchClock::now();
+            std::vector<std::vector<RetrievedItem>> results(queries);
+            for (int q = 0; q < queries; ++q) {
+                results[q] = ann->search(users[q].data(), k, nprobe, refine ? exact_index.get() : nullptr);
+            }
+            double ms = elapsed_seconds(start) * 1000 / queries;
+            for (int q = 0; q < queries; ++q) {
+                size_t hit = 0;
+                for (const auto& r : results[q]) {
+                    for (const auto& t : truth[q]) hit += (r.item_id == t.item_id);
+                }
+                recall += double(hit) / k;
+            }
+            std::cout << std::setw(6) << "nprobe=" << std::setw(3) << nprobe << " | recall@" << k << ": "
+                      << std::setprecision(3) << recall / queries << " | 平均: " << ms << "ms\n";
+        }
+    }
+    std::remove(ann_path.c_str());
+    std::remove(f32_path.c_str());
+    return 0;
+}
+
+// ---- 资格过滤：合并后的 roaring 位图查表 vs 逐条规则查哈希集合 ----
+// 参数：[物品全集=10000000] [batch大小=10000] [batch数=200]
+static int bench_eligibility(int argc, char** argv) {
+    const uint32_t universe = argc > 0 ? uint32_t(std::strtoul(argv[0], nullptr, 10)) : 10000000;
+    const size_t batch = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000;
+    const int batches = argc > 2 ? std::atoi(argv[2]) : 200;
+
+    // 地域：按块成片可见（稠密，位图容器）；库存：约 90% 有货；黑名单：约 0.1%（稀疏，数组容器）
+    std::mt19937 rng(7);
+    std::vector<uint32_t> region, in_stock, blocked;
+    for (uint32_t id = 0; id < universe; ++id) {
+        if (((id >> 16) % 3 != 0) || rng() % 8 == 0) region.push_back(id);
+        if (rng() % 10 != 0) in_stock.push_back(id);
+        if (rng() % 1000 == 0) blocked.push_back(id);
+    }
+    std::vector<EligibilityRule> rules = {
+        {"region", false, RoaringBitmap::from_ids(region)},
+        {"in_stock", false, RoaringBitmap::from_ids(in_stock)},
+        {"blocklist", true, RoaringBitmap::from_ids(blocked)},
+    };
+    auto start = BenchClock::now();
+    auto snapshot = build_eligibility(rules, 1);
+    double build_ms = elapsed_seconds(start) * 1000;
+    size_t raw_bytes = (region.size() + in_stock.size() + blocked.size()) * sizeof(uint32_t);
+    std::cout << "全集: " << universe << " | 可用: " << snapshot->eligible.cardinality() << " | 容器: "
+              << snapshot->eligible.num_containers() << " (位图 " << snapshot->eligible.num_bitmap_containers()
+              << ") | 位图: " << snapshot->eligible.memory_bytes() / 1024 << "KB (原始 id 列表 " << raw_bytes / 1024
+              << "KB) | 合并: " << std::fixed << std::setprecision(2) << build_ms << "ms\n";
+
+    std::vector<std::vector<int>> candidates(batches, std::vector<int>(batch));
+    for (auto& b : candidates) for (auto& id : b) id = int(rng() % universe);
+
+    std::vector<int> out(batch);
+    size_t kept = 0;
+    start = BenchClock::now();
+    for (const auto& b : candidates) kept += filter_item_ids(*snapshot, b.data(), b.size(), out.data());
+    double roaring_s = elapsed_seconds(start);
+
+    std::unordered_set<uint32_t> region_set(region.begin(), region.end()), stock_set(in_stock.begin(), in_stock.end()),
+        block_set(blocked.begin(), blocked.end());
+    size_t kept_naive = 0;
+    start = BenchClock::now();
+    for (const auto& b : candidates) {
+        size_t n = 0;
+        for (int id : b) {
+            out[n] = id;
+            n += region_set.count(uint32_t(id)) && stock_set.count(uint32_t(id)) && !block_set.count(uint32_t(id));
+        }
+        kept_naive += n;
+    }
+    double naive_s = elapsed_seconds(start);
+
+    const double total = double(batch) * batches;
+    std::cout << "  roaring | " << std::setprecision(1) << roaring_s * 1e9 / total << " ns/候选 | 保留率: "
+              << std::setprecision(3) << kept / total << "\n";
+    std::cout << " 哈希集合 | " << std::setprecision(1) << naive_s * 1e9 / total << " ns/候选 | 保留率: "
+              << std::setprecision(3) << kept_naive / total << (kept == kept_naive ? "" : "  (结果不一致!)") << "\n";
+    return kept == kept_naive ? 0 : 1;
+}
+
+// ---- 算子一致性 + 性能：对拍各批量入口、并发调用，记录标准 batch 下的吞吐/延迟并与上次比较 ----
+// 参数：<算子.so> [结果文件=conformance_results.tsv] [回退阈值=0.2]
+static int bench_conformance(int argc, char** argv) {
+    if (argc < 1) {
+        std::cerr << "需要算子 .so 路径\n";
+        return 1;
+    }
+    const std::string so_file = argv[0];
+    const std::string results = argc > 1 ? argv[1] : "conformance_results.tsv";
+    const double threshold = argc > 2 ? std::atof(argv[2]) : 0.2;
+    auto holder = load_operator(so_file);
+    if (!holder) return 1;
+    const std::string op_name = holder->op->name();
+    std::cout << "算子: " << op_name << " (" << so_file << ")\n";
+
+    ConformanceOptions options;
+    ConformanceReport report = run_conformance(holder->op, options);
+    for (const auto& check : report.checks) {
+        std::cout << (check.passed ? "  ✅ " : "  ❌ ") << std::setw(32) << std::left << check.name
+                  << " 最大相对误差: " << std::scientific << std::setprecision(2) << check.max_error
+                  << std::defaultfloat << (check.detail.empty() ? "" : "  ") << check.detail << "\n";
+    }
+    if (!report.passed()) {
+        std::cout << "一致性检查失败，跳过性能测量\n";
+        return 1;
+    }
+
+    // 少于 3 次历史记录时只打印变化不判定：单次记录分不清是噪声还是回退
+    const size_t kMinBaselineRuns = 3;
+    auto previous = load_previous_throughput(results, op_name);
+    auto baseline = [&](const PerfRecord& r) -> const PerfBaseline* {
+        auto it = previous.find(r.entry + "@" + std::to_string(r.batch));
+        return it != previous.end() && it->second.items_per_sec > 0 ? &it->second : nullptr;
+    };
+    // 本次各轮中位数 vs 最近几次记录的中位数；容差再加上本次各轮与历次记录中较大的波动，
+    // 小 batch 和嘈杂机器上的测量噪声不会被当成回退
+    auto regressed = [&](const PerfRecord& r) {
+        const PerfBaseline* b = baseline(r);
+        return b && b->runs >= kMinBaselineRuns &&
+               r.items_per_sec / b->items_per_sec - 1.0 < -(threshold + std::max(r.spread, b->spread));
+    };
+
+    const std::vector<Feature> inputs = conformance_inputs(options.rows);
+    auto records = measure_entry_points(holder->op, inputs);
+    // 疑似回退的条目用更多轮次复测，以复测结果为准，排除测量期间的短暂抖动
+    if (std::any_of(records.begin(), records.end(), regressed)) {
+        auto confirm = measure_entry_points(holder->op, inputs, 20, 15);
+        for (size_t i = 0; i < records.size() && i < confirm.size(); ++i) {
+            if (regressed(records[i])) records[i] = confirm[i];
+        }
+    }
+
+    int regressions = 0;
+    std::cout << std::right << std::setw(14) << "入口" << std::setw(7) << "batch" << std::setw(14) << "条/s"
+              << std::setw(10) << "p50(us)" << std::setw(10) << "p99(us)" << "  对比最近几次\n";
+    for (const auto& r : records) {
+        std::cout << std::setw(14) << r.entry << std::setw(7) << r.batch << std::fixed << std::setprecision(0)
+                  << std::setw(14) << r.items_per_sec << std::setprecision(2) << std::setw(10) << r.p50_us
+                  << std::setw(10) << r.p99_us;
+        if (const PerfBaseline* b = baseline(r)) {
+            const bool bad = regressed(r);
+            regressions += bad;
+            std::cout << "  " << std::showpos << std::setprecision(1) << (r.items_per_sec / b->items_per_sec - 1.0) * 100
+                      << "%" << std::noshowpos << " (波动 " << std::max(r.spread, b->spread) * 100 << "%)";
+            if (b->runs < kMinBaselineRuns) std::cout << " 基准仅 " << b->runs << " 次，不判定";
+            std::cout << (bad ? " ⚠️ 回退" : "");
+        }
+        std::cout << std::defaultfloat << "\n";
+    }
+    append_perf_records(results, so_file, op_name, records);
+    std::cout << "结果已追加到 " << results << (regressions ? "，有 " + std::to_string(regressions) + " 项吞吐回退" : "")
+              << "\n";
+    return regressions ? 2 : 0;
+}
+
+// ---- 压缩列：按 item_id 打分时在内核里解码（fused） vs 先解码成 double 列再打分，对比 double 原列 ----
+// 参数：[物品数=4000000] [列数=8] [batch数=2000] [batch大小=1024]
+static int bench_encoding(int argc, char** argv) {
+    const size_t items = argc > 0 ? std::strtoull(argv[0], nullptr, 10) : 4000000;
+    const int cols = argc > 1 ? std::atoi(argv[1]) : 8;
+    const int batches = argc > 2 ? std::atoi(argv[2]) : 2000;
+    const size_t batch = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1024;
+
+    std::mt19937 rng(11);
+    std::vector<std::vector<double>> values(cols, std::vector<double>(items));
+    for (auto& col : values) for (auto& v : col) v = double(rng() % 100);
+    std::vector<double> weights(cols);
+    for (int c = 0; c < cols; ++c) weights[c] = 0.01 * (c + 1);
+    std::vector<std::vector<int>> random_ids(batches, std::vector<int>(batch));
+    for (auto& b : random_ids) for (auto& id : b) id = int(rng() % items);
+    std::vector<int> sequential_ids(items);
+    for (size_t i = 0; i < items; ++i) sequential_ids[i] = int(i);
+    std::cout << "物品: " << items << " | 列: " << cols << " | 随机: " << batches << " x " << batch
+              << " | 顺序扫描: 全目录 | AVX2: " << cpu_has_avx2() << "\n";
+    std::cout << std::setw(10) << "编码" << std::setw(11) << "B/物品" << std::setw(10) << "访问"
+              << std::setw(14) << "fused M条/s" << std::setw(10) << "GB/s" << std::setw(19) << "先解码 M条/s"
+              << std::setw(16) << "最大误差" << "\n";
+
+    // 第一轮（RAW）的分数作为基准
+    std::vector<double> reference_random, reference_sequential;
+    const char* labels[] = {"double", "dict", "bitpack", "int8"};
+    const uint32_t encodings[] = {ENC_RAW, ENC_DICTIONARY, ENC_BITPACKED, ENC_INT8};
+    for (int e = 0; e < 4; ++e) {
+        std::vector<EncodedColumnStorage> storage(cols);
+        std::vector<EncodedColumn> views(cols);
+        size_t bytes = 0;
+        for (int c = 0; c < cols; ++c) {
+            if (!encode_column(values[c], encodings[e], &storage[c])) return 1;
+            views[c] = storage[c].view("col");
+            bytes += storage[c].encoded_bytes();
+        }
+        const double bytes_per_item = double(bytes) / items;
+
+        // 每个 batch：fused 直接在编码数据上解码累加；对照组先把每列解码成 double 再做加权和
+        auto run = [&](const char* access, const std::vector<const int*>& chunks, const std::vector<size_t>& sizes,
+                       std::vector<double>& reference) {
+            size_t total = 0;
+            for (size_t n : sizes) total += n;
+            std::vector<double> fused(total, 0.0), staged(total, 0.0);
+            auto start = BenchClock::now();
+            for (size_t b = 0, off = 0; b < chunks.size(); off += sizes[b++]) {
+                score_linear_encoded(views.data(), weights.data(), cols, chunks[b], sizes[b], fused.data() + off);
+            }
+            double fused_s = elapsed_seconds(start);
+            std::vector<std::vector<double>> decoded(cols, std::vector<double>(batch));
+            start = BenchClock::now();
+            for (size_t b = 0, off = 0; b < chunks.size(); off += sizes[b++]) {
+                for (int c = 0; c < cols; ++c) {
+                    for (size_t i = 0; i < sizes[b]; ++i) decoded[c][i] = decode_value(views[c], chunks[b][i]);
+                }
+                for (int c = 0; c < cols; ++c) {
+                    for (size_t i = 0; i < sizes[b]; ++i) staged[off + i] += weights[c] * decoded[c][i];
+                }
+            }
+            double staged_s = elapsed_seconds(start);
+            if (reference.empty()) reference = fused;
+            double max_error = 0;
+            for (size_t i = 0; i < total; ++i) {
+                max_error = std::max(max_error, std::fabs(fused[i] - reference[i]));
+                max_error = std::max(max_error, std::fabs(staged[i] - reference[i]));
+            }
+            std::cout << std::setw(10) << labels[e] << std::fixed << std::setprecision(2) << std::setw(9)
+                      << bytes_per_item << std::setw(8) << access << std::setw(14) << total / fused_s / 1e6
+                      << std::setw(10) << total * bytes_per_item / fused_s / 1e9 << std::setw(16)
+                      << total / staged_s / 1e6 << std::scientific << std::setprecision(1) << std::setw(12)
+                      << max_error << std::defaultfloat << "\n";
+        };
+
+        std::vector<const int*> chunks;
+        std::vector<size_t> sizes;
+        for (const auto& b : random_ids) {
+            chunks.push_back(b.data());
+            sizes.push_back(b.size());
+        }
+        run("随机", chunks, sizes, reference_random);
+        chunks.clear();
+        sizes.clear();
+        for (size_t i = 0; i < items; i += batch) {
+            chunks.push_back(sequential_ids.data() + i);
+            sizes.push_back(std::min(batch, items - i));
+        }
+        run("顺序", chunks, sizes, reference_sequential);
+    }
+    return 0;
+}
+
+// ---- 参数文件加载：单块整体解压（旧方式） vs 分块并行解压 + 校验，按线程数看扩展性 ----
+// 参数：[解压后MB=256] [块KB=1024] [zlib级别=1]
+static int bench_params(int argc, char** argv) {
+    const size_t mb = argc > 0 ? std::strtoull(argv[0], nullptr, 10) : 256;
+    const uint32_t block_kb = argc > 1 ? uint32_t(std::atoi(argv[1])) : 1024;
+    const int level = argc > 2 ? std::atoi(argv[2]) : 1;
+
+    std::vector<ParamTensorData> tensors(1);
+    tensors[0].name = "embedding";
+    tensors[0].values.resize(mb * (1 << 20) / sizeof(float));
+    std::mt19937 rng(5);
+    for (auto& v : tensors[0].values) v = float(int(rng() >> 24) - 128) / 1024.0f;  // 量化后的参数，可压缩
+    const std::string chunked = "/tmp/bench_params_chunked.params", whole = "/tmp/bench_params_whole.params";
+    const uint32_t raw_bytes = uint32_t(std::min<size_t>(tensors[0].values.size() * sizeof(float), UINT32_MAX));
+    if (!write_param_file(chunked, tensors, block_kb << 10, level) || !write_param_file(whole, tensors, raw_bytes, level)) {
+        std::cerr << "写参数文件失败\n";
+        return 1;
+    }
+    std::cout << "解压后: " << mb << "MB | 块: " << block_kb << "KB | zlib 级别: " << level
+              << " | 硬件线程: " << std::thread::hardware_concurrency() << "\n";
+
+    auto run = [&](const char* label, const std::string& path, int threads) {
+        ParamLoadOptions options;
+        options.threads = threads;
+        ParamLoadStats stats;
+        auto blob = ParamBlob::load(path, options, &stats);
+        if (!blob) return false;
+        const ParamTensorView* t = blob->view().find("embedding");
+        bool same = t && t->count == tensors[0].values.size() &&
+                    std::memcmp(t->data, tensors[0].values.data(), t->count * sizeof(float)) == 0;
+        std::cout << std::setw(10) << label << " | 线程: " << std::setw(2) << stats.threads << " | 块: " << std::setw(5)
+                  << stats.blocks << " | 文件: " << std::fixed << std::setprecision(1) << stats.file_bytes / 1048576.0
+                  << "MB | 页: " << std::setw(7) << stats.page_mode << " | 耗时: " << std::setw(8) << stats.millis
+                  << "ms | 解压吞吐: " << std::setprecision(2) << stats.raw_bytes / stats.millis / 1e6 << " GB/s"
+                  << (same ? "" : "  (内容不一致!)") << std::defaultfloat << "\n";
+        return same;
+    };
+
+    bool ok = run("整体单块", whole, 1);
+    std::vector<int> thread_counts = {1, 2, 4};
+    int hw = int(std::thread::hardware_concurrency());
+    if (hw > 4) thread_counts.push_back(hw);
+    for (int threads : thread_counts) ok = run("分块并行", chunked, threads) && ok;
+    std::remove(chunked.c_str());
+    std::remove(whole.c_str());
+    return ok ? 0 : 1;
+}
+
+// ---- so 校验加载：BLAKE3 吞吐（标量 / AVX2 / 多线程），以及 不校验 / 先哈希再 dlopen / 边哈希边拷 memfd 的加载延迟 ----
+// 参数：[so=./score_op_v2.so] [加载次数=100] [哈希MB=256]
+static int bench_soload(int argc, char** argv) {
+    const std::string so_file = argc > 0 ? argv[0] : "./score_op_v2.so";
+    const int loads = argc > 1 ? std::atoi(argv[1]) : 100;
+    const size_t mb = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 256;
+
+    std::vector<uint8_t> big(mb << 20);
+    std::mt19937 rng(3);
+    for (auto& b : big) b = uint8_t(rng());
+    const size_t hw = std::max<size_t>(1, std::thread::hardware_concurrency());
+    std::cout << "BLAKE3 " << mb << "MB | AVX2: " << cpu_has_avx2() << " | 硬件线程: " << hw << "\n";
+    struct HashCase {
+        const char* label;
+        bool simd;
+        size_t threads;
+    } cases[] = {{"标量", false, 1}, {"AVX2", true, 1}, {"AVX2 多线程", true, hw}};
+    std::string reference;
+    for (const HashCase& c : cases) {
+        blake3::HashOptions options;
+        options.simd = c.simd;
+        options.threads = c.threads;
+        auto start = BenchClock::now();
+        std::string digest = blake3::hash(big.data(), big.size(), options).hex();
+        double seconds = elapsed_seconds(start);
+        if (reference.empty()) reference = digest;
+        std::cout << "  " << std::setw(16) << std::left << c.label << std::right << " 线程: " << std::setw(2) << c.threads
+                  << " | " << std::fixed << std::setprecision(2) << big.size() / seconds / 1e9 << " GB/s"
+                  << std::defaultfloat << (digest == reference ? "" : "  (摘要不一致!)") << "\n";
+    }
+    big.clear();
+    big.shrink_to_fit();
+
+    // 每次加载都用一份新拷贝：带 UNIQUE 符号的 so 卸载不掉，同一路径第二次 dlopen 只是查表
+    std::ifstream in(so_file, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (bytes.empty()) {
+        std::cerr << "无法读取 " << so_file << "\n";
+        return 1;
+    }
+    std::vector<std::string> copies;
+    for (int i = 0; i < loads * 3; ++i) {
+        copies.push_back("/tmp/bench_soload_" + std::to_string(i) + ".so");
+        std::ofstream(copies.back(), std::ios::binary) << bytes;
+    }
+    std::cout << "加载 " << so_file << " (" << bytes.size() / 1024 << "KB) x " << loads << "\n";
+    auto report = [&](const char* label, double seconds) {
+        std::cout << "  " << std::setw(22) << std::left << label << std::right << std::fixed << std::setprecision(1)
+                  << seconds * 1e6 / loads << " us/次" << std::defaultfloat << "\n";
+    };
+    size_t next = 0;
+    auto start = BenchClock::now();
+    for (int i = 0; i < loads; ++i) {
+        void* h = dlopen(copies[next++].c_str(), RTLD_NOW);
+        if (h) dlclose(h);
+    }
+    report("不校验 dlopen", elapsed_seconds(start));
+
+    start = BenchClock::now();
+    for (int i = 0; i < loads; ++i) {
+        std::string data(bytes.size(), '\0');
+        std::ifstream(copies[next], std::ios::binary).read(&data[0], std::streamsize(data.size()));
+        blake3::hash(data.data(), data.size());
+        void* h = dlopen(copies[next++].c_str(), RTLD_NOW);
+        if (h) dlclose(h);
+    }
+    report("先哈希再 dlopen", elapsed_seconds(start));
+
+    start = BenchClock::now();
+    for (int i = 0; i < loads; ++i) {
+        VerifiedLibrary lib;
+        if (open_verified_library(copies[next++], &lib)) {
+            dlclose(lib.handle);
+            close(lib.memfd);
+        }
+    }
+    report("边哈希边拷 memfd", elapsed_seconds(start));
+    for (const auto& path : copies) std::remove(path.c_str());
+    return 0;
+}
+
+// 秒级时序写入开销：每线程分片 vs 所有线程共用一个原子秒桶 vs 加锁秒桶，全部保留完整直方图和版本计数
+static int bench_timeseries(int argc, char** argv) {
+    const int threads = argc > 0 ? std::atoi(argv[0]) : 4;
+    const uint64_t per_thread = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+
+    std::cout << "写线程: " << threads << " | 每线程: " << per_thread << " 次 | 硬件线程: "
+              << std::thread::hardware_concurrency() << "\n";
+
+    auto run = [&](const char* label, std::function<void(uint64_t, uint64_t)> record_fn) {
+        std::vector<std::thread> workers;
+        auto start = BenchClock::now();
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                uint64_t h = uint64_t(t + 1) * 0x9E3779B97F4A7C15ULL;
+                for (uint64_t i = 0; i < per_thread; ++i) {
+                    h ^= h << 13, h ^= h >> 7, h ^= h << 17;
+                    record_fn(1 + (h >> 62 != 0), 200 + (h & 0xfff));  // 两个版本，200ns~4us
+                }
+            });
+        }
+        for (auto& th : workers) th.join();
+        double seconds = elapsed_seconds(start);
+        std::cout << std::setw(16) << label << " | " << std::fixed << std::setprecision(1)
+                  << seconds * 1e9 / double(per_thread) << " ns/次 | " << std::setprecision(1)
+                  << double(per_thread * threads) / seconds / 1e6 << " M/s\n";
+    };
+
+    TimeSeries series;
+    run("每线程分片", [&](uint64_t version, uint64_t ns) { series.record(version, ns); });
+    std::this_thread::sleep_for(std::chrono::seconds(1));  // 等最后一秒结束
+    WindowSummary all = series.summarize(0, series.now_second());
+    uint64_t collected = 0;
+    for (const auto& v : all.versions) collected += v.second;
+    std::cout << "                 并入环: " << collected << " / " << uint64_t(threads) * per_thread << " 次, 占用 "
+              << series.memory_bytes() / 1024 << "KB\n";
+
+    struct SharedBucket {
+        std::atomic<uint64_t> requests{0}, latency_sum{0}, version[2];
+        std::atomic<uint64_t> latency[timeseries_detail::kLatencyBuckets];
+        SharedBucket() {
+            for (auto& v : version) v = 0;
+            for (auto& v : latency) v = 0;
+        }
+    } shared;
+    run("共用原子秒桶", [&](uint64_t version, uint64_t ns) {
+        shared.requests.fetch_add(1, std::memory_order_relaxed);
+        shared.latency_sum.fetch_add(ns, std::memory_order_relaxed);
+        shared.version[version - 1].fetch_add(1, std::memory_order_relaxed);
+        shared.latency[timeseries_detail::latency_bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+    });
+
+    std::mutex mutex;
+    SecondBucket locked;
+    run("加锁秒桶", [&](uint64_t version, uint64_t ns) {
+        std::lock_guard<std::mutex> lock(mutex);
+        locked.requests++;
+        locked.latency_sum_ns += ns;
+        locked.add_version(version, 1);
+        locked.latency[timeseries_detail::latency_bucket(ns)]++;
+    });
+    return 0;
+}
+
+// 特征抓取：逐请求同步 vs 合批不重叠 vs 合批 + 多批在途与打分重叠，对本地替身服务（需先 ./build.sh 生成 feature_server）
+static int bench_feature_fetch(int argc, char** argv) {
+    FeatureServiceOptions service;
+    service.latency_us = argc > 0 ? uint32_t(std::atoi(argv[0])) : 500;
+    const size_t num_requests = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 256;
+    const size_t candidates = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 128;
+    const size_t per_batch = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 8;
+    const size_t depth = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 4;
+
+    auto holder = load_operator("./score_op_v2.so");
+    auto client = FeatureClient::spawn("./feature_server", service, std::max<size_t>(depth, 1));
+    if (!holder || !client) return 1;
+
+    std::vector<FeatureRequest> requests(num_requests);
+    std::mt19937 rng(11);
+    for (auto& r : requests) {
+        int32_t user = int32_t(rng() % 1000);
+        for (size_t i = 0; i < candidates; ++i) r.keys.push_back(FeatureKey{user, int32_t(rng() % 1000000)});
+    }
+    std::cout << "服务延迟: " << service.latency_us << "us | 请求: " << num_requests << " × " << candidates
+              << " 候选 | 每批 " << per_batch << " 请求 | 在途 " << depth << " 批\n";
+
+    auto report = [&](const char* label, double seconds, double wait_us) {
+        std::cout << std::setw(20) << label << " | " << std::fixed << std::setprecision(1) << seconds * 1e3 << " ms | "
+                  << std::setprecision(0) << num_requests / seconds << " 请求/s | 等待占比 " << std::setprecision(1)
+                  << wait_us / (seconds * 1e6) * 100 << "%\n";
+    };
+
+    FetchPipelineStats stats;
+    FetchPipelineOptions options;
+    options.requests_per_batch = 1;
+    options.depth = 1;
+    auto start = BenchClock::now();
+    if (!score_with_prefetch(*client, holder->op, requests, options, &stats)) return 1;
+    report("逐请求同步", elapsed_seconds(start), stats.wait_us);
+
+    options.requests_per_batch = per_batch;
+    start = BenchClock::now();
+    if (!score_with_prefetch(*client, holder->op, requests, options, &stats)) return 1;
+    report("合批", elapsed_seconds(start), stats.wait_us);
+
+    options.depth = depth;
+    start = BenchClock::now();
+    if (!score_with_prefetch(*client, holder->op, requests, options, &stats)) return 1;
+    report("合批 + 流水线", elapsed_seconds(start), stats.wait_us);
+    return 0;
+}
+
+// 本进程用户态的 dTLB 读 miss 计数器；没有 PMU（如虚拟机）或权限不够时返回 -1
+static int open_dtlb_miss_counter() {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+// 大表随机 gather：同一张表分别放在 4K / THP / 2M hugetlb / 1G hugetlb 上，比较吞吐和 dTLB miss
+static int bench_hugepages(int argc, char** argv) {
+    const size_t mb = argc > 0 ? std::strtoull(argv[0], nullptr, 10) : 1024;
+    const size_t gathers = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000000;
+    const size_t count = (mb << 20) / sizeof(double);
+
+    int counter = open_dtlb_miss_counter();
+    std::cout << "表: " << mb << "MB (" << count << " 个 double) | 随机 gather: " << gathers << " 次 | dTLB 计数器: "
+              << (counter >= 0 ? "可用" : "不可用") << "\n";
+
+    const HugePagePolicy policies[] = {HUGE_PAGES_OFF, HUGE_PAGES_THP, HUGE_PAGES_2M, HUGE_PAGES_1G};
+    for (HugePagePolicy policy : policies) {
+        auto map_start = BenchClock::now();
+        HugePageBlock block = huge_page_map(count * sizeof(double), policy);
+        if (!block.data) {
+            std::cout << std::setw(6) << huge_page_policy_name(policy) << " | 分配失败\n";
+            continue;
+        }
+        double* table = static_cast<double*>(block.data);
+        for (size_t i = 0; i < count; ++i) table[i] = double(i & 1023);
+        double fill_ms = elapsed_seconds(map_start) * 1e3;
+        size_t huge = smaps_huge_bytes(block.data, block.size);
+
+        // 8 路独立的随机下标，让访存并行起来；下标由 xorshift 生成，不额外占用缓存
+        if (counter >= 0) {
+            ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+            ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+        }
+        auto start = BenchClock::now();
+        uint64_t h[8];
+        for (int k = 0; k < 8; ++k) h[k] = 0x9E3779B97F4A7C15ULL * uint64_t(k + 1);
+        double sink = 0;
+        for (size_t i = 0; i < gathers; i += 8) {
+            for (int k = 0; k < 8; ++k) {
+                h[k] ^= h[k] << 13, h[k] ^= h[k] >> 7, h[k] ^= h[k] << 17;
+                sink += table[h[k] % count];
+            }
+        }
+        double seconds = elapsed_seconds(start);
+        long long misses = -1;
+        if (counter >= 0) {
+            ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(counter, &misses, sizeof(misses)) != sizeof(misses)) misses = -1;
+        }
+
+        std::cout << std::setw(6) << huge_page_policy_name(policy) << " -> " << std::setw(10) << std::left << block.mode
+                  << std::right << " | 大页核对 " << std::setw(5) << huge * 100 / block.size << "% | 映射+填充 "
+                  << std::fixed << std::setprecision(0) << std::setw(5) << fill_ms << "ms | " << std::setprecision(1)
+                  << std::setw(6) << gathers / seconds / 1e6 << " M gather/s | dTLB miss/gather: ";
+        if (misses >= 0) {
+            std::cout << std::setprecision(3) << double(misses) / double(gathers);
+        } else {
+            std::cout << "-";
+        }
+        std::cout << (sink == -1 ? " " : "") << "\n";
+        huge_page_unmap(block);
+    }
+    if (counter >= 0) close(counter);
+    return 0;
+}
+
+// 对照组：固定 max 个线程 + condition_variable，notify_one 唤醒的线程不固定，低流量时所有线程轮流醒
+class FixedWorkerPool {
+public:
+    explicit FixedWorkerPool(size_t threads) {
+        for (size_t i = 0; i < threads; ++i) workers_.emplace_back([this] { run(); });
+    }
+    ~FixedWorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        ready_.notify_all();
+        for (auto& th : workers_) th.join();
+    }
+    void submit(std::function<void()> fn) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(std::move(fn));
+        }
+        ready_.notify_one();
+    }
+    void wait_idle() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [&] { return queue_.empty() && running_ == 0; });
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            ready_.wait(lock, [&] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) return;
+            std::function<void()> fn = std::move(queue_.front());
+            queue_.pop_front();
+            running_++;
+            lock.unlock();
+            fn();
+            lock.lock();
+            if (--running_ == 0 && queue_.empty()) idle_.notify_all();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable ready_, idle_;
+    std::deque<std::function<void()>> queue_;
+    std::vector<std::thread> workers_;
+    size_t running_ = 0;
+    bool stopping_ = false;
+};
+
+static double process_cpu_ms() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3 + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+}
+
+// 低流量（每 interval 一个任务）的 CPU 占用和排队延迟，然后一次性突发 burst 个任务的完成时间和排队 p99
+template <typename Pool>
+static void run_pool_phases(const char* label, Pool& pool, size_t trickle, uint32_t interval_us, size_t burst,
+                            uint32_t task_us, const std::function<size_t()>& workers) {
+    std::vector<double> waits(std::max(trickle, burst));
+    auto task = [&](size_t i, BenchClock::time_point submitted) {
+        auto begin = BenchClock::now();
+        waits[i] = std::chrono::duration<double, std::micro>(begin - submitted).count();
+        while (BenchClock::now() - begin < std::chrono::microseconds(task_us)) {
+        }
+    };
+    auto percentile = [&](size_t n, double q) {
+        std::vector<double> sorted(waits.begin(), waits.begin() + n);
+        std::sort(sorted.begin(), sorted.end());
+        return sorted[std::min(n - 1, size_t(q * n))];
+    };
+
+    size_t trickle_peak = 0;
+    double cpu_start = process_cpu_ms();
+    auto trickle_start = BenchClock::now();
+    for (size_t i = 0; i < trickle; ++i) {
+        pool.submit(std::bind(task, i, BenchClock::now()));
+        std::this_thread::sleep_for(std::chrono::microseconds(interval_us));
+        trickle_peak = std::max(trickle_peak, workers());
+    }
+    pool.wait_idle();
+    double trickle_ms = elapsed_seconds(trickle_start) * 1e3;
+    double trickle_cpu = process_cpu_ms() - cpu_start;
+    double trickle_p99 = percentile(trickle, 0.99);
+
+    cpu_start = process_cpu_ms();
+    auto burst_start = BenchClock::now();
+    for (size_t i = 0; i < burst; ++i) pool.submit(std::bind(task, i, BenchClock::now()));
+    pool.wait_idle();
+    double burst_ms = elapsed_seconds(burst_start) * 1e3;
+    double burst_cpu = process_cpu_ms() - cpu_start;
+
+    std::cout << std::setw(10) << label << " | 低流量: 线程峰值 " << trickle_peak << ", CPU " << std::fixed
+              << std::setprecision(1) << trickle_cpu << "ms / " << trickle_ms << "ms 墙钟, 排队 p99 " << trickle_p99
+              << "us | 突发: " << burst_ms << "ms 完成, CPU " << burst_cpu << "ms, 排队 p50 " << percentile(burst, 0.5)
+              << "us p99 " << percentile(burst, 0.99) << "us\n";
+}
+
+// 弹性线程池 vs 固定线程池：低流量时的 CPU 占用、突发时扩到上限的速度与完成时间、空闲后的收缩
+static int bench_pool(int argc, char** argv) {
+    const size_t max_workers = argc > 0 ? std::strtoull(argv[0], nullptr, 10)
+                                        : std::max<size_t>(4, std::thread::hardware_concurrency());
+    const size_t burst = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+    const uint32_t task_us = argc > 2 ? uint32_t(std::atoi(argv[2])) : 20;
+    const size_t trickle = 2000;
+    const uint32_t interval_us = 500;
+
+    std::cout << "线程上限: " << max_workers << " | 低流量: " << trickle << " 个任务, 每 " << interval_us
+              << "us 一个 | 突发: " << burst << " 个任务 | 任务: " << task_us << "us | 硬件线程: "
+              << std::thread::hardware_concurrency() << "\n";
+
+    {
+        FixedWorkerPool pool(max_workers);
+        run_pool_phases("固定", pool, trickle, interval_us, burst, task_us, [&] { return max_workers; });
+    }
+
+    WorkerPoolOptions options;
+    options.min_workers = 1;
+    options.max_workers = max_workers;
+    options.idle_exit_ms = 100;
+    ElasticWorkerPool pool(options);
+    run_pool_phases("弹性", pool, trickle, interval_us, burst, task_us, [&] { return pool.stats().workers; });
+
+    // 扩容速度：从只剩下限线程开始突发，到线程数达到上限用了多久
+    std::this_thread::sleep_for(std::chrono::milliseconds(options.idle_exit_ms * 3));
+    WorkerPoolStats idle = pool.stats();
+    auto spike_start = BenchClock::now();
+    double full_us = -1;
+    for (size_t i = 0; i < burst; ++i) {
+        pool.submit([task_us] {
+            auto begin = BenchClock::now();
+            while (BenchClock::now() - begin < std::chrono::microseconds(task_us)) {
+            }
+        });
+        if (full_us < 0 && pool.stats().workers >= max_workers) full_us = elapsed_seconds(spike_start) * 1e6;
+    }
+    pool.wait_idle();
+    WorkerPoolStats s = pool.stats();
+    std::cout << "           | 空闲 " << options.idle_exit_ms * 3 << "ms 后收缩到 " << idle.workers << " 个线程; 再次突发 ";
+    if (full_us >= 0) {
+        std::cout << std::fixed << std::setprecision(1) << full_us << "us 扩到 " << max_workers << " 个";
+    } else {
+        std::cout << "峰值 " << s.peak_workers << " 个";
+    }
+    std::cout << " | 累计新建 " << s.spawned << ", 退出 " << s.exited << ", futex 唤醒 " << s.wakeups << "\n";
+    return 0;
+}
+
+// MMR 多样性重排：朴素（每步重算与全部已选项的相似度）vs 增量 max_sim（标量 / SIMD 内积）
+static int bench_mmr(int argc, char** argv) {
+    const size_t pool = argc > 0 ? std::strtoull(argv[0], nullptr, 10) : 500;
+    const size_t k = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 50;
+    const uint32_t dim = argc > 2 ? uint32_t(std::atoi(argv[2])) : 64;
+    const int iters = argc > 3 ? std::atoi(argv[3]) : 200;
+    const double lambda = 0.5;
+
+    // 32 个主题中心加噪声，分数随机
+    std::mt19937 rng(11);
+    std::normal_distribution<float> gauss(0.0f, 1.0f);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::vector<float> centers(32 * size_t(dim)), rows(pool * dim);
+    for (float& x : centers) x = gauss(rng);
+    std::vector<double> scores(pool);
+    for (size_t i = 0; i < pool; ++i) {
+        const size_t topic = rng() % 32;
+        float norm = 0;
+        for (uint32_t d = 0; d < dim; ++d) {
+            float x = centers[topic * dim + d] + 0.4f * gauss(rng);
+            rows[i * dim + d] = x;
+            norm += x * x;
+        }
+        for (uint32_t d = 0; d < dim; ++d) rows[i * dim + d] /= std::sqrt(norm);
+        scores[i] = uniform(rng);
+    }
+
+    std::cout << "候选池: " << pool << " | 选出: " << k << " | 维度: " << dim << " | λ=" << lambda << " | 次数: " << iters
+              << " | AVX2: " << (cpu_has_avx2() ? "是" : "否") << " | AVX-512: " << (cpu_has_avx512() ? "是" : "否")
+              << "\n";
+
+    std::vector<uint32_t> reference(k);
+    auto start = BenchClock::now();
+    const int naive_iters = std::max(1, iters / 20);  // 朴素版慢一两个数量级，少跑几次
+    for (int it = 0; it < naive_iters; ++it) {
+        mmr_select_naive(rows.data(), scores.data(), pool, dim, k, lambda, reference.data());
+    }
+    const double naive_us = elapsed_seconds(start) * 1e6 / naive_iters;
+    std::cout << std::setw(14) << "朴素" << " | " << std::fixed << std::setprecision(1) << std::setw(9) << naive_us
+              << " us/次 | 两两相似度 " << std::setprecision(3)
+              << mean_pairwise_similarity(rows.data(), reference.data(), std::min(k, pool), dim) << "\n";
+
+    const struct {
+        const char* label;
+        bool simd;
+    } cases[] = {{"增量 标量", false}, {"增量 SIMD", true}};
+    std::vector<float> work;
+    std::vector<uint32_t> order(k);
+    for (const auto& c : cases) {
+        double total = 0;
+        for (int it = 0; it < iters; ++it) {
+            work = rows;  // mmr_select 会就地重排行
+            auto t = BenchClock::now();
+            mmr_select(work.data(), scores.data(), pool, dim, k, lambda, order.data(), c.simd);
+            total += elapsed_seconds(t);
+        }
+        const double us = total * 1e6 / iters;
+        std::cout << std::setw(14) << c.label << " | " << std::setprecision(1) << std::setw(9) << us << " us/次 | 加速 "
+                  << naive_us / us << "x | 与朴素一致: " << (order == reference ? "是" : "否") << "\n";
+    }
+    return 0;
+}
+
+// SMT 流水：兄弟超线程 gather 下一块 + 本线程打分上一块 vs 单线程逐块 gather + 打分
+static int bench_smt(int argc, char** argv) {
+    const size_t items = argc > 0 ? std::strtoull(argv[0], nullptr, 10) : 4000000;
+    const size_t candidates = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+    size_t chunk = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 0;
+    const int iters = argc > 3 ? std::atoi(argv[3]) : 50;
+
+    auto holder = load_operator("./score_op_v2.so");
+    if (!holder) return 1;
+    ItemCatalog catalog;
+    catalog.item_feature.resize(items);
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    for (size_t i = 0; i < items; ++i) catalog.item_feature[i] = uniform(rng);
+    if (!resolve_projection(holder->op, catalog, &holder->projection)) return 1;
+    precompute_item_terms(*holder, catalog);
+
+    std::vector<std::vector<int>> requests(8, std::vector<int>(candidates));
+    for (auto& r : requests) for (auto& id : r) id = int(rng() % items);
+    const UserContext user{7, 0.4};
+
+    std::vector<SmtSiblings> pairs = smt_sibling_pairs();
+    SmtSiblings pair = pairs.empty() ? SmtSiblings{-1, -1} : pairs.back();
+    if (!chunk) chunk = smt_chunk_rows(*holder, catalog, SmtGatherScorer::kSlots, std::max(pair.cpu, 0));
+    std::cout << "物品: " << items << " | 候选: " << candidates << " | 块: " << chunk << " 行 | L2: "
+              << (l2_cache_bytes(std::max(pair.cpu, 0)) >> 10) << "KB | 超线程对: " << pairs.size();
+    if (pairs.empty()) {
+        std::cout << "（无兄弟线程，流水不绑核）\n";
+    } else {
+        std::cout << "（打分 cpu" << pair.cpu << " / gather cpu" << pair.sibling << "）\n";
+    }
+
+    std::vector<double> expected(candidates), scores(candidates);
+    FeatureBatchBuffer buf;
+    auto report = [&](const char* label, double seconds, double base) {
+        const double us = seconds * 1e6 / iters;
+        std::cout << std::setw(18) << label << " | " << std::fixed << std::setprecision(1) << std::setw(9) << us
+                  << " us/请求 | " << std::setprecision(1) << candidates / us << " M 行/s";
+        if (base > 0) std::cout << " | 加速 " << std::setprecision(2) << base / seconds << "x";
+        std::cout << "\n";
+    };
+
+    double gather_s = 0, score_s = 0, base = 0;
+    // 打分线程与 gather 兄弟线程同核，单线程基线也绑在打分线程的核上
+    std::thread([&] {
+        pin_current_thread(pair.cpu);
+        auto start = BenchClock::now();
+        for (int it = 0; it < iters; ++it) {
+            const std::vector<int>& ids = requests[it % requests.size()];
+            gather_score_chunked(*holder, catalog, user, ids.data(), candidates, expected.data(), 0, buf);
+        }
+        report("单线程 整批", elapsed_seconds(start), 0);
+
+        start = BenchClock::now();
+        for (int it = 0; it < iters; ++it) {
+            const std::vector<int>& ids = requests[it % requests.size()];
+            gather_score_chunked(*holder, catalog, user, ids.data(), candidates, expected.data(), chunk, buf);
+        }
+        base = elapsed_seconds(start);
+        report("单线程 分块", base, 0);
+
+        // 分块循环里 gather 与打分各占多少：两者越接近，流水能重叠的越多
+        for (int it = 0; it < iters; ++it) {
+            const std::vector<int>& ids = requests[it % requests.size()];
+            for (size_t begin = 0; begin < candidates; begin += chunk) {
+                const size_t rows = std::min(chunk, candidates - begin);
+                auto t = BenchClock::now();
+                gather_features(holder->projection, catalog, user, ids.data() + begin, rows, buf);
+                gather_item_precomputed(*holder, buf);
+                gather_s += elapsed_seconds(t);
+                t = BenchClock::now();
+                holder->op->compute_score_soa(buf.view(), expected.data() + begin);
+                score_s += elapsed_seconds(t);
+            }
+        }
+    }).join();
+    std::cout << "           其中 gather " << std::setprecision(1) << gather_s * 1e6 / iters << " us, 打分 "
+              << score_s * 1e6 / iters << " us\n";
+
+    SmtGatherScorer smt(pair.sibling);
+    bool same = true;
+    std::thread([&] {
+        pin_current_thread(pair.cpu);
+        auto start = BenchClock::now();
+        for (int it = 0; it < iters; ++it) {
+            const std::vector<int>& ids = requests[it % requests.size()];
+            smt.run(*holder, catalog, user, ids.data(), candidates, scores.data(), chunk);
+        }
+        report(pairs.empty() ? "双线程流水(不绑核)" : "SMT 流水", elapsed_seconds(start), base);
+        // 最后一个请求与单线程结果对拍
+        gather_score_chunked(*holder, catalog, user, requests[(iters - 1) % requests.size()].data(), candidates,
+                             expected.data(), chunk, buf);
+        same = scores == expected;
+    }).join();
+    SmtPipelineStats s = smt.stats();
+    std::cout << "           打分等 gather " << std::setprecision(1) << s.score_stall_us / std::max(iters, 1)
+              << " us/请求, gather 等缓冲 " << s.gather_stall_us / std::max(iters, 1) << " us/请求 | 与单线程一致: "
+              << (same ? "是" : "否") << "\n";
+    return same ? 0 : 1;
+}
+
+struct BenchEntry {
+    const char* name;
+    int (*fn)(int argc, char** argv);
+    const char* usage;
+};
+
+static const BenchEntry kBenches[] = {
+    {"left_right", bench_left_right, "[读线程数=4] [写间隔us=100] [时长ms=1000]  路由表 left-right vs shared_ptr"},
+    {"projection", bench_projection, "[物品数=200000] [宽列数=64] [读取列数=2] [batch数=2000]  列裁剪 vs 全量物化"},
+    {"retrieval", bench_retrieval, "[物品数=1000000] [维度=64] [线程数] [top-N=100] [查询数=20]  暴力检索 float32/int8"},
+    {"ann", bench_ann, "[物品数=200000] [维度=64] [nlist=256] [m=16] [K=10] [查询数=200]  IVF-PQ recall/延迟曲线"},
+    {"eligibility", bench_eligibility, "[物品全集=10000000] [batch大小=10000] [batch数=200]  roaring 资格过滤 vs 哈希集合"},
+    {"encoding", bench_encoding, "[物品数=4000000] [列数=8] [batch数=2000] [batch大小=1024]  压缩列 fused 解码打分 vs double 列"},
+    {"params", bench_params, "[解压后MB=256] [块KB=1024] [zlib级别=1]  参数文件分块并行解压 vs 整体单块"},
+    {"soload", bench_soload, "[so=./score_op_v2.so] [加载次数=100] [哈希MB=256]  BLAKE3 吞吐与校验加载延迟"},
+    {"timeseries", bench_timeseries, "[写线程数=4] [每线程次数=2000000]  秒级时序每线程分片 vs 共用秒桶写入开销"},
+    {"feature_fetch", bench_feature_fetch, "[延迟us=500] [请求数=256] [候选数=128] [每批请求数=8] [在途批数=4]  特征抓取合批/流水线 vs 逐请求同步"},
+    {"hugepages", bench_hugepages, "[表MB=1024] [gather次数=20000000]  大表随机 gather：4K / THP / 2M / 1G 页的吞吐与 dTLB miss"},
+    {"pool", bench_pool, "[线程上限=max(4,硬件线程)] [突发任务数=20000] [任务us=20]  弹性线程池 vs 固定线程池：低流量 CPU、突发扩容与完成时间"},
+    {"mmr", bench_mmr, "[候选池=500] [K=50] [维度=64] [次数=200]  MMR 多样性重排：朴素 vs 增量 max_sim（标量/SIMD）"},
+    {"smt", bench_smt, "[物品数=4000000] [候选数=100000] [块行数=按L2] [次数=50]  超线程对流水 gather + 打分 vs 单线程逐块"},
+    {"conformance", bench_conformance, "<算子.so> [结果文件=conformance_results.tsv] [回退阈值=0.2]  入口对拍 + 性能回退检查"},
+};
+
+int main(int argc, char** argv) {
+    if (argc >= 2) {
+        for (const BenchEntry& b : kBenches) {
+            if (std::strcmp(argv[1], b.name) == 0) return b.fn(argc - 2, argv + 2);
+        }
+    }
+    std::cout << "用法: ./bench <名称> [参数...]\n";
+    for (const BenchEntry& b : kBenches) std::cout << "  " << std::setw(12) << std::left << b.name << " " << b.usage << "\n";
+    return argc >= 2 ? 1 : 0;
+}
@@ -0,0 +1,287 @@
+// blake3.h
+#pragma once
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "housekeeping.h"
+#include "simd_util.h"
+
+// ---- BLAKE3（32 字节摘要，无 key）----
+// 输入按 1KB 切成 chunk，各 chunk 独立压缩出 chaining value（CV），再两两合并成二叉树，
+// 因此 chunk 可以分给多个线程、并在一个线程内用 AVX2 一次压缩 8 个。
+// 树合并按层两两配对、落单的节点原样升层，与规范中"左子树取最大的 2 的幂"等价。
+// 输出与 b3sum 一致，可以用它生成校验清单。
+
+namespace blake3 {
+
+constexpr size_t kBlockLen = 64;
+constexpr size_t kChunkLen = 1024;
+constexpr size_t kOutLen = 32;
+
+constexpr uint32_t kChunkStart = 1;
+constexpr uint32_t kChunkEnd = 2;
+constexpr uint32_t kParent = 4;
+constexpr uint32_t kRoot = 8;
+
+static const uint32_t kIV[8] = {0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+                                0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19};
+
+// 第 r 轮使用的消息字下标：每轮对上一轮做一次固定置换。写成 constexpr，展开后的轮函数里下标都是常量
+constexpr uint8_t permute(int i) {
+    return uint8_t("\x02\x06\x03\x0a\x07\x00\x04\x0d\x01\x0b\x0c\x05\x09\x0e\x0f\x08"[i]);
+}
+constexpr uint8_t msg_index(int r, int i) { return r == 0 ? uint8_t(i) : msg_index(r - 1, permute(i)); }
+
+struct Digest {
+    uint8_t bytes[kOutLen];
+
+    std::string hex() const {
+        static const char digits[] = "0123456789abcdef";
+        std::string s(kOutLen * 2, '0');
+        for (size_t i = 0; i < kOutLen; ++i) {
+            s[2 * i] = digits[bytes[i] >> 4];
+            s[2 * i + 1] = digits[bytes[i] & 15];
+        }
+        return s;
+    }
+    bool operator==(const Digest& other) const { return std::memcmp(bytes, other.bytes, kOutLen) == 0; }
+};
+
+namespace detail {
+
+inline uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+inline void g(uint32_t* v, int a, int b, int c, int d, uint32_t mx, uint32_t my) {
+    v[a] = v[a] + v[b] + mx;
+    v[d] = rotr(v[d] ^ v[a], 16);
+    v[c] = v[c] + v[d];
+    v[b] = rotr(v[b] ^ v[c], 12);
+    v[a] = v[a] + v[b] + my;
+    v[d] = rotr(v[d] ^ v[a], 8);
+    v[c] = v[c] + v[d];
+    v[b] = rotr(v[b] ^ v[c], 7);
+}
+
+template <int R>
+inline void round(uint32_t* v, const uint32_t* m) {
+    g(v, 0, 4, 8, 12, m[msg_index(R, 0)], m[msg_index(R, 1)]);
+    g(v, 1, 5, 9, 13, m[msg_index(R, 2)], m[msg_index(R, 3)]);
+    g(v, 2, 6, 10, 14, m[msg_index(R, 4)], m[msg_index(R, 5)]);
+    g(v, 3, 7, 11, 15, m[msg_index(R, 6)], m[msg_index(R, 7)]);
+    g(v, 0, 5, 10, 15, m[msg_index(R, 8)], m[msg_index(R, 9)]);
+    g(v, 1, 6, 11, 12, m[msg_index(R, 10)], m[msg_index(R, 11)]);
+    g(v, 2, 7, 8, 13, m[msg_index(R, 12)], m[msg_index(R, 13)]);
+    g(v, 3, 4, 9, 14, m[msg_index(R, 14)], m[msg_index(R, 15)]);
+}
+
+// 压缩一个 64 字节块，cv 原地更新为输出的前 8 个字
+inline void compress(uint32_t cv[8], const uint32_t m[16], uint32_t block_len, uint64_t counter, uint32_t flags) {
+    uint32_t v[16] = {cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+                      kIV[0], kIV[1], kIV[2], kIV[3], uint32_t(counter), uint32_t(counter >> 32), block_len, flags};
+    round<0>(v, m);
+    round<1>(v, m);
+    round<2>(v, m);
+    round<3>(v, m);
+    round<4>(v, m);
+    round<5>(v, m);
+    round<6>(v, m);
+    for (int i = 0; i < 8; ++i) cv[i] = v[i] ^ v[i + 8];
+}
+
+// 一个 chunk（可以不满 1KB，空输入也是一个 chunk）的 CV；root 只在整个输入只有一个 chunk 时为 true
+inline void chunk_cv(const uint8_t* data, size_t len, uint64_t counter, bool root, uint32_t out[8]) {
+    std::memcpy(out, kIV, sizeof(kIV));
+    const size_t blocks = len ? (len + kBlockLen - 1) / kBlockLen : 1;
+    for (size_t b = 0; b < blocks; ++b) {
+        const size_t n = std::min(kBlockLen, len - b * kBlockLen);
+        uint32_t m[16] = {0};
+        if (n) std::memcpy(m, data + b * kBlockLen, n);
+        uint32_t flags = (b == 0 ? kChunkStart : 0) | (b + 1 == blocks ? kChunkEnd | (root ? kRoot : 0) : 0);
+        compress(out, m, uint32_t(n), counter, flags);
+    }
+}
+
+inline void parent_cv(const uint32_t left[8], const uint32_t right[8], bool root, uint32_t out[8]) {
+    uint32_t m[16];
+    std::memcpy(m, left, 32);
+    std::memcpy(m + 8, right, 32);
+    std::memcpy(out, kIV, sizeof(kIV));
+    compress(out, m, uint32_t(kBlockLen), 0, kParent | (root ? kRoot : 0));
+}
+
+#define BLAKE3_AVX2 __attribute__((target("avx2")))
+
+BLAKE3_AVX2 inline __m256i rotr16(__m256i x) {
+    return _mm256_shuffle_epi8(x, _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+                                                   2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13));
+}
+BLAKE3_AVX2 inline __m256i rotr8(__m256i x) {
+    return _mm256_shuffle_epi8(x, _mm256_setr_epi8(1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12,
+                                                   1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12));
+}
+BLAKE3_AVX2 inline __m256i rotr12(__m256i x) { return _mm256_or_si256(_mm256_srli_epi32(x, 12), _mm256_slli_epi32(x, 20)); }
+BLAKE3_AVX2 inline __m256i rotr7(__m256i x) { return _mm256_or_si256(_mm256_srli_epi32(x, 7), _mm256_slli_epi32(x, 25)); }
+
+BLAKE3_AVX2 inline void g8(__m256i* v, int a, int b, int c, int d, __m256i mx, __m256i my) {
+    v[a] = _mm256_add_epi32(_mm256_add_epi32(v[a], v[b]), mx);
+    v[d] = rotr16(_mm256_xor_si256(v[d], v[a]));
+    v[c] = _mm256_add_epi32(v[c], v[d]);
+    v[b] = rotr12(_mm256_xor_si256(v[b], v[c]));
+    v[a] = _mm256_add_epi32(_mm256_add_epi32(v[a], v[b]), my);
+    v[d] = rotr8(_mm256_xor_si256(v[d], v[a]));
+    v[c] = _mm256_add_epi32(v[c], v[d]);
+    v[b] = rotr7(_mm256_xor_si256(v[b], v[c]));
+}
+
+template <int R>
+BLAKE3_AVX2 inline void round8(__m256i* v, const __m256i* m) {
+    g8(v, 0, 4, 8, 12, m[msg_index(R, 0)], m[msg_index(R, 1)]);
+    g8(v, 1, 5, 9, 13, m[msg_index(R, 2)], m[msg_index(R, 3)]);
+    g8(v, 2, 6, 10, 14, m[msg_index(R, 4)], m[msg_index(R, 5)]);
+    g8(v, 3, 7, 11, 15, m[msg_index(R, 6)], m[msg_index(R, 7)]);
+    g8(v, 0, 5, 10, 15, m[msg_index(R, 8)], m[msg_index(R, 9)]);
+    g8(v, 1, 6, 11, 12, m[msg_index(R, 10)], m[msg_index(R, 11)]);
+    g8(v, 2, 7, 8, 13, m[msg_index(R, 12)], m[msg_index(R, 13)]);
+    g8(v, 3, 4, 9, 14, m[msg_index(R, 14)], m[msg_index(R, 15)]);
+}
+
+// 8x8 的 32 位矩阵转置：r[i] 的第 j 个字 -> r[j] 的第 i 个字
+BLAKE3_AVX2 inline void transpose8(__m256i* r) {
+    __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]), t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+    __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]), t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+    __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]), t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+    __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]), t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2), u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3), u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6), u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7), u7 = _mm256_unpackhi_epi64(t5, t7);
+    r[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+    r[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+    r[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+    r[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+    r[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+    r[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+    r[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+    r[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+// 连续 8 个完整 chunk 并行压缩，每个 lane 一个 chunk；cvs 按 chunk 顺序写 8 x 8 个字
+BLAKE3_AVX2 inline void hash8_avx2(const uint8_t* data, uint64_t counter, uint32_t* cvs) {
+    __m256i h[8];
+    for (int i = 0; i < 8; ++i) h[i] = _mm256_set1_epi32(int(kIV[i]));
+    uint32_t lo[8], hi[8];
+    for (int k = 0; k < 8; ++k) {
+        lo[k] = uint32_t(counter + k);
+        hi[k] = uint32_t((counter + k) >> 32);
+    }
+    const __m256i counter_lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lo));
+    const __m256i counter_hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hi));
+    const size_t blocks = kChunkLen / kBlockLen;
+    for (size_t b = 0; b < blocks; ++b) {
+        __m256i m[16];
+        for (int half = 0; half < 2; ++half) {
+            for (int k = 0; k < 8; ++k) {
+                m[half * 8 + k] = _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i*>(data + k * kChunkLen + b * kBlockLen + half * 32));
+            }
+            transpose8(m + half * 8);
+        }
+        const uint32_t flags = (b == 0 ? kChunkStart : 0) | (b + 1 == blocks ? kChunkEnd : 0);
+        __m256i v[16] = {h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7],
+                         _mm256_set1_epi32(int(kIV[0])), _mm256_set1_epi32(int(kIV[1])),
+                         _mm256_set1_epi32(int(kIV[2])), _mm256_set1_epi32(int(kIV[3])),
+                         counter_lo, counter_hi, _mm256_set1_epi32(int(kBlockLen)), _mm256_set1_epi32(int(flags))};
+        round8<0>(v, m);
+        round8<1>(v, m);
+        round8<2>(v, m);
+        round8<3>(v, m);
+        round8<4>(v, m);
+        round8<5>(v, m);
+        round8<6>(v, m);
+        for (int i = 0; i < 8; ++i) h[i] = _mm256_xor_si256(v[i], v[i + 8]);
+    }
+    transpose8(h);
+    for (int k = 0; k < 8; ++k) _mm256_storeu_si256(reinterpret_cast<__m256i*>(cvs + k * 8), h[k]);
+}
+
+#undef BLAKE3_AVX2
+
+// 连续 n 个完整 chunk 的 CV（都不是根），能凑满 8 个时走 AVX2
+inline void hash_full_chunks(const uint8_t* data, size_t n, uint64_t counter, uint32_t* cvs, bool use_simd) {
+    size_t i = 0;
+    if (use_simd) {
+        for (; i + 8 <= n; i += 8) hash8_avx2(data + i * kChunkLen, counter + i, cvs + i * 8);
+    }
+    for (; i < n; ++i) chunk_cv(data + i * kChunkLen, kChunkLen, counter + i, false, cvs + i * 8);
+}
+
+}  // namespace detail
+
+struct HashOptions {
+    size_t threads = 1;             // 参与的 housekeeping 线程数上限
+    bool simd = true;               // 有 AVX2 时 8 路并行压缩
+    size_t chunks_per_piece = 64;   // 每次交给 on_piece 的粒度（64KB），数据在缓存里时接着哈希
+};
+
+// 哈希 data[0, len)。每段数据被哈希之前先在同一线程上调用 on_piece(offset, size)，
+// 调用方可以借此把同一段数据顺手拷走（见 so_loader.h），整个输入只被读一遍。
+template <typename OnPiece>
+Digest hash_tree(const uint8_t* data, size_t len, const HashOptions& options, OnPiece on_piece) {
+    const size_t num_chunks = len ? (len + kChunkLen - 1) / kChunkLen : 1;
+    const size_t full = num_chunks - 1;  // 最后一个 chunk 可能不满或是根，单独处理
+    const bool simd = options.simd && cpu_has_avx2();
+    std::vector<uint32_t> cvs(num_chunks * 8);
+
+    const size_t piece = std::max<size_t>(options.chunks_per_piece, 8);
+    const size_t pieces = (full + piece - 1) / piece;
+    auto work = [&](size_t begin, size_t end) {
+        for (size_t p = begin; p < end; ++p) {
+            const size_t first = p * piece, n = std::min(piece, full - first);
+            on_piece(first * kChunkLen, n * kChunkLen);
+            detail::hash_full_chunks(data + first * kChunkLen, n, first, cvs.data() + first * 8, simd);
+        }
+    };
+    if (options.threads <= 1 || pieces <= 1) {
+        work(0, pieces);
+    } else {
+        housekeeping_parallel_for(pieces, work, options.threads);
+    }
+    const size_t tail = full * kChunkLen;
+    on_piece(tail, len - tail);
+
+    Digest digest;
+    uint32_t root[8];
+    if (num_chunks == 1) {
+        detail::chunk_cv(data, len, 0, true, root);
+    } else {
+        detail::chunk_cv(data + tail, len - tail, full, false, cvs.data() + full * 8);
+        // 逐层两两合并，落单的节点直接升到上一层；只剩两个节点时合并出的就是根
+        size_t nodes = num_chunks;
+        while (nodes > 2) {
+            size_t next = 0;
+            for (size_t i = 0; i + 1 < nodes; i += 2, ++next) {
+                detail::parent_cv(&cvs[i * 8], &cvs[(i + 1) * 8], false, &cvs[next * 8]);
+            }
+            if (nodes % 2) {
+                std::memmove(&cvs[next * 8], &cvs[(nodes - 1) * 8], 32);
+                ++next;
+            }
+            nodes = next;
+        }
+        detail::parent_cv(&cvs[0], &cvs[8], true, root);
+    }
+    std::memcpy(digest.bytes, root, kOutLen);
+    return digest;
+}
+
+inline Digest hash(const void* data, size_t len, const HashOptions& options = HashOptions()) {
+    return hash_tree(static_cast<const uint8_t*>(data), len, options, [](size_t, size_t) {});
+}
+
+}  // namespace blake3
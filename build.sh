@@ -1,7 +1,13 @@
 #!/bin/bash
 set -e
 
-g++ -fPIC -shared -o score_op_v1.so score_op_v1.cpp
-g++ -fPIC -shared -o score_op_v2.so score_op_v2.cpp
-g++ -std=c++11 -o demo main.cpp -ldl -pthread
-echo "Build done. Run with: ./demo"
+g++ -O2 -fPIC -shared -o score_op_v1.so score_op_v1.cpp
+g++ -O2 -fPIC -shared -o score_op_v2.so score_op_v2.cpp
+g++ -O2 -fPIC -shared -o score_op_v3.so score_op_v3.cpp
+g++ -O2 -fPIC -shared -o score_op_v4.so score_op_v4.cpp
+g++ -O2 -fPIC -shared -o stage_calibrate_v1.so stage_calibrate_v1.cpp
+g++ -O2 -fPIC -shared -o stage_calibrate_v2.so stage_calibrate_v2.cpp
+g++ -O2 -std=c++11 -o feature_server feature_server.cpp
+g++ -O2 -std=c++11 -rdynamic -o demo main.cpp -ldl -pthread -lz
+g++ -O2 -std=c++11 -o bench bench.cpp -ldl -pthread -lz
+echo "Build done. Run with: ./demo (benchmarks: ./bench)"
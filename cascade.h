@@ -0,0 +1,102 @@
+// cascade.h
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "operator_holder.h"
+#include "topk.h"
+
+// 级联快照：粗排与精排作为一个整体发布，一次请求内两阶段一定来自同一快照
+struct CascadeSnapshot {
+    std::shared_ptr<OperatorHolder> preranker;  // 便宜的粗排算子，给全部候选打分
+    std::shared_ptr<OperatorHolder> ranker;     // 昂贵的精排算子，只给头部候选打分
+};
+
+struct CascadeConfig {
+    double keep_fraction = 0.2;       // 正常负载下进入精排的比例
+    double min_keep_fraction = 0.02;  // 高负载下允许降到的最低比例
+    size_t min_keep = 10;             // 至少精排这么多个（不超过候选数）
+    double latency_target_us = 500;   // 单次请求延迟目标
+};
+
+struct CascadeResult {
+    std::vector<ScoredItem> ranked;  // 精排后的头部候选，按精排分数降序
+    size_t prescored = 0;
+    size_t rescored = 0;
+    double keep_fraction = 0;        // 本次实际使用的截断比例
+};
+
+// ---- 两阶段级联打分 ----
+// 截断比例按延迟 EWMA 自适应：超出目标时乘性下调，回落到目标的 70% 以下时缓慢恢复。
+class CascadeScorer {
+public:
+    explicit CascadeScorer(const CascadeConfig& config = CascadeConfig())
+        : config_(config), keep_fraction_(config.keep_fraction), latency_ewma_us_(0) {}
+
+    CascadeResult score(const CascadeSnapshot& snapshot, const std::vector<Feature>& candidates) {
+        auto start_time = std::chrono::steady_clock::now();
+        CascadeResult result;
+        if (!snapshot.preranker || !snapshot.ranker || candidates.empty()) return result;
+
+        // 1. 粗排：全部候选
+        std::vector<double> pre_scores(candidates.size());
+        snapshot.preranker->op->compute_score_batch(candidates.data(), candidates.size(), pre_scores.data());
+        result.prescored = candidates.size();
+
+        // 2. 截断：按粗排分数取头部
+        result.keep_fraction = keep_fraction_.load(std::memory_order_relaxed);
+        size_t keep = size_t(candidates.size() * result.keep_fraction);
+        keep = std::min(candidates.size(), std::max(keep, std::max<size_t>(config_.min_keep, 1)));
+
+        std::vector<size_t> order(candidates.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::nth_element(order.begin(), order.begin() + (keep - 1), order.end(),
+                         [&](size_t a, size_t b) { return pre_scores[a] > pre_scores[b]; });
+        order.resize(keep);
+
+        // 3. 精排：只给头部候选打分
+        std::vector<Feature> head;
+        head.reserve(keep);
+        for (size_t i : order) head.push_back(candidates[i]);
+        std::vector<double> scores(keep);
+        snapshot.ranker->op->compute_score_batch(head.data(), keep, scores.data());
+        result.rescored = keep;
+
+        result.ranked.reserve(keep);
+        for (size_t j = 0; j < keep; ++j) result.ranked.push_back(ScoredItem{order[j], scores[j]});
+        std::sort(result.ranked.begin(), result.ranked.end(),
+                  [](const ScoredItem& a, const ScoredItem& b) { return a.score > b.score; });
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start_time);
+        observe_latency(double(elapsed.count()));
+        return result;
+    }
+
+    double keep_fraction() const { return keep_fraction_.load(std::memory_order_relaxed); }
+    double latency_ewma_us() const { return latency_ewma_us_.load(std::memory_order_relaxed); }
+
+private:
+    // 多线程并发更新时允许丢失个别样本，只要趋势正确即可
+    void observe_latency(double latency_us) {
+        double ewma = latency_ewma_us_.load(std::memory_order_relaxed);
+        ewma = ewma == 0 ? latency_us : ewma * 0.9 + latency_us * 0.1;
+        latency_ewma_us_.store(ewma, std::memory_order_relaxed);
+
+        double fraction = keep_fraction_.load(std::memory_order_relaxed);
+        if (ewma > config_.latency_target_us) {
+            fraction = std::max(config_.min_keep_fraction, fraction * 0.8);
+        } else if (ewma < config_.latency_target_us * 0.7) {
+            fraction = std::min(config_.keep_fraction, fraction + 0.01);
+        }
+        keep_fraction_.store(fraction, std::memory_order_relaxed);
+    }
+
+    CascadeConfig config_;
+    std::atomic<double> keep_fraction_;
+    std::atomic<double> latency_ewma_us_;
+};
@@ -0,0 +1,244 @@
+// column_codec.h
+#pragma once
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "operator_interface.h"
+#include "simd_util.h"
+
+// ---- 目录列压缩编码 ----
+// 物品目录的宽列大多是小整数或少量取值，按 double 存放时大部分字节是冗余的。
+// 编码后的列只有原来的 1/8 左右，随机 gather 时能留在缓存里的部分多得多；
+// 打分内核按 item_id 直接在编码数据上解码（见 score_linear_encoded），不物化 double 列。
+//   DICTIONARY：不同取值 <= 256 时存 uint8 码 + 字典，无损
+//   BITPACKED ：全为整数时存 (v - min)，每个值 bits 位紧密打包，无损
+//   INT8      ：v ≈ q * scale，误差 <= scale / 2，只在调用方允许有损时使用
+
+// 编码数据尾部的填充：SIMD 解码按 4/8 字节读取，最后一个值之后要能多读 8 字节
+constexpr size_t kEncodedPadding = 8;
+
+// host 侧存储，view() 给算子一个只读的 EncodedColumn
+struct EncodedColumnStorage {
+    uint32_t encoding = ENC_RAW;
+    uint32_t bits = 0;
+    size_t rows = 0;
+    std::vector<uint8_t> bytes;  // 编码数据 + kEncodedPadding 字节填充
+    std::vector<double> dictionary;
+    double base = 0;
+    double scale = 1;
+
+    EncodedColumn view(const char* name) const {
+        return EncodedColumn{name, encoding, bits, rows, bytes.data(),
+                             dictionary.empty() ? nullptr : dictionary.data(), base, scale};
+    }
+    // 编码后占用的字节数（含字典，不含填充）
+    size_t encoded_bytes() const {
+        return bytes.size() - std::min(bytes.size(), kEncodedPadding) + dictionary.size() * sizeof(double);
+    }
+};
+
+namespace column_codec_detail {
+
+inline bool is_integer(double v) { return std::floor(v) == v && std::fabs(v) < 9.0e15; }
+
+inline uint32_t bits_for(uint64_t range) {
+    uint32_t bits = 1;
+    while (bits < 32 && (range >> bits) != 0) ++bits;
+    return bits;
+}
+
+inline uint64_t read_u64(const uint8_t* p) {
+    uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+    return word;
+}
+
+}  // namespace column_codec_detail
+
+// 按指定编码压缩一列；该编码无法表示这列数据时返回 false，out 不变
+template <typename Alloc>
+inline bool encode_column(const std::vector<double, Alloc>& values, uint32_t encoding, EncodedColumnStorage* out) {
+    using namespace column_codec_detail;
+    EncodedColumnStorage col;
+    col.encoding = encoding;
+    col.rows = values.size();
+    const size_t n = values.size();
+
+    if (encoding == ENC_RAW) {
+        col.bytes.resize(n * sizeof(double) + kEncodedPadding);
+        if (n) std::memcpy(col.bytes.data(), values.data(), n * sizeof(double));
+    } else if (encoding == ENC_DICTIONARY) {
+        col.dictionary.assign(values.begin(), values.end());
+        std::sort(col.dictionary.begin(), col.dictionary.end());
+        col.dictionary.erase(std::unique(col.dictionary.begin(), col.dictionary.end()), col.dictionary.end());
+        if (col.dictionary.size() > 256) return false;
+        col.bytes.resize(n + kEncodedPadding);
+        for (size_t i = 0; i < n; ++i) {
+            col.bytes[i] = uint8_t(std::lower_bound(col.dictionary.begin(), col.dictionary.end(), values[i]) -
+                                   col.dictionary.begin());
+        }
+    } else if (encoding == ENC_BITPACKED) {
+        if (n == 0) return false;
+        double lo = values[0], hi = values[0];
+        for (double v : values) {
+            if (!is_integer(v)) return false;
+            lo = std::min(lo, v);
+            hi = std::max(hi, v);
+        }
+        if (hi - lo > 4294967295.0) return false;
+        col.base = lo;
+        col.bits = bits_for(uint64_t(hi - lo));
+        col.bytes.assign((n * col.bits + 7) / 8 + kEncodedPadding, 0);
+        for (size_t i = 0; i < n; ++i) {
+            uint64_t v = uint64_t(values[i] - lo);
+            size_t bit = i * col.bits;
+            for (uint32_t b = 0; b < col.bits; ++b, ++bit) {
+                if (v >> b & 1) col.bytes[bit >> 3] |= uint8_t(1u << (bit & 7));
+            }
+        }
+    } else if (encoding == ENC_INT8) {
+        double max_abs = 0;
+        for (double v : values) max_abs = std::max(max_abs, std::fabs(v));
+        if (!std::isfinite(max_abs)) return false;
+        col.scale = max_abs > 0 ? max_abs / 127.0 : 1.0;
+        col.bytes.resize(n + kEncodedPadding);
+        for (size_t i = 0; i < n; ++i) {
+            col.bytes[i] = uint8_t(int8_t(std::lround(values[i] / col.scale)));
+        }
+    } else {
+        return false;
+    }
+    *out = std::move(col);
+    return true;
+}
+
+// 选一个最省空间的无损编码；都不适用时返回 RAW，allow_lossy 时退到 INT8
+template <typename Alloc>
+inline uint32_t choose_encoding(const std::vector<double, Alloc>& values, bool allow_lossy) {
+    using namespace column_codec_detail;
+    if (values.empty()) return ENC_RAW;
+    bool integral = true;
+    double lo = values[0], hi = values[0];
+    for (double v : values) {
+        integral = integral && is_integer(v);
+        lo = std::min(lo, v);
+        hi = std::max(hi, v);
+    }
+    const uint32_t packed_bits = integral && hi - lo <= 4294967295.0 ? bits_for(uint64_t(hi - lo)) : 64;
+    if (packed_bits > 8) {
+        std::vector<double> distinct(values.begin(), values.end());
+        std::sort(distinct.begin(), distinct.end());
+        if (std::unique(distinct.begin(), distinct.end()) - distinct.begin() <= 256) return ENC_DICTIONARY;
+    }
+    if (packed_bits < 64) return ENC_BITPACKED;
+    return allow_lossy ? ENC_INT8 : ENC_RAW;
+}
+
+// 标量解码一个值；row 超出范围时返回 0，与 gather 对目录外物品的处理一致
+inline double decode_value(const EncodedColumn& col, int64_t row) {
+    if (row < 0 || uint64_t(row) >= col.rows) return 0.0;
+    const uint8_t* data = static_cast<const uint8_t*>(col.data);
+    switch (col.encoding) {
+    case ENC_RAW: {
+        double v;
+        std::memcpy(&v, data + row * sizeof(double), sizeof(v));
+        return v;
+    }
+    case ENC_DICTIONARY:
+        return col.dictionary[data[row]];
+    case ENC_BITPACKED: {
+        uint64_t bit = uint64_t(row) * col.bits;
+        uint64_t word = column_codec_detail::read_u64(data + (bit >> 3));
+        return col.base + double((word >> (bit & 7)) & ((uint64_t(1) << col.bits) - 1));
+    }
+    case ENC_INT8:
+        return double(int8_t(data[row])) * col.scale;
+    }
+    return 0.0;
+}
+
+namespace column_codec_kernels {
+
+// 4 个行号 -> 4 个 double，全程留在寄存器里。rows 中超出 [0, col.rows) 的行解码为 0。
+// 行号按 int32 比较，目录行数需小于 2^31。
+__attribute__((target("avx2,fma"))) inline __m256d decode4_avx2(const EncodedColumn& col, __m128i rows) {
+    const __m128i valid = _mm_and_si128(_mm_cmpgt_epi32(rows, _mm_set1_epi32(-1)),
+                                        _mm_cmpgt_epi32(_mm_set1_epi32(int(col.rows)), rows));
+    rows = _mm_and_si128(rows, valid);  // 越界行改读第 0 行，最后再清零
+    const int* base32 = static_cast<const int*>(col.data);
+    __m256d v;
+    switch (col.encoding) {
+    case ENC_RAW:
+        v = _mm256_i32gather_pd(static_cast<const double*>(col.data), rows, 8);
+        break;
+    case ENC_DICTIONARY: {
+        // 按字节偏移读 4 字节，低 8 位即码，再用码去 gather 字典
+        __m128i codes = _mm_and_si128(_mm_i32gather_epi32(base32, rows, 1), _mm_set1_epi32(0xff));
+        v = _mm256_i32gather_pd(col.dictionary, codes, 8);
+        break;
+    }
+    case ENC_BITPACKED: {
+        __m256i bit = _mm256_mul_epu32(_mm256_cvtepu32_epi64(rows), _mm256_set1_epi64x(col.bits));
+        __m256i word = _mm256_i64gather_epi64(reinterpret_cast<const long long*>(col.data),
+                                              _mm256_srli_epi64(bit, 3), 1);
+        __m256i value = _mm256_and_si256(_mm256_srlv_epi64(word, _mm256_and_si256(bit, _mm256_set1_epi64x(7))),
+                                         _mm256_set1_epi64x(int64_t((uint64_t(1) << col.bits) - 1)));
+        // value < 2^32：拼到 2^52 的尾数里再减掉 2^52，即无符号整数 -> double
+        const __m256i magic = _mm256_set1_epi64x(0x4330000000000000LL);
+        v = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(value, magic)), _mm256_castsi256_pd(magic));
+        v = _mm256_add_pd(v, _mm256_set1_pd(col.base));
+        break;
+    }
+    case ENC_INT8: {
+        __m128i q = _mm_srai_epi32(_mm_slli_epi32(_mm_i32gather_epi32(base32, rows, 1), 24), 24);
+        v = _mm256_mul_pd(_mm256_cvtepi32_pd(q), _mm256_set1_pd(col.scale));
+        break;
+    }
+    default:
+        v = _mm256_setzero_pd();
+    }
+    return _mm256_and_pd(v, _mm256_castsi256_pd(_mm256_cvtepi32_epi64(valid)));
+}
+
+inline void score_linear_scalar(const EncodedColumn* cols, const double* weights, size_t num_cols,
+                                const int* item_ids, size_t n, double* out) {
+    for (size_t i = 0; i < n; ++i) {
+        double acc = 0;
+        for (size_t c = 0; c < num_cols; ++c) acc += weights[c] * decode_value(cols[c], item_ids[i]);
+        out[i] += acc;
+    }
+}
+
+__attribute__((target("avx2,fma"))) inline void score_linear_avx2(const EncodedColumn* cols, const double* weights,
+                                                                   size_t num_cols, const int* item_ids, size_t n,
+                                                                   double* out) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m128i rows = _mm_loadu_si128(reinterpret_cast<const __m128i*>(item_ids + i));
+        __m256d acc = _mm256_loadu_pd(out + i);
+        for (size_t c = 0; c < num_cols; ++c) {
+            acc = _mm256_fmadd_pd(decode4_avx2(cols[c], rows), _mm256_set1_pd(weights[c]), acc);
+        }
+        _mm256_storeu_pd(out + i, acc);
+    }
+    score_linear_scalar(cols, weights, num_cols, item_ids + i, n - i, out + i);
+}
+
+}  // namespace column_codec_kernels
+
+// out[i] += sum_c weights[c] * cols[c][item_ids[i]]
+// 逐 4 行把所有列解码进寄存器并累加，每行只写一次 out，解码结果从不落到内存
+inline void score_linear_encoded(const EncodedColumn* cols, const double* weights, size_t num_cols,
+                                 const int* item_ids, size_t n, double* out) {
+    if (cpu_has_avx2()) {
+        column_codec_kernels::score_linear_avx2(cols, weights, num_cols, item_ids, n, out);
+    } else {
+        column_codec_kernels::score_linear_scalar(cols, weights, num_cols, item_ids, n, out);
+    }
+}
@@ -0,0 +1,414 @@
+// conformance.h
+#pragma once
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "operator_interface.h"
+
+// ---- 算子一致性与性能套件 ----
+// 对任意算子 .so：
+//   1. 各批量入口（AoS batch / SoA / 按声明裁剪后的 SoA / 带预计算列的 SoA / float32）与 compute_score 逐行对拍
+//   2. 多线程并发调用，结果须与单线程逐位一致
+//   3. 标准 batch 大小下测吞吐与单次调用延迟，追加到结果文件，并与同名算子上一次的记录比较
+// hot_update 发布前跑第 1 项的小规模版本（conformance_quick_check），入口不一致的版本不会上线。
+
+struct ConformanceOptions {
+    size_t rows = 4096;
+    double tolerance = 1e-9;      // double 入口的相对误差
+    double f32_tolerance = 1e-4;  // float32 入口的相对误差
+    int threads = 4;
+    int thread_rounds = 200;
+};
+
+struct ConformanceCheck {
+    std::string name;
+    bool passed;
+    double max_error;
+    std::string detail;
+};
+
+struct ConformanceReport {
+    std::vector<ConformanceCheck> checks;
+
+    bool passed() const {
+        for (const auto& c : checks) {
+            if (!c.passed) return false;
+        }
+        return true;
+    }
+};
+
+// 固定种子的输入，含 0、负数和较大的值
+inline std::vector<Feature> conformance_inputs(size_t n, uint32_t seed = 7) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> dist(-3.0, 3.0);
+    std::vector<Feature> features(n);
+    for (size_t i = 0; i < n; ++i) {
+        features[i].user_id = int(rng() % 1000);
+        features[i].item_id = int(rng() % 200000);
+        features[i].user_feature = i % 17 == 0 ? 0.0 : dist(rng);
+        features[i].item_feature = i % 29 == 0 ? 100.0 * dist(rng) : dist(rng);
+    }
+    return features;
+}
+
+// 测试输入的列式副本，按需给出 FeatureBatch / FeatureBatchF32 视图
+struct ConformanceColumns {
+    std::vector<int> user_id, item_id;
+    std::vector<double> user_feature, item_feature, item_precomputed;
+    std::vector<float> user_feature_f32, item_feature_f32;
+    int precompute_width = 0;
+
+    ConformanceColumns(IScoreOperator* op, const std::vector<Feature>& features) {
+        for (const Feature& f : features) {
+            user_id.push_back(f.user_id);
+            item_id.push_back(f.item_id);
+            user_feature.push_back(f.user_feature);
+            item_feature.push_back(f.item_feature);
+            user_feature_f32.push_back(float(f.user_feature));
+            item_feature_f32.push_back(float(f.item_feature));
+        }
+        precompute_width = op->item_precompute_width();
+        if (precompute_width > 0) {
+            item_precomputed.resize(features.size() * precompute_width);
+            for (size_t i = 0; i < features.size(); ++i) {
+                op->precompute_item(item_id[i], item_feature[i], item_precomputed.data() + i * precompute_width);
+            }
+        }
+    }
+
+    FeatureBatch batch(size_t begin, size_t n, uint32_t mask, bool precomputed) const {
+        FeatureBatch b;
+        b.size = n;
+        b.user_id = mask & COL_USER_ID ? user_id.data() + begin : nullptr;
+        b.item_id = mask & COL_ITEM_ID ? item_id.data() + begin : nullptr;
+        b.user_feature = mask & COL_USER_FEATURE ? user_feature.data() + begin : nullptr;
+        b.item_feature = mask & COL_ITEM_FEATURE ? item_feature.data() + begin : nullptr;
+        if (precomputed && precompute_width > 0) {
+            b.item_precomputed = item_precomputed.data() + begin * precompute_width;
+            b.item_precompute_width = precompute_width;
+        }
+        return b;
+    }
+
+    FeatureBatchF32 batch_f32(size_t begin, size_t n) const {
+        FeatureBatchF32 b;
+        b.size = n;
+        b.user_id = user_id.data() + begin;
+        b.item_id = item_id.data() + begin;
+        b.user_feature = user_feature_f32.data() + begin;
+        b.item_feature = item_feature_f32.data() + begin;
+        return b;
+    }
+};
+
+namespace conformance_detail {
+
+inline double relative_error(double got, double expected) {
+    if (std::isnan(got) && std::isnan(expected)) return 0.0;
+    if (std::isnan(got) || std::isnan(expected)) return INFINITY;
+    return std::fabs(got - expected) / std::max(1.0, std::fabs(expected));
+}
+
+template <typename T>
+inline ConformanceCheck compare(const std::string& name, const T* got, const std::vector<double>& expected,
+                                double tolerance) {
+    ConformanceCheck check{name, true, 0.0, ""};
+    size_t worst = 0;
+    for (size_t i = 0; i < expected.size(); ++i) {
+        double err = relative_error(double(got[i]), expected[i]);
+        if (err > check.max_error || std::isinf(err)) {
+            check.max_error = err;
+            worst = i;
+        }
+    }
+    check.passed = check.max_error <= tolerance;
+    if (!check.passed) {
+        std::ostringstream os;
+        os << "第 " << worst << " 行: " << double(got[worst]) << " vs compute_score " << expected[worst];
+        check.detail = os.str();
+    }
+    return check;
+}
+
+}  // namespace conformance_detail
+
+// 1. 各入口与 compute_score 对拍（整批一次调用）
+inline void check_entry_points(IScoreOperator* op, const std::vector<Feature>& features,
+                               const ConformanceOptions& options, ConformanceReport* report) {
+    using conformance_detail::compare;
+    const size_t n = features.size();
+    ConformanceColumns cols(op, features);
+    std::vector<double> expected(n), got(n);
+    for (size_t i = 0; i < n; ++i) expected[i] = op->compute_score(features[i]);
+
+    op->compute_score_batch(features.data(), n, got.data());
+    report->checks.push_back(compare("compute_score_batch", got.data(), expected, options.tolerance));
+
+    op->compute_score_soa(cols.batch(0, n, COL_BASE_ALL, false), got.data());
+    report->checks.push_back(compare("compute_score_soa", got.data(), expected, options.tolerance));
+
+    if (cols.precompute_width > 0) {
+        op->compute_score_soa(cols.batch(0, n, COL_BASE_ALL, true), got.data());
+        report->checks.push_back(compare("compute_score_soa+precompute", got.data(), expected, options.tolerance));
+    }
+
+    // float32 入口的参照按 float 精度的输入计算
+    std::vector<double> expected_f32(n);
+    for (size_t i = 0; i < n; ++i) expected_f32[i] = op->compute_score(cols.batch_f32(0, n).row(i));
+    std::vector<float> got_f32(n);
+    op->compute_score_f32(cols.batch_f32(0, n), got_f32.data());
+    report->checks.push_back(compare("compute_score_f32", got_f32.data(), expected_f32, options.f32_tolerance));
+}
+
+// 1'. 只给声明过的基础列（其余为 nullptr，与线上 gather 一致），结果应与完整输入相同。
+// 读了未声明的列会解引用空指针，因此放在子进程里跑，崩溃也只记为失败。
+inline void check_projection(IScoreOperator* op, const std::vector<Feature>& features,
+                             const ConformanceOptions& options, ConformanceReport* report) {
+    const uint32_t mask = op->required_base_columns() & COL_BASE_ALL;
+    ConformanceCheck check{"compute_score_soa(按声明裁剪)", true, 0.0, ""};
+    if (mask == COL_BASE_ALL) {
+        check.detail = "声明了全部基础列，跳过";
+        report->checks.push_back(check);
+        return;
+    }
+    int fds[2];
+    if (pipe(fds) != 0) return;
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        ConformanceColumns cols(op, features);
+        std::vector<double> expected(features.size()), got(features.size());
+        for (size_t i = 0; i < features.size(); ++i) expected[i] = op->compute_score(features[i]);
+        op->compute_score_soa(cols.batch(0, features.size(), mask, true), got.data());
+        ConformanceCheck result = conformance_detail::compare(check.name, got.data(), expected, options.tolerance);
+        double payload[2] = {result.passed ? 1.0 : 0.0, result.max_error};
+        ssize_t written = write(fds[1], payload, sizeof(payload));
+        _exit(written == ssize_t(sizeof(payload)) ? 0 : 1);
+    }
+    close(fds[1]);
+    double payload[2] = {0, 0};
+    ssize_t got = pid > 0 ? read(fds[0], payload, sizeof(payload)) : -1;
+    close(fds[0]);
+    int status = 0;
+    if (pid > 0) waitpid(pid, &status, 0);
+    if (pid > 0 && WIFSIGNALED(status)) {
+        check.passed = false;
+        check.detail = std::string("子进程崩溃(") + strsignal(WTERMSIG(status)) + ")，可能读了未声明的列";
+    } else if (got != ssize_t(sizeof(payload))) {
+        check.passed = false;
+        check.detail = "子进程未返回结果";
+    } else {
+        check.passed = payload[0] != 0.0;
+        check.max_error = payload[1];
+        if (!check.passed) check.detail = "结果依赖未声明的列";
+    }
+    report->checks.push_back(check);
+}
+
+// 2. 多线程并发调用各入口，结果须与单线程逐位一致
+inline void check_thread_safety(IScoreOperator* op, const std::vector<Feature>& features,
+                                const ConformanceOptions& options, ConformanceReport* report) {
+    const size_t n = features.size();
+    ConformanceColumns cols(op, features);
+    const FeatureBatch batch = cols.batch(0, n, COL_BASE_ALL, true);
+    std::vector<double> reference(n), reference_batch(n);
+    op->compute_score_soa(batch, reference.data());
+    op->compute_score_batch(features.data(), n, reference_batch.data());
+
+    std::atomic<size_t> mismatches{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < options.threads; ++t) {
+        threads.emplace_back([&, t] {
+            std::vector<double> out(n);
+            for (int round = 0; round < options.thread_rounds; ++round) {
+                // 各线程错开起点和长度，覆盖不同的尾部处理
+                size_t begin = size_t(t * 37 + round * 11) % n;
+                size_t len = std::min(n - begin, size_t(64 + (round * 131) % 512));
+                if ((round + t) % 2 == 0) {
+                    op->compute_score_soa(cols.batch(begin, len, COL_BASE_ALL, true), out.data());
+                    for (size_t i = 0; i < len; ++i) mismatches += out[i] != reference[begin + i];
+                } else {
+                    op->compute_score_batch(features.data() + begin, len, out.data());
+                    for (size_t i = 0; i < len; ++i) mismatches += out[i] != reference_batch[begin + i];
+                }
+                double single = op->compute_score(features[begin]);
+                mismatches += std::fabs(single - reference_batch[begin]) >
+                              options.tolerance * std::max(1.0, std::fabs(single));
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    ConformanceCheck check{"并发调用", mismatches == 0, 0.0, ""};
+    if (!check.passed) check.detail = std::to_string(mismatches.load()) + " 个结果与单线程不一致";
+    report->checks.push_back(check);
+}
+
+inline ConformanceReport run_conformance(IScoreOperator* op, const ConformanceOptions& options) {
+    ConformanceReport report;
+    auto features = conformance_inputs(options.rows);
+    check_entry_points(op, features, options, &report);
+    check_projection(op, features, options, &report);
+    check_thread_safety(op, features, options, &report);
+    return report;
+}
+
+// hot_update 发布前的快速对拍：只比较各入口，不 fork、不起线程
+inline bool conformance_quick_check(IScoreOperator* op, size_t rows = 257) {
+    ConformanceReport report;
+    ConformanceOptions options;
+    check_entry_points(op, conformance_inputs(rows), options, &report);
+    for (const auto& check : report.checks) {
+        if (!check.passed) {
+            std::cerr << "[Conformance] " << op->name() << " " << check.name << " 与 compute_score 不一致: "
+                      << check.detail << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// ---- 3. 性能 ----
+struct PerfRecord {
+    std::string entry;
+    size_t batch;
+    double items_per_sec;  // 各轮吞吐的中位数
+    double p50_us;
+    double p99_us;
+    double spread = 0;     // 各轮吞吐的四分位距 / 中位数，不写入结果文件
+};
+
+inline const std::vector<size_t>& standard_batch_sizes() {
+    static const std::vector<size_t> sizes = {1, 16, 64, 256, 1024, 4096};
+    return sizes;
+}
+
+// 每个 (入口, batch) 测 rounds 轮、每轮至少 min_ms，吞吐取各轮中位数，延迟分布合并各轮。
+// 各 (入口, batch) 按轮交错测量，频率漂移、邻居干扰这类慢变化会摊到所有条目上，而不是集中坏掉某一项
+inline std::vector<PerfRecord> measure_entry_points(IScoreOperator* op, const std::vector<Feature>& features,
+                                                    int min_ms = 20, int rounds = 5) {
+    using Clock = std::chrono::steady_clock;
+    ConformanceColumns cols(op, features);
+    const uint32_t mask = op->required_base_columns() & COL_BASE_ALL;
+    std::vector<double> out(features.size());
+    std::vector<float> out_f32(features.size());
+    const char* entries[] = {"compute_score", "batch", "soa", "f32"};
+
+    struct Series {
+        size_t batch;
+        int entry;
+        std::vector<double> throughput;
+        std::vector<double> latencies;
+    };
+    std::vector<Series> series;
+    for (size_t b : standard_batch_sizes()) {
+        if (b > features.size()) continue;
+        for (int e = 0; e < 4; ++e) series.push_back(Series{b, e, {}, {}});
+    }
+
+    for (int round = 0; round < std::max(rounds, 1); ++round) {
+        for (Series& s : series) {
+            const size_t b = s.batch;
+            size_t items = 0, begin = 0;
+            auto start = Clock::now();
+            while (std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count() < min_ms) {
+                if (begin + b > features.size()) begin = 0;
+                auto t0 = Clock::now();
+                switch (s.entry) {
+                case 0:
+                    for (size_t i = 0; i < b; ++i) out[i] = op->compute_score(features[begin + i]);
+                    break;
+                case 1: op->compute_score_batch(features.data() + begin, b, out.data()); break;
+                case 2: op->compute_score_soa(cols.batch(begin, b, mask, true), out.data()); break;
+                default: op->compute_score_f32(cols.batch_f32(begin, b), out_f32.data()); break;
+                }
+                s.latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+                items += b;
+                begin += b;
+            }
+            s.throughput.push_back(double(items) / std::chrono::duration<double>(Clock::now() - start).count());
+        }
+    }
+
+    std::vector<PerfRecord> records;
+    for (Series& s : series) {
+        std::sort(s.throughput.begin(), s.throughput.end());
+        std::sort(s.latencies.begin(), s.latencies.end());
+        PerfRecord r;
+        r.entry = entries[s.entry];
+        r.batch = s.batch;
+        r.items_per_sec = s.throughput[s.throughput.size() / 2];
+        r.p50_us = s.latencies[s.latencies.size() / 2];
+        r.p99_us = s.latencies[std::min(s.latencies.size() - 1, s.latencies.size() * 99 / 100)];
+        const size_t n = s.throughput.size();
+        r.spread = r.items_per_sec > 0 ? (s.throughput[n * 3 / 4] - s.throughput[n / 4]) / r.items_per_sec : 0;
+        records.push_back(r);
+    }
+    return records;
+}
+
+// 结果文件为 TSV，每行：时间戳 so 算子名 入口 batch 吞吐(条/s) p50(us) p99(us)
+inline void append_perf_records(const std::string& path, const std::string& so_file, const std::string& op_name,
+                                const std::vector<PerfRecord>& records) {
+    std::ofstream out(path, std::ios::app);
+    long now = long(std::time(nullptr));
+    for (const auto& r : records) {
+        out << now << '\t' << so_file << '\t' << op_name << '\t' << r.entry << '\t' << r.batch << '\t'
+            << r.items_per_sec << '\t' << r.p50_us << '\t' << r.p99_us << '\n';
+    }
+}
+
+// 同名算子每个 (入口, batch) 最近 history 次记录的吞吐中位数与四分位距 / 中位数，
+// 单次记录的偶然快慢不会成为比较基准，跨次运行的波动也能拿来放宽容差
+struct PerfBaseline {
+    double items_per_sec = 0;
+    double spread = 0;  // 记录少于 3 次时为 0
+    size_t runs = 0;    // 参与统计的记录数
+};
+
+inline std::map<std::string, PerfBaseline> load_previous_throughput(const std::string& path,
+                                                                    const std::string& op_name,
+                                                                    size_t history = 5) {
+    std::map<std::string, std::vector<double>> runs;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream ls(line);
+        std::string time, so, name, entry, batch;
+        double items_per_sec = 0;
+        if (!std::getline(ls, time, '\t') || !std::getline(ls, so, '\t') || !std::getline(ls, name, '\t') ||
+            !std::getline(ls, entry, '\t') || !std::getline(ls, batch, '\t') || !(ls >> items_per_sec)) {
+            continue;
+        }
+        if (name == op_name) runs[entry + "@" + batch].push_back(items_per_sec);
+    }
+    std::map<std::string, PerfBaseline> previous;
+    for (auto& kv : runs) {
+        std::vector<double>& v = kv.second;
+        v.erase(v.begin(), v.end() - std::min(v.size(), std::max<size_t>(history, 1)));
+        std::sort(v.begin(), v.end());
+        PerfBaseline& b = previous[kv.first];
+        b.items_per_sec = v[v.size() / 2];
+        b.runs = v.size();
+        if (v.size() >= 3 && b.items_per_sec > 0) b.spread = (v[v.size() * 3 / 4] - v[v.size() / 4]) / b.items_per_sec;
+    }
+    return previous;
+}
@@ -0,0 +1,172 @@
+// diversity.h
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "retrieval.h"
+#include "simd_util.h"
+
+// ---- MMR 多样性重排 ----
+// 从打分后的前 n 个候选里逐个挑 k 个：每步选 λ·rel(i) - (1-λ)·max_{j∈已选} sim(i, j) 最大的 i。
+// rel 是把候选分数线性归一到 [0, 1] 的相关性，sim 是 L2 归一化后 embedding 的余弦相似度。
+// 朴素做法每步对每个候选重算它和全部已选项的相似度，O(k²·n·dim)。这里为每个候选维护
+// max_sim，选中 j 后只算 j 与剩余候选的一行相似度并就地取 max，O(k·n·dim)；这一行用检索的
+// dot4 SIMD 内核（一次 4 行，复用寄存器里的 j 向量）。选中的行与末行交换，剩余候选始终连续。
+
+struct MMROptions {
+    double lambda = 0.7;  // 1 为纯相关性排序，越小越偏向多样
+    size_t pool = 200;    // 参与重排的候选数（sink 按分数保留的前 pool 个）
+};
+
+// 把 n 个物品的 embedding 取出为连续的 float 行并做 L2 归一化，int8 矩阵按行缩放还原；
+// 越界的 item_id 得到全零行（与任何物品相似度为 0）
+inline void load_normalized_embeddings(const EmbeddingIndex& index, const int* item_ids, size_t n,
+                                       std::vector<float>& rows) {
+    const uint32_t dim = index.dim();
+    rows.assign(n * dim, 0.0f);
+    for (size_t i = 0; i < n; ++i) {
+        if (item_ids[i] < 0 || size_t(item_ids[i]) >= index.count()) continue;
+        const size_t id = size_t(item_ids[i]);
+        float* row = rows.data() + i * dim;
+        if (index.type() == EmbeddingType::Float32) {
+            std::copy(index.f32_rows() + id * dim, index.f32_rows() + (id + 1) * dim, row);
+        } else {
+            const float scale = index.scales()[id];
+            for (uint32_t d = 0; d < dim; ++d) row[d] = float(index.i8_rows()[id * dim + d]) * scale;
+        }
+        float norm = 0;
+        for (uint32_t d = 0; d < dim; ++d) norm += row[d] * row[d];
+        if (norm > 0) {
+            const float inv = 1.0f / std::sqrt(norm);
+            for (uint32_t d = 0; d < dim; ++d) row[d] *= inv;
+        }
+    }
+}
+
+namespace mmr_detail {
+
+// 相关性归一到 [0, 1]；分数全相同时都为 1
+inline void normalize_relevance(const double* scores, size_t n, std::vector<float>& rel) {
+    rel.resize(n);
+    if (n == 0) return;
+    const double lo = *std::min_element(scores, scores + n);
+    const double hi = *std::max_element(scores, scores + n);
+    for (size_t i = 0; i < n; ++i) rel[i] = hi > lo ? float((scores[i] - lo) / (hi - lo)) : 1.0f;
+}
+
+inline float dot_scalar(const float* a, const float* b, uint32_t dim) {
+    float acc = 0;
+    for (uint32_t d = 0; d < dim; ++d) acc += a[d] * b[d];
+    return acc;
+}
+
+}  // namespace mmr_detail
+
+// 增量 MMR。rows 为 n 行归一化 embedding（会被就地重排），scores 为 n 个分数；
+// 把选出的候选下标（相对输入顺序）按选择先后写入 order，返回个数 min(k, n)。
+// use_simd 为 false 时用标量内积，基准对比用
+inline size_t mmr_select(float* rows, const double* scores, size_t n, uint32_t dim, size_t k, double lambda,
+                         uint32_t* order, bool use_simd = true) {
+    using namespace retrieval_kernels;
+    k = std::min(k, n);
+    if (k == 0) return 0;
+    const bool avx512 = use_simd && cpu_has_avx512();
+    const bool avx2 = use_simd && cpu_has_avx2();
+    const float wr = float(lambda), ws = float(1.0 - lambda);
+
+    thread_local std::vector<float> rel, max_sim;
+    thread_local std::vector<uint32_t> ids;
+    mmr_detail::normalize_relevance(scores, n, rel);
+    max_sim.assign(n, 0.0f);
+    ids.resize(n);
+    for (size_t i = 0; i < n; ++i) ids[i] = uint32_t(i);
+
+    size_t live = n;  // [0, live) 是尚未选中的候选
+    for (size_t t = 0; t < k; ++t) {
+        // 第一个直接取相关性最高的；之后按 MMR 目标取最大
+        size_t best = 0;
+        float best_value = -std::numeric_limits<float>::infinity();
+        for (size_t i = 0; i < live; ++i) {
+            const float value = t == 0 ? rel[i] : wr * rel[i] - ws * max_sim[i];
+            if (value > best_value) {
+                best_value = value;
+                best = i;
+            }
+        }
+        order[t] = ids[best];
+        if (t + 1 == k) break;
+
+        // 选中的行换到 live - 1，之后它就是查询向量，剩余候选仍然连续
+        --live;
+        if (best != live) {
+            std::swap_ranges(rows + best * dim, rows + (best + 1) * dim, rows + live * size_t(dim));
+            std::swap(ids[best], ids[live]);
+            std::swap(rel[best], rel[live]);
+            std::swap(max_sim[best], max_sim[live]);
+        }
+        const float* query = rows + live * size_t(dim);
+        float out[4];
+        size_t i = 0;
+        for (; i + 4 <= live; i += 4) {
+            const float* block = rows + i * dim;
+            if (avx512) dot4_f32_avx512(block, dim, query, out);
+            else if (avx2) dot4_f32_avx2(block, dim, query, out);
+            else dot4_f32_scalar(block, dim, query, out);
+            for (int r = 0; r < 4; ++r) {
+                max_sim[i + r] = t == 0 ? out[r] : std::max(max_sim[i + r], out[r]);
+            }
+        }
+        for (; i < live; ++i) {
+            const float s = mmr_detail::dot_scalar(rows + i * dim, query, dim);
+            max_sim[i] = t == 0 ? s : std::max(max_sim[i], s);
+        }
+    }
+    return k;
+}
+
+// 朴素 MMR：每步对每个候选重算与全部已选项的相似度。rows 不修改，用来校验与对比
+inline size_t mmr_select_naive(const float* rows, const double* scores, size_t n, uint32_t dim, size_t k,
+                               double lambda, uint32_t* order) {
+    k = std::min(k, n);
+    std::vector<float> rel;
+    mmr_detail::normalize_relevance(scores, n, rel);
+    std::vector<char> taken(n, 0);
+    for (size_t t = 0; t < k; ++t) {
+        size_t best = 0;
+        float best_value = -std::numeric_limits<float>::infinity();
+        for (size_t i = 0; i < n; ++i) {
+            if (taken[i]) continue;
+            float value = rel[i];
+            if (t > 0) {
+                float max_sim = -std::numeric_limits<float>::infinity();
+                for (size_t s = 0; s < t; ++s) {
+                    max_sim = std::max(max_sim, mmr_detail::dot_scalar(rows + i * dim, rows + order[s] * size_t(dim), dim));
+                }
+                value = float(lambda) * rel[i] - float(1.0 - lambda) * max_sim;
+            }
+            if (value > best_value) {
+                best_value = value;
+                best = i;
+            }
+        }
+        taken[best] = 1;
+        order[t] = uint32_t(best);
+    }
+    return k;
+}
+
+// 前 k 项两两余弦相似度的均值，衡量结果的多样性（越小越分散）
+inline double mean_pairwise_similarity(const float* rows, const uint32_t* order, size_t k, uint32_t dim) {
+    if (k < 2) return 0;
+    double sum = 0;
+    for (size_t a = 0; a < k; ++a) {
+        for (size_t b = a + 1; b < k; ++b) {
+            sum += mmr_detail::dot_scalar(rows + order[a] * size_t(dim), rows + order[b] * size_t(dim), dim);
+        }
+    }
+    return sum / double(k * (k - 1) / 2);
+}
@@ -0,0 +1,339 @@
+// eligibility.h
+#pragma once
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "feature_batch.h"
+#include "simd_util.h"
+
+// ---- 资格过滤阶段 ----
+// 地域、库存、黑名单等业务规则按 item_id 表示成压缩位图，发布时合并成一张"可用物品"位图；
+// 请求时在 gather / 打分之前剔除不可用候选，算子不再为注定被过滤的物品花时间。
+// 位图快照与算子一样整体替换，请求只持有自己拿到的那份。
+
+// Roaring 风格压缩位图：item_id 的高 16 位分块，块内按密度选容器：
+//   数组容器：有序 uint16，最多 kArrayMax 个
+//   位图容器：65536 bit（1024 个 uint64），交集/差集用 AVX2 整块按位运算
+class RoaringBitmap {
+public:
+    static constexpr uint32_t kArrayMax = 4096;
+    static constexpr uint32_t kBitmapWords = 1024;
+
+    struct Container {
+        uint16_t key = 0;
+        uint32_t cardinality = 0;
+        std::vector<uint16_t> array;  // 数组容器
+        std::vector<uint64_t> bits;   // 位图容器，非空即表示位图形态
+
+        bool is_bitmap() const { return !bits.empty(); }
+        bool contains(uint16_t low) const {
+            if (is_bitmap()) return (bits[low >> 6] >> (low & 63)) & 1;
+            return std::binary_search(array.begin(), array.end(), low);
+        }
+    };
+
+    // ids 可以无序、重复
+    static RoaringBitmap from_ids(std::vector<uint32_t> ids) {
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        RoaringBitmap result;
+        size_t i = 0;
+        while (i < ids.size()) {
+            Container c;
+            c.key = uint16_t(ids[i] >> 16);
+            size_t end = i;
+            while (end < ids.size() && (ids[end] >> 16) == c.key) ++end;
+            c.cardinality = uint32_t(end - i);
+            if (c.cardinality > kArrayMax) {
+                c.bits.assign(kBitmapWords, 0);
+                for (size_t k = i; k < end; ++k) c.bits[(ids[k] & 0xFFFF) >> 6] |= uint64_t(1) << (ids[k] & 63);
+            } else {
+                c.array.reserve(c.cardinality);
+                for (size_t k = i; k < end; ++k) c.array.push_back(uint16_t(ids[k] & 0xFFFF));
+            }
+            result.containers_.push_back(std::move(c));
+            i = end;
+        }
+        result.build_index();
+        return result;
+    }
+
+    // [begin, end) 全部置位
+    static RoaringBitmap range(uint32_t begin, uint32_t end) {
+        std::vector<uint32_t> ids;
+        for (uint32_t id = begin; id < end; ++id) ids.push_back(id);
+        return from_ids(std::move(ids));
+    }
+
+    bool contains(uint32_t id) const {
+        uint32_t key = id >> 16;
+        if (key >= key_index_.size()) return false;
+        int32_t c = key_index_[key];
+        return c >= 0 && containers_[size_t(c)].contains(uint16_t(id & 0xFFFF));
+    }
+
+    uint64_t cardinality() const {
+        uint64_t n = 0;
+        for (const Container& c : containers_) n += c.cardinality;
+        return n;
+    }
+
+    size_t memory_bytes() const {
+        size_t bytes = key_index_.size() * sizeof(int32_t);
+        for (const Container& c : containers_) {
+            bytes += sizeof(Container) + c.array.size() * sizeof(uint16_t) + c.bits.size() * sizeof(uint64_t);
+        }
+        return bytes;
+    }
+
+    size_t num_containers() const { return containers_.size(); }
+    size_t num_bitmap_containers() const {
+        size_t n = 0;
+        for (const Container& c : containers_) n += c.is_bitmap();
+        return n;
+    }
+
+    // a ∩ b
+    static RoaringBitmap intersect(const RoaringBitmap& a, const RoaringBitmap& b) { return combine(a, b, false); }
+    // a - b
+    static RoaringBitmap subtract(const RoaringBitmap& a, const RoaringBitmap& b) { return combine(a, b, true); }
+
+private:
+    static RoaringBitmap combine(const RoaringBitmap& a, const RoaringBitmap& b, bool andnot);
+    static Container combine_containers(const Container& a, const Container* b, bool andnot);
+    static void normalize(Container& c);
+
+    void build_index() {
+        key_index_.assign(containers_.empty() ? 0 : size_t(containers_.back().key) + 1, -1);
+        for (size_t i = 0; i < containers_.size(); ++i) key_index_[containers_[i].key] = int32_t(i);
+    }
+
+    std::vector<Container> containers_;  // 按 key 升序
+    std::vector<int32_t> key_index_;     // key -> 容器下标，-1 表示该块为空
+};
+
+// ---- 容器内核 ----
+namespace roaring_kernels {
+
+// out = a & b（andnot 时 a & ~b），返回置位数
+inline uint32_t and_words_scalar(const uint64_t* a, const uint64_t* b, size_t n, bool andnot, uint64_t* out) {
+    uint32_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = andnot ? a[i] & ~b[i] : a[i] & b[i];
+        count += uint32_t(__builtin_popcountll(out[i]));
+    }
+    return count;
+}
+
+__attribute__((target("avx2,popcnt")))
+inline uint32_t and_words_avx2(const uint64_t* a, const uint64_t* b, size_t n, bool andnot, uint64_t* out) {
+    uint64_t count = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(b + i));
+        __m256i r = andnot ? _mm256_andnot_si256(vb, va) : _mm256_and_si256(va, vb);
+        _mm256_storeu_si256((__m256i*)(out + i), r);
+        count += _mm_popcnt_u64(out[i]) + _mm_popcnt_u64(out[i + 1]) + _mm_popcnt_u64(out[i + 2]) +
+                 _mm_popcnt_u64(out[i + 3]);
+    }
+    return uint32_t(count) + and_words_scalar(a + i, b + i, n - i, andnot, out + i);
+}
+
+inline uint32_t and_words(const uint64_t* a, const uint64_t* b, size_t n, bool andnot, uint64_t* out) {
+    return cpu_has_avx2() ? and_words_avx2(a, b, n, andnot, out) : and_words_scalar(a, b, n, andnot, out);
+}
+
+}  // namespace roaring_kernels
+
+inline void RoaringBitmap::normalize(Container& c) {
+    if (!c.is_bitmap() || c.cardinality > kArrayMax) return;
+    std::vector<uint16_t> array;
+    array.reserve(c.cardinality);
+    for (uint32_t w = 0; w < kBitmapWords; ++w) {
+        for (uint64_t word = c.bits[w]; word; word &= word - 1) {
+            array.push_back(uint16_t(w * 64 + uint32_t(__builtin_ctzll(word))));
+        }
+    }
+    c.array.swap(array);
+    c.bits.clear();
+    c.bits.shrink_to_fit();
+}
+
+// b 为 nullptr 表示 b 中该块为空
+inline RoaringBitmap::Container RoaringBitmap::combine_containers(const Container& a, const Container* b,
+                                                                  bool andnot) {
+    Container r;
+    r.key = a.key;
+    if (!b) {
+        if (andnot) r = a;
+        return r;
+    }
+    if (a.is_bitmap() && b->is_bitmap()) {
+        r.bits.resize(kBitmapWords);
+        r.cardinality = roaring_kernels::and_words(a.bits.data(), b->bits.data(), kBitmapWords, andnot, r.bits.data());
+    } else if (a.is_bitmap()) {
+        // 位图 vs 数组：交集逐个探测；差集复制位图后清掉数组里的位
+        if (andnot) {
+            r.bits = a.bits;
+            r.cardinality = a.cardinality;
+            for (uint16_t low : b->array) {
+                uint64_t& word = r.bits[low >> 6];
+                uint64_t bit = uint64_t(1) << (low & 63);
+                r.cardinality -= (word & bit) ? 1 : 0;
+                word &= ~bit;
+            }
+        } else {
+            for (uint16_t low : b->array) {
+                if (a.contains(low)) r.array.push_back(low);
+            }
+            r.cardinality = uint32_t(r.array.size());
+        }
+    } else if (b->is_bitmap()) {
+        for (uint16_t low : a.array) {
+            if (b->contains(low) != andnot) r.array.push_back(low);
+        }
+        r.cardinality = uint32_t(r.array.size());
+    } else {
+        if (andnot) {
+            std::set_difference(a.array.begin(), a.array.end(), b->array.begin(), b->array.end(),
+                                std::back_inserter(r.array));
+        } else {
+            std::set_intersection(a.array.begin(), a.array.end(), b->array.begin(), b->array.end(),
+                                  std::back_inserter(r.array));
+        }
+        r.cardinality = uint32_t(r.array.size());
+    }
+    normalize(r);
+    return r;
+}
+
+inline RoaringBitmap RoaringBitmap::combine(const RoaringBitmap& a, const RoaringBitmap& b, bool andnot) {
+    RoaringBitmap result;
+    for (const Container& ca : a.containers_) {
+        const Container* cb = nullptr;
+        if (ca.key < b.key_index_.size() && b.key_index_[ca.key] >= 0) cb = &b.containers_[size_t(b.key_index_[ca.key])];
+        Container r = combine_containers(ca, cb, andnot);
+        if (r.cardinality > 0) result.containers_.push_back(std::move(r));
+    }
+    result.build_index();
+    return result;
+}
+
+// ---- 规则与快照 ----
+struct EligibilityRule {
+    std::string name;
+    bool deny;              // false：物品须在位图中（地域、库存）；true：物品不得在位图中（黑名单）
+    RoaringBitmap items;
+};
+
+struct EligibilitySnapshot {
+    uint64_t version = 0;
+    std::vector<std::string> rule_names;
+    RoaringBitmap eligible;  // 所有允许规则的交集减去所有拒绝规则
+};
+
+// 至少需要一条允许规则界定全集
+inline std::shared_ptr<EligibilitySnapshot> build_eligibility(const std::vector<EligibilityRule>& rules,
+                                                              uint64_t version) {
+    auto snapshot = std::make_shared<EligibilitySnapshot>();
+    snapshot->version = version;
+    bool have_allow = false;
+    for (const EligibilityRule& rule : rules) {
+        if (rule.deny) continue;
+        snapshot->eligible = have_allow ? RoaringBitmap::intersect(snapshot->eligible, rule.items) : rule.items;
+        have_allow = true;
+        snapshot->rule_names.push_back(rule.name);
+    }
+    if (!have_allow) {
+        std::cerr << "[Eligibility] 规则集缺少允许规则，无法确定可用物品全集" << std::endl;
+        return nullptr;
+    }
+    for (const EligibilityRule& rule : rules) {
+        if (!rule.deny) continue;
+        snapshot->eligible = RoaringBitmap::subtract(snapshot->eligible, rule.items);
+        snapshot->rule_names.push_back("!" + rule.name);
+    }
+    return snapshot;
+}
+
+// ---- 过滤 ----
+// 保留可用候选，保持原顺序；out 可以与 ids 相同（原地压缩）。返回保留个数。
+inline size_t filter_item_ids(const EligibilitySnapshot& snapshot, const int* ids, size_t n, int* out) {
+    size_t kept = 0;
+    for (size_t i = 0; i < n; ++i) {
+        int id = ids[i];
+        out[kept] = id;
+        kept += (id >= 0 && snapshot.eligible.contains(uint32_t(id))) ? 1 : 0;
+    }
+    return kept;
+}
+
+namespace eligibility_detail {
+
+template <typename T>
+inline void compact(std::vector<T>& col, const std::vector<uint8_t>& keep, size_t rows, size_t width = 1) {
+    if (col.size() != rows * width) return;  // 被裁剪掉的列
+    size_t kept = 0;
+    for (size_t i = 0; i < rows; ++i) {
+        if (!keep[i]) continue;
+        if (kept != i) std::copy(col.begin() + i * width, col.begin() + (i + 1) * width, col.begin() + kept * width);
+        ++kept;
+    }
+    col.resize(kept * width);
+}
+
+inline void compact_sparse(SparseColumnBuffer& col, const std::vector<uint8_t>& keep, size_t rows) {
+    if (col.rows() != rows) return;
+    size_t out = 0, kept_rows = 0;
+    for (size_t i = 0; i < rows; ++i) {
+        uint32_t begin = col.offsets[i], end = col.offsets[i + 1];
+        if (!keep[i]) continue;
+        for (uint32_t k = begin; k < end; ++k, ++out) {
+            col.ids[out] = col.ids[k];
+            col.weights[out] = col.weights[k];
+        }
+        col.offsets[++kept_rows] = uint32_t(out);
+    }
+    col.offsets.resize(kept_rows + 1);
+    col.ids.resize(out);
+    col.weights.resize(out);
+}
+
+}  // namespace eligibility_detail
+
+// 对已组装好的 batch（例如检索结果）原地剔除不可用行，所有列一起压缩。
+// batch 里没有 item_id 列时无法判断，返回 false 且不做修改。
+inline bool filter_feature_batch(const EligibilitySnapshot& snapshot, FeatureBatchBuffer& buf,
+                                 size_t* removed = nullptr) {
+    const size_t rows = buf.size();
+    if (rows && buf.item_id.size() != rows) return false;
+    std::vector<uint8_t> keep(rows);
+    size_t kept = 0;
+    for (size_t i = 0; i < rows; ++i) {
+        int id = buf.item_id[i];
+        keep[i] = (id >= 0 && snapshot.eligible.contains(uint32_t(id))) ? 1 : 0;
+        kept += keep[i];
+    }
+    if (removed) *removed = rows - kept;
+    if (kept == rows) return true;
+
+    using namespace eligibility_detail;
+    compact(buf.user_id, keep, rows);
+    compact(buf.item_id, keep, rows);
+    compact(buf.user_feature, keep, rows);
+    compact(buf.item_feature, keep, rows);
+    for (auto& col : buf.extra_values) compact(col, keep, rows);
+    if (buf.item_precompute_width > 0) compact(buf.item_precomputed, keep, rows, size_t(buf.item_precompute_width));
+    for (auto& col : buf.sparse) compact_sparse(col, keep, rows);
+    buf.rows = kept;
+    return true;
+}
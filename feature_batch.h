@@ -0,0 +1,148 @@
+// feature_batch.h
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "operator_interface.h"
+
+// 某个算子实际需要的列，加载时由 resolve_projection 解析
+struct ColumnProjection {
+    uint32_t base_mask = COL_BASE_ALL;
+    std::vector<size_t> catalog_columns;  // 目录宽列下标
+    bool encoded_columns = false;         // 算子接受压缩列：已编码的目录列不解码，以 EncodedColumn 传入
+};
+
+// 一列稀疏特征的存储，按行追加
+struct SparseColumnBuffer {
+    std::string name;
+    std::vector<uint32_t> offsets{0};
+    std::vector<uint32_t> ids;
+    std::vector<float> weights;
+
+    void clear() {
+        offsets.assign(1, 0);
+        ids.clear();
+        weights.clear();
+    }
+    // weights 为 nullptr 时按 1 记
+    void push_row(const uint32_t* row_ids, const float* row_weights, size_t n) {
+        ids.insert(ids.end(), row_ids, row_ids + n);
+        for (size_t i = 0; i < n; ++i) weights.push_back(row_weights ? row_weights[i] : 1.0f);
+        offsets.push_back(uint32_t(ids.size()));
+    }
+    size_t rows() const { return offsets.size() - 1; }
+};
+
+// ---- FeatureBatch 的 host 侧存储 ----
+// 持有各列内存，view() 给算子一个只读的 FeatureBatch 视图；
+// 视图在 buffer 被修改（增删列、resize）前有效。
+struct FeatureBatchBuffer {
+    std::vector<int> user_id;
+    std::vector<int> item_id;
+    std::vector<double> user_feature;
+    std::vector<double> item_feature;
+    std::vector<std::string> extra_names;
+    std::vector<std::vector<double>> extra_values;
+    std::vector<double> item_precomputed;  // 由 gather_item_precomputed 填充
+    int item_precompute_width = 0;
+    std::vector<SparseColumnBuffer> sparse;  // 每列行数须与 size() 一致，否则不进视图
+    std::vector<EncodedColumn> encoded;      // 指向目录存储，目录不变时一直有效
+    size_t rows = 0;
+
+    size_t size() const { return rows; }
+
+    void resize(size_t n) { resize(n, COL_BASE_ALL); }
+
+    // 只为 mask 中的基础列分配内存，其余清空（视图中为 nullptr）
+    void resize(size_t n, uint32_t mask) {
+        rows = n;
+        user_id.resize(mask & COL_USER_ID ? n : 0);
+        item_id.resize(mask & COL_ITEM_ID ? n : 0);
+        user_feature.resize(mask & COL_USER_FEATURE ? n : 0);
+        item_feature.resize(mask & COL_ITEM_FEATURE ? n : 0);
+        for (auto& col : extra_values) col.resize(n);
+    }
+
+    void assign(const Feature* features, size_t n) {
+        clear_extra();
+        item_precomputed.clear();
+        item_precompute_width = 0;
+        resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            user_id[i] = features[i].user_id;
+            item_id[i] = features[i].item_id;
+            user_feature[i] = features[i].user_feature;
+            item_feature[i] = features[i].item_feature;
+        }
+    }
+
+    // 已存在同名列时直接复用
+    std::vector<double>& add_column(const std::string& name) {
+        for (size_t i = 0; i < extra_names.size(); ++i) {
+            if (extra_names[i] == name) return extra_values[i];
+        }
+        extra_names.push_back(name);
+        extra_values.push_back(std::vector<double>(size()));
+        return extra_values.back();
+    }
+
+    void clear_extra() {
+        extra_names.clear();
+        extra_values.clear();
+        sparse.clear();
+        encoded.clear();
+    }
+
+    // 已存在同名列时清空后复用
+    SparseColumnBuffer& add_sparse_column(const std::string& name) {
+        for (auto& col : sparse) {
+            if (col.name == name) {
+                col.clear();
+                return col;
+            }
+        }
+        sparse.push_back(SparseColumnBuffer());
+        sparse.back().name = name;
+        return sparse.back();
+    }
+
+    FeatureBatch view() {
+        columns_.resize(extra_names.size());
+        for (size_t i = 0; i < columns_.size(); ++i) {
+            columns_[i] = FeatureColumn{extra_names[i].c_str(), extra_values[i].data()};
+        }
+        FeatureBatch batch;
+        batch.size = size();
+        batch.user_id = present(user_id);
+        batch.item_id = present(item_id);
+        batch.user_feature = present(user_feature);
+        batch.item_feature = present(item_feature);
+        batch.extra = columns_.data();
+        batch.num_extra = columns_.size();
+        sparse_columns_.clear();
+        for (const auto& col : sparse) {
+            if (col.rows() != size()) continue;
+            sparse_columns_.push_back(SparseFeatureColumn{col.name.c_str(), col.offsets.data(), col.ids.data(),
+                                                          col.weights.data()});
+        }
+        batch.sparse = sparse_columns_.data();
+        batch.num_sparse = sparse_columns_.size();
+        batch.encoded = encoded.empty() ? nullptr : encoded.data();
+        batch.num_encoded = encoded.size();
+        if (item_precompute_width > 0 && item_precomputed.size() == size() * item_precompute_width) {
+            batch.item_precomputed = item_precomputed.data();
+            batch.item_precompute_width = item_precompute_width;
+        }
+        return batch;
+    }
+
+private:
+    template <typename T>
+    const T* present(const std::vector<T>& col) const {
+        return rows && col.size() == rows ? col.data() : nullptr;
+    }
+
+    std::vector<FeatureColumn> columns_;
+    std::vector<SparseFeatureColumn> sparse_columns_;
+};
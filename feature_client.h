@@ -0,0 +1,299 @@
+// feature_client.h
+#pragma once
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "feature_service.h"
+#include "operator_interface.h"
+
+extern char** environ;
+
+// ---- 异步特征抓取客户端 ----
+// 一条连接上最多 max_in_flight 个请求在途，fetch_async 发出即返回，响应由接收线程按 request_id
+// 直接读进调用方的 out 缓冲区；wait 等某个请求完成。连接断开后所有在途和后续请求都失败。
+class FeatureClient {
+public:
+    // 拉起替身服务进程（socketpair 一端传给子进程），失败返回 nullptr
+    static std::unique_ptr<FeatureClient> spawn(const std::string& server_binary, const FeatureServiceOptions& options,
+                                                size_t max_in_flight = 8) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            std::cerr << "[FeatureClient] socketpair 失败" << std::endl;
+            return nullptr;
+        }
+        fcntl(fds[0], F_SETFD, FD_CLOEXEC);  // 只有服务端那一端留给子进程
+
+        std::string fd_arg = std::to_string(fds[1]);
+        std::string latency_arg = std::to_string(options.latency_us);
+        std::string per_key_arg = std::to_string(options.per_key_ns);
+        char* argv[] = {const_cast<char*>(server_binary.c_str()), const_cast<char*>(fd_arg.c_str()),
+                        const_cast<char*>(latency_arg.c_str()), const_cast<char*>(per_key_arg.c_str()), nullptr};
+        pid_t pid = -1;
+        int rc = posix_spawn(&pid, server_binary.c_str(), nullptr, nullptr, argv, environ);
+        ::close(fds[1]);
+        if (rc != 0) {
+            std::cerr << "[FeatureClient] 无法启动特征服务: " << server_binary << " (" << std::strerror(rc) << ")"
+                      << std::endl;
+            ::close(fds[0]);
+            return nullptr;
+        }
+        return std::unique_ptr<FeatureClient>(new FeatureClient(fds[0], pid, max_in_flight));
+    }
+
+    // 销毁前须 wait 完所有发出的 ticket，否则接收线程可能往已释放的 out 里写
+    ~FeatureClient() {
+        shutdown(fd_, SHUT_WR);  // 服务端读到 EOF 后发完在途响应再退出
+        if (receiver_.joinable()) receiver_.join();
+        ::close(fd_);
+        if (pid_ > 0) waitpid(pid_, nullptr, 0);
+    }
+
+    FeatureClient(const FeatureClient&) = delete;
+    FeatureClient& operator=(const FeatureClient&) = delete;
+
+    // 发出一次查找，返回 ticket；out 至少 n 个元素，须存活到 wait 返回。在途数已满时阻塞。
+    // 连接已断开时返回 0
+    uint64_t fetch_async(const FeatureKey* keys, size_t n, FeatureValue* out) {
+        uint64_t ticket;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            slot_free_.wait(lock, [&] { return broken_ || pending_.size() < max_in_flight_; });
+            if (broken_) return 0;
+            ticket = next_ticket_++;
+            Pending& p = pending_[ticket];
+            p.out = out;
+            p.count = n;
+        }
+        FeatureWireHeader header = {kFeatureWireMagic, uint32_t(n), ticket};
+        iovec iov[2] = {{&header, sizeof(header)}, {const_cast<FeatureKey*>(keys), n * sizeof(FeatureKey)}};
+        std::lock_guard<std::mutex> send_lock(send_mutex_);
+        if (!write_all(iov, n ? 2 : 1)) fail_all();
+        return ticket;
+    }
+
+    // 等 ticket 完成，成功返回 true；ticket 为 0 或连接断开返回 false。
+    // 返回后接收线程不会再写这个 ticket 的 out
+    bool wait(uint64_t ticket) {
+        if (!ticket) return false;
+        std::unique_lock<std::mutex> lock(mutex_);
+        // 等待期间别的线程插入会让 unordered_map 重新散列，迭代器失效，每次都重新查；
+        // 失败的请求已被 fail_all 移除，查不到即失败
+        done_.wait(lock, [&] {
+            auto it = pending_.find(ticket);
+            return it == pending_.end() || it->second.state != Pending::kWaiting;
+        });
+        auto it = pending_.find(ticket);
+        if (it == pending_.end()) return false;
+        pending_.erase(it);
+        slot_free_.notify_one();
+        return true;
+    }
+
+    bool fetch(const FeatureKey* keys, size_t n, FeatureValue* out) { return wait(fetch_async(keys, n, out)); }
+
+    size_t max_in_flight() const { return max_in_flight_; }
+
+private:
+    // 在途请求：接收线程写 out 时不持锁，state 由 mutex_ 保护。wait 返回后才释放在途名额，
+    // 保证 out 在被读完之前不会被别的请求复用
+    struct Pending {
+        enum State { kWaiting, kDone };
+        FeatureValue* out = nullptr;
+        size_t count = 0;
+        State state = kWaiting;
+    };
+
+    FeatureClient(int fd, pid_t pid, size_t max_in_flight)
+        : fd_(fd), pid_(pid), max_in_flight_(std::max<size_t>(1, max_in_flight)) {
+        receiver_ = std::thread([this] { receive_loop(); });
+    }
+
+    // 用 sendmsg + MSG_NOSIGNAL 而不是 writev：服务进程挂掉后写端得到 EPIPE 而不是 SIGPIPE，只让请求失败
+    bool write_all(iovec* iov, int count) {
+        while (count > 0) {
+            msghdr msg;
+            std::memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = size_t(count);
+            ssize_t n = sendmsg(fd_, &msg, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            size_t left = size_t(n);
+            while (count > 0 && left >= iov->iov_len) {
+                left -= iov->iov_len;
+                ++iov;
+                --count;
+            }
+            if (count > 0) {
+                iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+                iov->iov_len -= left;
+            }
+        }
+        return true;
+    }
+
+    bool read_all(void* dst, size_t size) {
+        char* p = static_cast<char*>(dst);
+        while (size > 0) {
+            ssize_t n = ::read(fd_, p, size);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n;
+            size -= size_t(n);
+        }
+        return true;
+    }
+
+    void receive_loop() {
+        for (;;) {
+            FeatureWireHeader header;
+            if (!read_all(&header, sizeof(header)) || header.magic != kFeatureWireMagic) break;
+            FeatureValue* out = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = pending_.find(header.request_id);
+                if (it == pending_.end() || it->second.count != header.count) break;
+                out = it->second.out;
+                receiving_ = header.request_id;
+            }
+            const bool ok = read_all(out, header.count * sizeof(FeatureValue));
+            std::lock_guard<std::mutex> lock(mutex_);
+            receiving_ = 0;
+            if (!ok) break;
+            pending_[header.request_id].state = Pending::kDone;
+            done_.notify_all();
+        }
+        fail_all();
+    }
+
+    // 移除所有未完成的请求，等在它们上的 wait 返回 false。接收线程正在写的那个留给接收线程收尾：
+    // 它读完（或读失败后再次调用这里）之前，调用方的 out 不能被释放
+    void fail_all() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        broken_ = true;
+        for (auto it = pending_.begin(); it != pending_.end();) {
+            if (it->second.state == Pending::kWaiting && it->first != receiving_) {
+                it = pending_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        done_.notify_all();
+        slot_free_.notify_all();
+    }
+
+    const int fd_;
+    const pid_t pid_;
+    const size_t max_in_flight_;
+
+    std::mutex mutex_;
+    std::condition_variable done_;
+    std::condition_variable slot_free_;
+    std::unordered_map<uint64_t, Pending> pending_;
+    uint64_t next_ticket_ = 1;
+    uint64_t receiving_ = 0;  // 接收线程正在写 out 的 ticket，0 表示没有
+    bool broken_ = false;
+
+    std::mutex send_mutex_;
+    std::thread receiver_;
+};
+
+// ---- 合批 + 流水线打分 ----
+// 每个请求带一组候选 (user_id, item_id)。requests_per_batch 个请求的 key 合成一次抓取，
+// 最多 depth 批同时在途：第 i 批的特征到了就先把第 i + depth 批发出去，再给第 i 批打分，
+// 打分和后面几批的网络等待重叠。depth 为 1 时退化为合批但不重叠。
+struct FeatureRequest {
+    std::vector<FeatureKey> keys;
+    std::vector<double> scores;  // 由 score_with_prefetch 填充
+};
+
+struct FetchPipelineOptions {
+    size_t requests_per_batch = 8;
+    size_t depth = 4;
+};
+
+struct FetchPipelineStats {
+    size_t batches = 0;
+    double wait_us = 0;   // 阻塞在等特征上的时间
+    double score_us = 0;  // 打分时间
+};
+
+inline bool score_with_prefetch(FeatureClient& client, IScoreOperator* op, std::vector<FeatureRequest>& requests,
+                                const FetchPipelineOptions& options, FetchPipelineStats* stats = nullptr) {
+    typedef std::chrono::steady_clock Clock;
+    const size_t per_batch = std::max<size_t>(1, options.requests_per_batch);
+    const size_t depth = std::max<size_t>(1, std::min(options.depth, client.max_in_flight()));
+    const size_t num_batches = (requests.size() + per_batch - 1) / per_batch;
+
+    // depth + 1 个槽轮转：发出第 i + depth 批时复用的是第 i - 1 批的槽，它已经打完分
+    struct Slot {
+        std::vector<FeatureKey> keys;
+        std::vector<FeatureValue> values;
+        uint64_t ticket = 0;
+    };
+    std::vector<Slot> slots(depth + 1);
+    auto issue = [&](size_t b) {
+        Slot& slot = slots[b % slots.size()];
+        slot.keys.clear();
+        for (size_t r = b * per_batch; r < std::min(requests.size(), (b + 1) * per_batch); ++r) {
+            slot.keys.insert(slot.keys.end(), requests[r].keys.begin(), requests[r].keys.end());
+        }
+        slot.values.resize(slot.keys.size());
+        slot.ticket = client.fetch_async(slot.keys.data(), slot.keys.size(), slot.values.data());
+    };
+
+    FetchPipelineStats local;
+    std::vector<Feature> features;
+    std::vector<double> scores;
+    for (size_t b = 0; b < std::min(depth, num_batches); ++b) issue(b);
+    for (size_t b = 0; b < num_batches; ++b) {
+        Slot& slot = slots[b % slots.size()];
+        auto wait_start = Clock::now();
+        bool ok = client.wait(slot.ticket);
+        auto score_start = Clock::now();
+        local.wait_us += std::chrono::duration<double, std::micro>(score_start - wait_start).count();
+        if (!ok) {
+            // 连接已断：后面已发出的批仍可能被接收线程写入 slots，等它们都结束再返回
+            for (size_t rest = b + 1; rest < std::min(b + depth, num_batches); ++rest) {
+                client.wait(slots[rest % slots.size()].ticket);
+            }
+            return false;
+        }
+        if (b + depth < num_batches) issue(b + depth);
+
+        features.resize(slot.keys.size());
+        for (size_t i = 0; i < slot.keys.size(); ++i) {
+            features[i] = Feature{slot.keys[i].user_id, slot.keys[i].item_id, slot.values[i].user_feature,
+                                  slot.values[i].item_feature};
+        }
+        scores.resize(features.size());
+        op->compute_score_batch(features.data(), features.size(), scores.data());
+        size_t offset = 0;
+        for (size_t r = b * per_batch; r < std::min(requests.size(), (b + 1) * per_batch); ++r) {
+            requests[r].scores.assign(scores.begin() + offset, scores.begin() + offset + requests[r].keys.size());
+            offset += requests[r].keys.size();
+        }
+        local.score_us += std::chrono::duration<double, std::micro>(Clock::now() - score_start).count();
+        local.batches++;
+    }
+    if (stats) *stats = local;
+    return true;
+}
@@ -0,0 +1,19 @@
+// feature_server.cpp
+// 本地替身特征服务：feature_server <socket fd> [延迟us] [每key服务时间ns]
+// 由 FeatureClient::spawn 拉起，fd 为 socketpair 的一端，对端关闭后退出
+
+#include <cstdlib>
+#include <iostream>
+
+#include "feature_service.h"
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "用法: feature_server <socket fd> [延迟us=500] [每key服务时间ns=0]" << std::endl;
+        return 2;
+    }
+    FeatureServiceOptions options;
+    if (argc > 2) options.latency_us = uint32_t(std::strtoul(argv[2], nullptr, 10));
+    if (argc > 3) options.per_key_ns = uint32_t(std::strtoul(argv[3], nullptr, 10));
+    return run_feature_server(std::atoi(argv[1]), options);
+}
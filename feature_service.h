@@ -0,0 +1,141 @@
+// feature_service.h
+#pragma once
+
+#include <poll.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <vector>
+
+// ---- 特征服务协议与本地替身服务 ----
+// 线上 Feature 的特征来自特征服务。这里定义 host 与服务之间的线协议，并给出一个本地替身实现
+// （feature_server 进程，见 feature_server.cpp），按配置的延迟回包，用来验证客户端的合批与流水线。
+// 请求：FeatureWireHeader + count 个 FeatureKey；响应：同 request_id 的 FeatureWireHeader + count 个 FeatureValue。
+// 同一连接上可以有任意多个请求在途，响应按各自到期时间返回，不保证与请求同序。
+
+struct FeatureKey {
+    int32_t user_id;
+    int32_t item_id;
+};
+
+struct FeatureValue {
+    double user_feature;
+    double item_feature;
+};
+
+constexpr uint32_t kFeatureWireMagic = 0x46545246;  // "FRTF"
+constexpr uint32_t kFeatureMaxKeysPerRequest = 1u << 20;
+
+struct FeatureWireHeader {
+    uint32_t magic;
+    uint32_t count;
+    uint64_t request_id;
+};
+
+// 替身服务返回的特征，与业务线程本地构造 Feature 的公式一致，客户端据此校验
+inline FeatureValue feature_service_lookup(const FeatureKey& key) {
+    return FeatureValue{key.user_id * 0.1 + key.item_id * 0.05, key.user_id * 0.2 + key.item_id * 0.1};
+}
+
+struct FeatureServiceOptions {
+    uint32_t latency_us = 500;  // 每个请求的固定往返延迟
+    uint32_t per_key_ns = 0;    // 每个 key 追加的服务时间
+};
+
+// 在 fd 上服务直到对端关闭。请求到达即算好响应，到期（到达时刻 + 延迟）后再发出；
+// 单线程 + poll，在途请求互不阻塞，模拟一个并发处理、只有延迟没有排队的服务
+inline int run_feature_server(int fd, const FeatureServiceOptions& options) {
+    typedef std::chrono::steady_clock Clock;
+    struct Pending {
+        Clock::time_point due;
+        uint64_t seq;
+        std::vector<char> bytes;
+        bool operator<(const Pending& other) const {  // priority_queue 是大顶堆，反过来比
+            return due != other.due ? due > other.due : seq > other.seq;
+        }
+    };
+    std::priority_queue<Pending> pending;
+    std::vector<char> inbox;
+    uint64_t seq = 0;
+    bool open = true;
+
+    while (open || !pending.empty()) {
+        // 等到有新请求或最早的响应到期；ppoll 的超时精确到纳秒，poll 的毫秒粒度会把亚毫秒延迟放大
+        timespec timeout = {0, 0};
+        const timespec* timeout_ptr = nullptr;
+        if (!pending.empty()) {
+            int64_t wait_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(pending.top().due - Clock::now()).count();
+            if (wait_ns > 0) {
+                timeout.tv_sec = time_t(wait_ns / 1000000000);
+                timeout.tv_nsec = long(wait_ns % 1000000000);
+            }
+            timeout_ptr = &timeout;
+        }
+        if (open) {
+            pollfd pfd = {fd, POLLIN, 0};
+            if (ppoll(&pfd, 1, timeout_ptr, nullptr) < 0 && errno != EINTR) return 1;
+            if (pfd.revents & (POLLIN | POLLHUP)) {
+                char chunk[64 << 10];
+                ssize_t got = recv(fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+                if (got == 0) {
+                    open = false;
+                } else if (got > 0) {
+                    inbox.insert(inbox.end(), chunk, chunk + got);
+                } else if (errno != EAGAIN && errno != EINTR) {
+                    return 1;
+                }
+            }
+        } else if (timeout_ptr) {
+            nanosleep(timeout_ptr, nullptr);
+        }
+
+        // 解析所有完整的请求
+        size_t consumed = 0;
+        const Clock::time_point now = Clock::now();
+        while (inbox.size() - consumed >= sizeof(FeatureWireHeader)) {
+            FeatureWireHeader header;
+            std::memcpy(&header, inbox.data() + consumed, sizeof(header));
+            if (header.magic != kFeatureWireMagic || header.count > kFeatureMaxKeysPerRequest) return 1;
+            const size_t need = sizeof(header) + size_t(header.count) * sizeof(FeatureKey);
+            if (inbox.size() - consumed < need) break;
+
+            Pending response;
+            response.due = now + std::chrono::microseconds(options.latency_us) +
+                           std::chrono::nanoseconds(uint64_t(options.per_key_ns) * header.count);
+            response.seq = seq++;
+            response.bytes.resize(sizeof(header) + size_t(header.count) * sizeof(FeatureValue));
+            std::memcpy(response.bytes.data(), &header, sizeof(header));
+            const char* keys = inbox.data() + consumed + sizeof(header);
+            char* values = response.bytes.data() + sizeof(header);
+            for (uint32_t i = 0; i < header.count; ++i) {
+                FeatureKey key;
+                std::memcpy(&key, keys + i * sizeof(FeatureKey), sizeof(key));
+                FeatureValue value = feature_service_lookup(key);
+                std::memcpy(values + i * sizeof(FeatureValue), &value, sizeof(value));
+            }
+            pending.push(std::move(response));
+            consumed += need;
+        }
+        inbox.erase(inbox.begin(), inbox.begin() + consumed);
+
+        // 发出所有已到期的响应
+        while (!pending.empty() && pending.top().due <= Clock::now()) {
+            const std::vector<char>& bytes = pending.top().bytes;
+            size_t sent = 0;
+            while (sent < bytes.size()) {
+                ssize_t n = send(fd, bytes.data() + sent, bytes.size() - sent, MSG_NOSIGNAL);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) return 1;
+                sent += size_t(n);
+            }
+            pending.pop();
+        }
+    }
+    return 0;
+}
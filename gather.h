@@ -0,0 +1,113 @@
+// gather.h
+#pragma once
+
+#include <iostream>
+
+#include "feature_batch.h"
+#include "item_catalog.h"
+#include "operator_interface.h"
+
+// ---- 列裁剪 + gather 阶段 ----
+// 加载时把算子声明的列解析成 ColumnProjection（目录里不存在的列直接让加载失败），
+// 请求时只为这些列按 item_id 从目录拉数据，未声明的列不分配、不搬运。
+
+// 请求侧（用户）上下文
+struct UserContext {
+    int user_id;
+    double user_feature;
+};
+
+inline bool resolve_projection(IScoreOperator* op, const ItemCatalog& catalog, ColumnProjection* out) {
+    ColumnProjection projection;
+    projection.base_mask = op->required_base_columns() & COL_BASE_ALL;
+    if (op->item_precompute_width() > 0) projection.base_mask |= COL_ITEM_ID;  // gather 预计算列要用
+    projection.encoded_columns = op->accepts_encoded_columns();
+    if (projection.encoded_columns) projection.base_mask |= COL_ITEM_ID;  // 压缩列按 item_id 解码
+
+    const char* const* names = op->required_catalog_columns();
+    if (!names) {
+        for (size_t i = 0; i < catalog.column_names.size(); ++i) projection.catalog_columns.push_back(i);
+    } else {
+        for (; *names; ++names) {
+            int index = catalog.find_column(*names);
+            if (index < 0) {
+                std::cerr << "[Gather] " << op->name() << " 需要的列不存在: " << *names << std::endl;
+                return false;
+            }
+            projection.catalog_columns.push_back(size_t(index));
+        }
+    }
+    *out = projection;
+    return true;
+}
+
+// 按投影为一批候选物品组装 FeatureBatch；目录外的物品特征按 0 填充。
+// 已编码的目录列：算子接受压缩列时只传描述符（不搬运），否则解码成 double 列。
+inline void gather_features(const ColumnProjection& projection, const ItemCatalog& catalog,
+                            const UserContext& user, const int* item_ids, size_t n,
+                            FeatureBatchBuffer& buf) {
+    // 按投影顺序复用上一批的列内存，避免每批重新分配
+    size_t num_gathered = 0;
+    buf.encoded.clear();
+    for (size_t c : projection.catalog_columns) {
+        if (projection.encoded_columns && catalog.is_encoded(c)) {
+            buf.encoded.push_back(catalog.encoded_view(c));
+        } else {
+            ++num_gathered;
+        }
+    }
+    buf.extra_names.resize(num_gathered);
+    buf.extra_values.resize(num_gathered);
+    buf.sparse.clear();  // 稀疏特征来自请求本身，由调用方在 gather 之后追加
+    buf.item_precomputed.clear();
+    buf.item_precompute_width = 0;
+    buf.resize(n, projection.base_mask);
+
+    if (projection.base_mask & COL_USER_ID) buf.user_id.assign(n, user.user_id);
+    if (projection.base_mask & COL_USER_FEATURE) buf.user_feature.assign(n, user.user_feature);
+    if (projection.base_mask & COL_ITEM_ID) buf.item_id.assign(item_ids, item_ids + n);
+    if (projection.base_mask & COL_ITEM_FEATURE) {
+        for (size_t i = 0; i < n; ++i) {
+            buf.item_feature[i] = catalog.contains(item_ids[i]) ? catalog.item_feature[item_ids[i]] : 0.0;
+        }
+    }
+    size_t k = 0;
+    for (size_t c : projection.catalog_columns) {
+        const bool encoded = catalog.is_encoded(c);
+        if (projection.encoded_columns && encoded) continue;
+        buf.extra_names[k] = catalog.column_names[c];
+        std::vector<double>& dst = buf.extra_values[k++];
+        if (encoded) {
+            const EncodedColumn col = catalog.encoded_view(c);
+            for (size_t i = 0; i < n; ++i) dst[i] = decode_value(col, item_ids[i]);
+        } else {
+            const HugeVector<double>& src = catalog.columns[c];
+            for (size_t i = 0; i < n; ++i) {
+                dst[i] = catalog.contains(item_ids[i]) ? src[item_ids[i]] : 0.0;
+            }
+        }
+    }
+}
+
+// 一个 batch 实际搬运的字节数（用于观察裁剪效果）；给出 catalog 时不计以压缩形式直接传给算子的列
+inline size_t gathered_bytes(const ColumnProjection& projection, size_t n, const ItemCatalog* catalog = nullptr) {
+    size_t per_row = 0;
+    if (projection.base_mask & COL_USER_ID) per_row += sizeof(int);
+    if (projection.base_mask & COL_ITEM_ID) per_row += sizeof(int);
+    if (projection.base_mask & COL_USER_FEATURE) per_row += sizeof(double);
+    if (projection.base_mask & COL_ITEM_FEATURE) per_row += sizeof(double);
+    for (size_t c : projection.catalog_columns) {
+        if (catalog && projection.encoded_columns && catalog->is_encoded(c)) continue;
+        per_row += sizeof(double);
+    }
+    return per_row * n;
+}
+
+// 请求是否带齐了算子声明的稀疏特征；缺失时返回第一个缺的列名，齐全返回 nullptr
+inline const char* missing_sparse_column(IScoreOperator* op, const FeatureBatch& batch) {
+    const char* const* names = op->required_sparse_columns();
+    for (; names && *names; ++names) {
+        if (!batch.find_sparse(*names)) return *names;
+    }
+    return nullptr;
+}
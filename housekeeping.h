@@ -0,0 +1,72 @@
+// housekeeping.h
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ---- 后台(housekeeping)核心 ----
+// 加载期的重活（物品预计算、参数解压等）跑在这些核心上，避免抢业务线程的核。
+// 通过环境变量 HOTPLUG_HOUSEKEEPING_CPUS 配置，格式同 taskset，如 "0-1,6"；未配置时不绑核。
+
+inline std::vector<int> parse_cpu_list(const std::string& list) {
+    std::vector<int> cpus;
+    std::istringstream ss(list);
+    std::string part;
+    while (std::getline(ss, part, ',')) {
+        if (part.empty()) continue;
+        size_t dash = part.find('-');
+        int first = std::atoi(part.substr(0, dash).c_str());
+        int last = dash == std::string::npos ? first : std::atoi(part.substr(dash + 1).c_str());
+        for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+inline const std::vector<int>& housekeeping_cpus() {
+    static const std::vector<int> cpus = [] {
+        const char* env = std::getenv("HOTPLUG_HOUSEKEEPING_CPUS");
+        return env ? parse_cpu_list(env) : std::vector<int>();
+    }();
+    return cpus;
+}
+
+// 后台线程数：配置了核心就用核心数，否则用硬件线程数
+inline int housekeeping_thread_num() {
+    if (!housekeeping_cpus().empty()) return int(housekeeping_cpus().size());
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? int(n) : 1;
+}
+
+// 把当前线程绑到 housekeeping 核心上；未配置时什么也不做
+inline void pin_to_housekeeping_cpus() {
+    const std::vector<int>& cpus = housekeeping_cpus();
+    if (cpus.empty()) return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+// 在 housekeeping 线程上并行执行 fn(begin, end)，把 [0, n) 均分；max_threads 为 0 时用 housekeeping 线程数
+template <typename Fn>
+void housekeeping_parallel_for(size_t n, Fn fn, size_t max_threads = 0) {
+    size_t thread_num = std::min<size_t>(max_threads ? max_threads : size_t(housekeeping_thread_num()), n ? n : 1);
+    size_t chunk = (n + thread_num - 1) / thread_num;
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < thread_num; ++t) {
+        size_t begin = t * chunk, end = std::min(n, begin + chunk);
+        if (begin >= end) break;
+        workers.emplace_back([=] {
+            pin_to_housekeeping_cpus();
+            fn(begin, end);
+        });
+    }
+    for (auto& th : workers) th.join();
+}
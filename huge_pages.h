@@ -0,0 +1,280 @@
+// huge_pages.h
+#pragma once
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+// ---- 大页内存 ----
+// 打分时随机访问的大表（目录列、物品预计算表、参数）按 4K 页映射时，每次 gather 几乎都是一次 dTLB miss。
+// huge_page_map 按策略依次尝试 1G / 2M hugetlbfs 大页（需要系统预留，mmap 时就能知道成败），
+// 再退到 2MB 对齐的普通匿名内存 + madvise(MADV_HUGEPAGE) 交给 THP，最后是普通 4K 页。
+// THP 是否真的生效要等缺页后才知道，smaps_huge_bytes 从 /proc/self/smaps 核对实际落在大页上的字节数。
+// 策略由环境变量 HOTPLUG_HUGE_PAGES 配置：off / thp / 2m / 1g / auto（默认：够 1GB 才试 1G，再 2M，再 THP）。
+
+enum HugePagePolicy {
+    HUGE_PAGES_OFF = 0,  // 4K，并 MADV_NOHUGEPAGE 防止 THP=always 时被合并
+    HUGE_PAGES_THP,
+    HUGE_PAGES_2M,
+    HUGE_PAGES_1G,
+    HUGE_PAGES_AUTO,
+};
+
+constexpr size_t kHugePage2M = size_t(2) << 20;
+constexpr size_t kHugePage1G = size_t(1) << 30;
+
+inline const char* huge_page_policy_name(HugePagePolicy policy) {
+    static const char* const names[] = {"off", "thp", "2m", "1g", "auto"};
+    return names[policy];
+}
+
+// 无法识别时返回 fallback
+inline HugePagePolicy parse_huge_page_policy(const std::string& text, HugePagePolicy fallback) {
+    for (int p = HUGE_PAGES_OFF; p <= HUGE_PAGES_AUTO; ++p) {
+        if (text == huge_page_policy_name(HugePagePolicy(p))) return HugePagePolicy(p);
+    }
+    return fallback;
+}
+
+inline HugePagePolicy default_huge_page_policy() {
+    static const HugePagePolicy policy = [] {
+        const char* env = std::getenv("HOTPLUG_HUGE_PAGES");
+        return env ? parse_huge_page_policy(env, HUGE_PAGES_AUTO) : HUGE_PAGES_AUTO;
+    }();
+    return policy;
+}
+
+// 一段映射：data 即映射起点，size 已按所用页大小取整，unmap 时原样交回
+struct HugePageBlock {
+    void* data = nullptr;
+    size_t size = 0;
+    const char* mode = "";  // hugetlb-1g / hugetlb-2m / thp / 4k
+};
+
+namespace huge_page_detail {
+
+inline size_t align_up(size_t n, size_t align) { return (n + align - 1) / align * align; }
+
+inline void* map_hugetlb(size_t size, int size_flag) {
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | size_flag, -1, 0);
+    return p == MAP_FAILED ? nullptr : p;
+}
+
+// 多映射 2MB 后把首尾裁掉，得到起点 2MB 对齐、长度恰好为 size 的映射，THP 才能整页覆盖
+inline void* map_aligned(size_t size, size_t align) {
+    void* raw = mmap(nullptr, size + align, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return nullptr;
+    uintptr_t begin = reinterpret_cast<uintptr_t>(raw);
+    uintptr_t aligned = (begin + align - 1) / align * align;
+    if (aligned > begin) munmap(raw, aligned - begin);
+    if (begin + size + align > aligned + size) munmap(reinterpret_cast<void*>(aligned + size), begin + align - aligned);
+    return reinterpret_cast<void*>(aligned);
+}
+
+}  // namespace huge_page_detail
+
+// 按策略分配；所有路径都失败（内存不足）时 data 为 nullptr
+inline HugePageBlock huge_page_map(size_t bytes, HugePagePolicy policy) {
+    using namespace huge_page_detail;
+    HugePageBlock block;
+    bytes = std::max<size_t>(bytes, 1);
+    if (policy == HUGE_PAGES_1G || (policy == HUGE_PAGES_AUTO && bytes >= kHugePage1G)) {
+        block.size = align_up(bytes, kHugePage1G);
+        if ((block.data = map_hugetlb(block.size, MAP_HUGE_1GB))) {
+            block.mode = "hugetlb-1g";
+            return block;
+        }
+    }
+    if (policy == HUGE_PAGES_1G || policy == HUGE_PAGES_2M || policy == HUGE_PAGES_AUTO) {
+        block.size = align_up(bytes, kHugePage2M);
+        if ((block.data = map_hugetlb(block.size, MAP_HUGE_2MB))) {
+            block.mode = "hugetlb-2m";
+            return block;
+        }
+    }
+    if (policy != HUGE_PAGES_OFF) {
+        block.size = align_up(bytes, kHugePage2M);
+        if ((block.data = map_aligned(block.size, kHugePage2M))) {
+            block.mode = madvise(block.data, block.size, MADV_HUGEPAGE) == 0 ? "thp" : "4k";
+            return block;
+        }
+    }
+    block.size = align_up(bytes, 4096);
+    void* p = mmap(nullptr, block.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    block.data = p == MAP_FAILED ? nullptr : p;
+    if (block.data) madvise(block.data, block.size, MADV_NOHUGEPAGE);
+    block.mode = "4k";
+    return block;
+}
+
+inline void huge_page_unmap(const HugePageBlock& block) {
+    if (block.data) munmap(block.data, block.size);
+}
+
+// 与 [addr, addr + len) 相交的各 VMA 中落在大页上的字节数（AnonHugePages + hugetlb）。
+// 相邻的同属性映射会被内核合并成一个 VMA，这时统计的是整个 VMA
+inline size_t smaps_huge_bytes(const std::vector<std::pair<const void*, size_t>>& ranges) {
+    FILE* f = std::fopen("/proc/self/smaps", "r");
+    if (!f) return 0;
+    char line[512];
+    bool overlaps = false;
+    size_t total_kb = 0;
+    while (std::fgets(line, sizeof(line), f)) {
+        unsigned long long begin, end;
+        if (std::sscanf(line, "%llx-%llx ", &begin, &end) == 2 && std::strchr(line, '-') < std::strchr(line, ' ')) {
+            overlaps = false;
+            for (const auto& r : ranges) {
+                uintptr_t lo = reinterpret_cast<uintptr_t>(r.first);
+                if (lo < end && lo + r.second > begin) overlaps = true;
+            }
+            continue;
+        }
+        size_t kb = 0;
+        if (overlaps && (std::sscanf(line, "AnonHugePages: %zu kB", &kb) == 1 ||
+                         std::sscanf(line, "Private_Hugetlb: %zu kB", &kb) == 1 ||
+                         std::sscanf(line, "Shared_Hugetlb: %zu kB", &kb) == 1)) {
+            total_kb += kb;
+        }
+    }
+    std::fclose(f);
+    return total_kb << 10;
+}
+
+inline size_t smaps_huge_bytes(const void* addr, size_t len) {
+    return smaps_huge_bytes(std::vector<std::pair<const void*, size_t>>{std::make_pair(addr, len)});
+}
+
+// ---- 大块分配登记 ----
+// HugePageAllocator 的大块都经过这里：记下每块的映射长度和页模式，释放时按原样 munmap，
+// usage() 汇总并用 smaps 核对
+class HugePageRegistry {
+public:
+    struct Usage {
+        size_t blocks = 0;
+        size_t mapped_bytes = 0;
+        size_t hugetlb_bytes = 0;    // hugetlbfs 大页，mmap 成功即保证
+        size_t thp_bytes = 0;        // 申请了 THP 的字节数
+        size_t verified_bytes = 0;   // smaps 核对后实际在大页上的字节数
+    };
+
+    // 故意不析构：全局的 HugeVector（如物品目录）在静态析构阶段还要经这里释放
+    static HugePageRegistry& instance() {
+        static HugePageRegistry* registry = new HugePageRegistry();
+        return *registry;
+    }
+
+    void set_policy(HugePagePolicy policy) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        policy_ = policy;
+    }
+
+    HugePagePolicy policy() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return policy_;
+    }
+
+    void* allocate(size_t bytes) {
+        HugePageBlock block = huge_page_map(bytes, policy());
+        if (!block.data) throw std::bad_alloc();
+        std::lock_guard<std::mutex> lock(mutex_);
+        blocks_[block.data] = block;
+        return block.data;
+    }
+
+    // 不是经由 allocate 分配的返回 false
+    bool release(void* p) {
+        HugePageBlock block;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = blocks_.find(p);
+            if (it == blocks_.end()) return false;
+            block = it->second;
+            blocks_.erase(it);
+        }
+        huge_page_unmap(block);
+        return true;
+    }
+
+    // p 所在块的页模式，不是登记过的大块返回 "heap"
+    const char* mode_of(const void* p) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = blocks_.find(const_cast<void*>(p));
+        return it == blocks_.end() ? "heap" : it->second.mode;
+    }
+
+    Usage usage() const {
+        Usage usage;
+        std::vector<std::pair<const void*, size_t>> ranges;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const auto& kv : blocks_) {
+                const HugePageBlock& b = kv.second;
+                usage.blocks++;
+                usage.mapped_bytes += b.size;
+                if (std::strncmp(b.mode, "hugetlb", 7) == 0) usage.hugetlb_bytes += b.size;
+                if (std::strcmp(b.mode, "thp") == 0) usage.thp_bytes += b.size;
+                ranges.push_back(std::make_pair(b.data, b.size));
+            }
+        }
+        usage.verified_bytes = ranges.empty() ? 0 : smaps_huge_bytes(ranges);
+        return usage;
+    }
+
+private:
+    HugePageRegistry() : policy_(default_huge_page_policy()) {}
+
+    mutable std::mutex mutex_;
+    HugePagePolicy policy_;
+    std::map<void*, HugePageBlock> blocks_;
+};
+
+// 不小于这个大小的分配走大页；更小的仍然用堆，免得小 vector 也占一整个 2MB
+constexpr size_t kHugeAllocThreshold = size_t(1) << 20;
+
+// 给 std::vector 用的分配器：大块经 HugePageRegistry 映射，小块走 operator new
+template <typename T>
+struct HugePageAllocator {
+    typedef T value_type;
+
+    HugePageAllocator() = default;
+    template <typename U>
+    HugePageAllocator(const HugePageAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        const size_t bytes = n * sizeof(T);
+        if (bytes >= kHugeAllocThreshold) return static_cast<T*>(HugePageRegistry::instance().allocate(bytes));
+        return static_cast<T*>(::operator new(bytes));
+    }
+
+    void deallocate(T* p, size_t n) {
+        if (n * sizeof(T) >= kHugeAllocThreshold && HugePageRegistry::instance().release(p)) return;
+        ::operator delete(p);
+    }
+
+    template <typename U>
+    bool operator==(const HugePageAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const HugePageAllocator<U>&) const { return false; }
+};
+
+template <typename T>
+using HugeVector = std::vector<T, HugePageAllocator<T>>;
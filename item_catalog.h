@@ -0,0 +1,58 @@
+// item_catalog.h
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "column_codec.h"
+#include "huge_pages.h"
+
+// ---- 物品目录 ----
+// 全量物品的物品侧特征，按 item_id 稠密存储（item_id 即下标）。
+// item_feature 是所有算子都认识的基础列；columns 是按名字区分的宽特征列，每列长度与目录一致。
+// 宽列可以换成压缩编码存储（encode_column），此后 columns[c] 为空，读取统一走 column_value。
+// 列都是按 item_id 随机访问的大表，用 HugeVector 分配，按 HOTPLUG_HUGE_PAGES 策略落在大页上。
+struct ItemCatalog {
+    HugeVector<double> item_feature;
+    std::vector<std::string> column_names;
+    std::vector<HugeVector<double>> columns;
+    std::vector<EncodedColumnStorage> encoded;  // 与 columns 对齐，未编码的列为 ENC_RAW 且为空
+
+    size_t size() const { return item_feature.size(); }
+    bool contains(int item_id) const { return item_id >= 0 && size_t(item_id) < size(); }
+
+    // 找不到返回 -1
+    int find_column(const std::string& name) const {
+        for (size_t i = 0; i < column_names.size(); ++i) {
+            if (column_names[i] == name) return int(i);
+        }
+        return -1;
+    }
+
+    bool is_encoded(size_t c) const { return c < encoded.size() && encoded[c].encoding != ENC_RAW; }
+
+    // 目录外的物品按 0 处理
+    double column_value(size_t c, int item_id) const {
+        if (!contains(item_id)) return 0.0;
+        return is_encoded(c) ? decode_value(encoded_view(c), item_id) : columns[c][item_id];
+    }
+
+    EncodedColumn encoded_view(size_t c) const { return encoded[c].view(column_names[c].c_str()); }
+
+    // 第 c 列实际占用的字节数
+    size_t column_bytes(size_t c) const {
+        return is_encoded(c) ? encoded[c].encoded_bytes() : columns[c].size() * sizeof(double);
+    }
+
+    // 把第 c 列换成指定编码并释放 double 原列；该编码表示不了这列时返回 false，列保持原样。
+    // 加载期调用，不能与 gather 并发。
+    bool encode_column(size_t c, uint32_t encoding) {
+        if (c >= columns.size() || is_encoded(c) || encoding == ENC_RAW) return false;
+        EncodedColumnStorage storage;
+        if (!::encode_column(columns[c], encoding, &storage)) return false;
+        encoded.resize(columns.size());
+        encoded[c] = std::move(storage);
+        HugeVector<double>().swap(columns[c]);
+        return true;
+    }
+};
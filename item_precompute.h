@@ -0,0 +1,58 @@
+// item_precompute.h
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+
+#include "feature_batch.h"
+#include "housekeeping.h"
+#include "item_catalog.h"
+#include "operator_holder.h"
+
+// ---- 加载期物品侧预计算 ----
+// 在 load_operator 之后、发布之前，于 housekeeping 核心上并行对全量目录调用 precompute_item，
+// 结果存入 holder 自己的列，随 holder 一起被引用计数管理，切换版本时不会读到别的版本的预计算值。
+// 返回预计算的物品数（算子未声明预计算时为 0）。
+inline size_t precompute_item_terms(OperatorHolder& holder, const ItemCatalog& catalog) {
+    int width = holder.op ? holder.op->item_precompute_width() : 0;
+    if (width <= 0 || catalog.size() == 0) return 0;
+
+    holder.item_precompute_width = width;
+    holder.item_precomputed.assign(catalog.size() * width, 0.0);
+    IScoreOperator* op = holder.op;
+    double* column = holder.item_precomputed.data();
+    housekeeping_parallel_for(catalog.size(), [&](size_t begin, size_t end) {
+        for (size_t item = begin; item < end; ++item) {
+            op->precompute_item(int(item), catalog.item_feature[item], column + item * width);
+        }
+    });
+    return catalog.size();
+}
+
+// 按 batch 里的 item_id 从该版本的预计算列中 gather；目录外的物品现场计算
+inline void gather_item_precomputed(const OperatorHolder& holder, FeatureBatchBuffer& buf) {
+    const int width = holder.item_precompute_width;
+    buf.item_precompute_width = width;
+    if (width <= 0 || buf.item_id.size() != buf.size()) {  // 需要 item_id，resolve_projection 会保证
+        buf.item_precomputed.clear();
+        return;
+    }
+    buf.item_precomputed.resize(buf.size() * width);
+    const size_t catalog_size = holder.item_precomputed.size() / width;
+    for (size_t i = 0; i < buf.size(); ++i) {
+        int item = buf.item_id[i];
+        double* dst = buf.item_precomputed.data() + i * width;
+        if (item >= 0 && size_t(item) < catalog_size) {
+            std::memcpy(dst, holder.item_precomputed.data() + size_t(item) * width, width * sizeof(double));
+        } else {
+            double item_feature = buf.item_feature.size() == buf.size() ? buf.item_feature[i] : 0.0;
+            holder.op->precompute_item(item, item_feature, dst);
+        }
+    }
+}
+
+// 批量打分路径：先 gather 预计算列，再按列打分
+inline void score_feature_batch(const OperatorHolder& holder, FeatureBatchBuffer& buf, double* scores) {
+    gather_item_precomputed(holder, buf);
+    holder.op->compute_score_soa(buf.view(), scores);
+}
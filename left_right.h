@@ -0,0 +1,117 @@
+// left_right.h
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+// ---- Left-Right 并发原语 ----
+// 数据保存两份，读者读其中一份，写者改另一份后切换，再等旧读者离开后把同样的修改应用到另一份。
+//   读：arrive -> 读 left_right_ 指向的副本 -> depart，全程只有两次 fetch_add，无锁、无等待、无分配；
+//   写：写者之间用 mutex 串行，等待时间只取决于切换前已进入的读者，不会被后来的读者饿死。
+// 适合读远多于写、且 T 可以廉价地被修改两次的场景（如路由表）。
+template <typename T>
+class LeftRight {
+public:
+    LeftRight() = default;
+    explicit LeftRight(const T& init) : instances_{init, init} {}
+
+    // fn(const T&) 的返回值原样返回；fn 内不要长时间阻塞，否则写者要等
+    template <typename Fn>
+    auto read(Fn&& fn) const -> decltype(fn(std::declval<const T&>())) {
+        ReadGuard guard(*this);
+        return fn(instances_[left_right_.load(std::memory_order_seq_cst)]);
+    }
+
+    // fn(T&) 会先后作用在两份副本上，必须是确定性的
+    template <typename Fn>
+    void modify(Fn&& fn) {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        int lr = left_right_.load(std::memory_order_relaxed);
+        fn(instances_[1 - lr]);
+        left_right_.store(1 - lr, std::memory_order_seq_cst);  // 新读者开始读改好的副本
+
+        // 翻转读者指示器并等待旧读者离开，之后 instances_[lr] 不再有人读
+        int vi = version_index_.load(std::memory_order_relaxed);
+        int next = 1 - vi;
+        wait_empty(indicators_[next]);
+        version_index_.store(next, std::memory_order_seq_cst);
+        wait_empty(indicators_[vi]);
+
+        fn(instances_[lr]);
+    }
+
+private:
+    // 读者指示器：按线程散列到多个缓存行上的计数器，避免所有读者争用同一行
+    static constexpr int kSlots = 16;
+    struct alignas(64) Counter {
+        std::atomic<int64_t> value{0};
+    };
+    struct ReadIndicator {
+        Counter counters[kSlots];
+    };
+
+    static int slot_of_this_thread() {
+        static thread_local int slot = int(std::hash<std::thread::id>()(std::this_thread::get_id()) % kSlots);
+        return slot;
+    }
+
+    static bool empty(const ReadIndicator& ri) {
+        for (const Counter& c : ri.counters) {
+            if (c.value.load(std::memory_order_seq_cst) != 0) return false;
+        }
+        return true;
+    }
+
+    static void wait_empty(const ReadIndicator& ri) {
+        while (!empty(ri)) std::this_thread::yield();
+    }
+
+    struct ReadGuard {
+        const LeftRight& lr;
+        int vi;
+        int slot;
+        explicit ReadGuard(const LeftRight& owner)
+            : lr(owner), vi(owner.version_index_.load(std::memory_order_seq_cst)), slot(slot_of_this_thread()) {
+            lr.indicators_[vi].counters[slot].value.fetch_add(1, std::memory_order_seq_cst);
+        }
+        ~ReadGuard() { lr.indicators_[vi].counters[slot].value.fetch_sub(1, std::memory_order_seq_cst); }
+    };
+
+    T instances_[2];
+    std::atomic<int> left_right_{0};
+    std::atomic<int> version_index_{0};
+    mutable ReadIndicator indicators_[2];
+    std::mutex writer_mutex_;
+};
+
+// ---- 路由表 ----
+// 定长数组，读路径不分配内存；由控制器通过 LeftRight::modify 频繁更新
+struct RoutingTable {
+    static constexpr int kMaxSlots = 8;
+    static constexpr int kMaxTenants = 64;
+
+    uint64_t epoch = 0;                    // 每次修改递增，便于观察
+    double slot_weight[kMaxSlots] = {1.0};  // 各版本槽位的流量权重，默认全部流量给槽位0
+    int tenant_slot[kMaxTenants];          // 租户固定路由到的槽位，-1 表示按权重分流
+
+    RoutingTable() {
+        for (int& slot : tenant_slot) slot = -1;
+    }
+
+    // 按租户映射或权重选槽位；request_hash 用于按权重稳定分流
+    int route(int tenant, uint64_t request_hash) const {
+        if (tenant >= 0 && tenant < kMaxTenants && tenant_slot[tenant] >= 0) return tenant_slot[tenant];
+        double total = 0;
+        for (double w : slot_weight) total += w;
+        if (total <= 0) return 0;
+        double point = double(request_hash % 10000) / 10000.0 * total;
+        for (int slot = 0; slot < kMaxSlots; ++slot) {
+            point -= slot_weight[slot];
+            if (point < 0) return slot;
+        }
+        return kMaxSlots - 1;
+    }
+};
@@ -1,7 +1,6 @@
 // main.cpp
 
 #include <iostream>
-#include <dlfcn.h>
 #include <memory>
 #include <thread>
 #include <vector>
@@ -12,11 +11,31 @@
 #include <iomanip>
 #include <sstream>
 #include <map>
+#include <fstream>
+#include <random>
+#include <sys/stat.h>
 
 #include "operator_interface.h"
-
-using CreateFunc = IScoreOperator* ();
-using DestroyFunc = void (IScoreOperator*);
+#include "operator_holder.h"
+#include "score_cache.h"
+#include "topk.h"
+#include "cascade.h"
+#include "feature_batch.h"
+#include "transform.h"
+#include "item_catalog.h"
+#include "item_precompute.h"
+#include "gather.h"
+#include "retrieval.h"
+#include "ann_index.h"
+#include "eligibility.h"
+#include "pipeline.h"
+#include "profiler.h"
+#include "conformance.h"
+#include "timeseries.h"
+#include "feature_client.h"
+#include "worker_pool.h"
+#include "tenant.h"
+#include "smt_pipeline.h"
 
 // 统计信息结构
 struct Statistics {
@@ -24,7 +43,10 @@ struct Statistics {
     std::atomic<uint64_t> v1_requests{0};
     std::atomic<uint64_t> v2_requests{0};
     std::atomic<uint64_t> hot_update_count{0};
+    std::atomic<uint64_t> cache_hits{0};
+    std::atomic<uint64_t> cache_misses{0};
     std::chrono::steady_clock::time_point start_time;
+    TimeSeries series;  // 按秒滚动的明细，保留最近一小时
     
     Statistics() : start_time(std::chrono::steady_clock::now()) {}
     
@@ -47,6 +69,10 @@ struct Statistics {
         std::cout << "V1 请求数: " << v1_requests.load() << "\n"; 
         std::cout << "V2 请求数: " << v2_requests.load() << "\n";
         std::cout << "热更新次数: " << hot_update_count.load() << "\n";
+        std::cout << "缓存命中/未命中: " << cache_hits.load() << " / " << cache_misses.load() << "\n";
+        WindowSummary recent = series.summarize(series.now_second() - 2, series.now_second());
+        std::cout << "最近 " << recent.seconds << " 秒: " << std::fixed << std::setprecision(1) << recent.qps
+                  << " req/s, p50 " << recent.p50_us << "us, p99 " << recent.p99_us << "us\n";
         std::cout << "==============================\n\n";
     }
 };
@@ -55,102 +81,278 @@ struct Statistics {
 Statistics g_stats;
 std::mutex g_print_mutex;  // 保证输出不乱序
 
-// 封装so和算子对象，析构时自动释放资源
-struct OperatorHolder {
-    void* handle = nullptr;
-    IScoreOperator* op = nullptr;
-    DestroyFunc* destroy_func = nullptr;
-
-    ~OperatorHolder() {
-        if (op && destroy_func) destroy_func(op);
-        if (handle) dlclose(handle);
-    }
-};
+// 打分缓存与近期流量采样，热更新前用于预热
+ScoreCache g_score_cache;
+TrafficSampler g_traffic_sampler;
+constexpr size_t PRIME_TOP_N = 256;  // 预热的最热样本数
+constexpr int PRIME_THREADS = 2;     // 预热后台线程数
 
 // 全局指针，用atomic_load/store保证切换过程的原子性和线程安全
 std::shared_ptr<OperatorHolder> g_operator;
 
-// ---- 加载算子so并创建OperatorHolder ----
-std::shared_ptr<OperatorHolder> load_operator(const std::string& so_file) {
-    auto holder = std::make_shared<OperatorHolder>();
-    holder->handle = dlopen(so_file.c_str(), RTLD_NOW);
-    if (!holder->handle) {
-        std::cerr << dlerror() << std::endl;
-        return nullptr;
-    }
-    CreateFunc* create = (CreateFunc*) dlsym(holder->handle, "create_operator");
-    DestroyFunc* destroy = (DestroyFunc*) dlsym(holder->handle, "destroy_operator");
-    if (!create || !destroy) {
-        std::cerr << "dlsym fail" << std::endl;
-        dlclose(holder->handle);
-        return nullptr;
-    }
-    holder->op = create();
-    holder->destroy_func = destroy;
-    return holder;
-}
+// 级联快照：粗排+精排整体发布
+std::shared_ptr<CascadeSnapshot> g_cascade;
+
+// 全量物品目录，加载算子时对其做物品侧预计算
+ItemCatalog g_item_catalog;
+constexpr size_t CATALOG_SIZE = 200000;
+constexpr int CATALOG_WIDE_COLUMNS = 8;  // 宽特征列数，算子未声明的列不会被 gather
+
+// 物品 embedding 矩阵，供检索阶段使用，与算子一样整体替换
+std::shared_ptr<EmbeddingIndex> g_embedding_index;
+constexpr uint32_t EMBEDDING_DIM = 32;
+
+// ANN 索引（IVF-PQ），重建后整体替换，查询方只持有快照
+std::shared_ptr<AnnIndex> g_ann_index;
+
+// 资格过滤位图，规则变化时整体重建后替换
+std::shared_ptr<EligibilitySnapshot> g_eligibility;
+
+// 召回 -> 过滤 -> gather -> 打分 -> 校准 -> top-K 整条链，各阶段可单独替换
+PipelineExecutor g_pipeline(256);
+
+// 特征变换 spec，与算子一样整体替换
+std::shared_ptr<TransformSpec> g_transform_spec;
+
+// 多租户：租户 -> 算子槽位的路由，各槽位独立热替换
+TenantRouter g_tenant_router;
 
 // ---- 热更新核心 ----
-bool hot_update(const std::string& so_file) {
+// 加载、校验并准备好一个新版本（参数、列投影、一致性、物品预计算、缓存预热），失败返回 nullptr。
+// 准备好的版本可以发布到 g_operator，也可以发布到某个租户的槽位
+std::shared_ptr<OperatorHolder> prepare_operator(const std::string& so_file) {
     std::cout << "[HotUpdate] 开始热更新到: " << so_file << std::endl;
     
-    auto new_holder = load_operator(so_file);
+    SoLoadStats load_stats;
+    auto new_holder = load_operator(so_file, &load_stats);
     if (!new_holder) {
         std::cerr << "[HotUpdate] 失败! 无法加载: " << so_file << std::endl;
-        return false;
+        return nullptr;
+    }
+    std::cout << "[HotUpdate] so 摘要: " << new_holder->so_digest.substr(0, 16) << "… (" << load_stats.bytes / 1024
+              << "KB, 哈希+拷贝 " << int(load_stats.hash_copy_us) << "us, dlopen " << int(load_stats.dlopen_us) << "us)"
+              << std::endl;
+    
+    // so 同名的 .params 参数文件在后台线程上并行解压、校验
+    ParamLoadStats param_stats;
+    if (!attach_parameters(*new_holder, ParamLoadOptions(), &param_stats)) {
+        std::cerr << "[HotUpdate] 失败! 参数文件无效: " << so_file << std::endl;
+        return nullptr;
+    }
+    if (param_stats.blocks) {
+        std::cout << "[HotUpdate] 参数: " << param_stats.raw_bytes / 1024 << "KB, " << param_stats.blocks << " 块, "
+                  << param_stats.threads << " 线程, " << param_stats.page_mode << ", 耗时 " << param_stats.millis << "ms"
+                  << std::endl;
+    }
+
+    // 解析算子声明的列，目录里没有的列视为加载失败
+    if (!resolve_projection(new_holder->op, g_item_catalog, &new_holder->projection)) {
+        std::cerr << "[HotUpdate] 失败! 列声明无效: " << so_file << std::endl;
+        return nullptr;
+    }
+    // 批量入口必须与 compute_score 一致，否则不同调用路径会给出不同分数
+    if (!conformance_quick_check(new_holder->op)) {
+        std::cerr << "[HotUpdate] 失败! 批量入口与 compute_score 不一致: " << so_file << std::endl;
+        return nullptr;
+    }
+    SamplingProfiler::instance().register_operator(*new_holder);  // 记录地址区间与符号表
+    
+    // 发布前在后台核心上对全量物品做物品侧预计算
+    auto precompute_start = std::chrono::steady_clock::now();
+    size_t precomputed = precompute_item_terms(*new_holder, g_item_catalog);
+    if (precomputed) {
+        auto cost = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - precompute_start);
+        std::cout << "[HotUpdate] 物品预计算: " << precomputed << " 个, 耗时 " << cost.count() << "ms" << std::endl;
     }
     
+    // 发布前用新版本预热最热的 (user_id, item_id)，避免切换后缓存全冷
+    size_t primed = prime_score_cache(new_holder->op, new_holder->generation,
+                                      g_traffic_sampler.hottest(PRIME_TOP_N),
+                                      g_score_cache, PRIME_THREADS);
+    std::cout << "[HotUpdate] 缓存预热: " << primed << " 条" << std::endl;
+    
+    return new_holder;
+}
+
+bool hot_update(const std::string& so_file) {
+    auto new_holder = prepare_operator(so_file);
+    if (!new_holder) return false;
+
     auto old_holder = std::atomic_load(&g_operator);
     std::atomic_store(&g_operator, new_holder);   // 原子写入
     g_stats.hot_update_count++;
+    g_stats.series.record_swap(new_holder->generation, new_holder->op->name());
     
     std::cout << "[HotUpdate] 成功切换到: " << new_holder->op->name() << std::endl;
     
     // 给一点时间让正在使用old_holder的线程完成
     if (old_holder) {
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        g_score_cache.retire(old_holder->generation);  // 老代际不会再被读到
     }
     
     return true;
 }
 
-// ---- 业务线程 ----
-void business_thread_func(int tid) {
-    const int total_rounds = 20;  // 增加轮次以便观察更多热插拔效果
+// ---- 租户槽位热更新：只影响路由到该槽位的租户 ----
+bool hot_update_tenant_slot(int slot, const std::string& so_file) {
+    if (slot < 0 || slot >= TenantRouter::kMaxSlots) return false;
+    auto new_holder = prepare_operator(so_file);
+    if (!new_holder) return false;
+    auto old_holder = g_tenant_router.publish(slot, new_holder);
+    g_stats.hot_update_count++;
+    g_stats.series.record_swap(new_holder->generation, new_holder->op->name());
+    std::cout << "[HotUpdate] 槽位 " << slot << " 切换到: " << new_holder->op->name() << std::endl;
+
+    // 与 hot_update 相同的宽限期后清掉被换下的那一代
+    if (old_holder) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        g_score_cache.retire(old_holder->generation);
+    }
+    return true;
+}
+
+// ---- 级联热更新：两个算子都加载成功后才整体发布 ----
+bool hot_update_cascade(const std::string& preranker_so, const std::string& ranker_so) {
+    std::cout << "[HotUpdate] 级联更新: " << preranker_so << " -> " << ranker_so << std::endl;
+    // 两半都走完整的准备流程（参数、列投影、一致性检查、预计算、缓存预热），任何一半失败都不发布
+    auto snapshot = std::make_shared<CascadeSnapshot>();
+    snapshot->preranker = prepare_operator(preranker_so);
+    snapshot->ranker = snapshot->preranker ? prepare_operator(ranker_so) : nullptr;
+    if (!snapshot->preranker || !snapshot->ranker) {
+        std::cerr << "[HotUpdate] 级联更新失败!" << std::endl;
+        return false;
+    }
+    auto old_snapshot = std::atomic_load(&g_cascade);
+    std::atomic_store(&g_cascade, snapshot);
+    g_stats.hot_update_count++;
+    g_stats.series.record_swap(snapshot->preranker->generation, snapshot->preranker->op->name());
+    g_stats.series.record_swap(snapshot->ranker->generation, snapshot->ranker->op->name());
+
+    // 与 hot_update 相同的宽限期后清掉被换下的两代
+    if (old_snapshot) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (old_snapshot->preranker) g_score_cache.retire(old_snapshot->preranker->generation);
+        if (old_snapshot->ranker) g_score_cache.retire(old_snapshot->ranker->generation);
+    }
+    return true;
+}
+
+// ---- 变换 spec 热更新：解析失败时保留旧 spec ----
+bool hot_update_transform(const std::string& spec_file) {
+    auto spec = load_transform_spec(spec_file);
+    if (!spec) {
+        std::cerr << "[HotUpdate] 变换 spec 加载失败: " << spec_file << std::endl;
+        return false;
+    }
+    std::atomic_store(&g_transform_spec, spec);
+    std::cout << "[HotUpdate] 变换 spec 切换到: " << spec_file << " (" << spec->steps.size() << " 步)" << std::endl;
+    return true;
+}
+
+// ---- embedding 矩阵热更新：mmap 并预先缺页后再发布 ----
+bool hot_update_embeddings(const std::string& path) {
+    auto index = EmbeddingIndex::open(path);
+    if (!index) {
+        std::cerr << "[HotUpdate] embedding 加载失败: " << path << std::endl;
+        return false;
+    }
+    std::atomic_store(&g_embedding_index, index);
+    std::cout << "[HotUpdate] embedding 切换到: " << path << " (" << index->count() << " x " << index->dim() << ")" << std::endl;
+    return true;
+}
+
+// ---- ANN 索引热更新：离线构建好的索引文件 mmap 后原子替换，进行中的查询继续用旧索引 ----
+bool hot_update_ann(const std::string& path) {
+    auto index = AnnIndex::open(path);
+    if (!index) {
+        std::cerr << "[HotUpdate] ANN 索引加载失败: " << path << std::endl;
+        return false;
+    }
+    std::atomic_store(&g_ann_index, index);
+    std::cout << "[HotUpdate] ANN 索引切换到: " << path << " (" << index->count() << " 条, nlist="
+              << index->nlist() << ")" << std::endl;
+    return true;
+}
+
+// ---- 资格规则热更新：先合并出可用位图再发布，请求侧只做一次查表 ----
+bool hot_update_eligibility(const std::vector<EligibilityRule>& rules, uint64_t version) {
+    auto start_time = std::chrono::steady_clock::now();
+    auto snapshot = build_eligibility(rules, version);
+    if (!snapshot) {
+        std::cerr << "[HotUpdate] 资格规则构建失败, version " << version << std::endl;
+        return false;
+    }
+    auto cost = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time);
+    std::atomic_store(&g_eligibility, snapshot);
+    std::cout << "[HotUpdate] 资格规则切换到 v" << version << " (" << snapshot->rule_names.size() << " 条规则, 可用 "
+              << snapshot->eligible.cardinality() << " 个, " << snapshot->eligible.memory_bytes() / 1024
+              << "KB, 合并 " << cost.count() << "μs)" << std::endl;
+    return true;
+}
+
+// ---- 业务请求：由弹性线程池的工作线程执行，tid 是发起请求的客户端编号 ----
+void handle_request(int tid, int i) {
+    int item = i % 5;  // 物品集中在少量热门上，便于观察缓存效果
+    Feature f{tid, item, tid * 0.1 + item * 0.05, tid * 0.2 + item * 0.1};
     
+    auto op_ptr = std::atomic_load(&g_operator);   // 原子读取
+    if (!op_ptr || !op_ptr->op) {
+        std::cerr << "[Client-" << tid << "] 错误: 算子指针为空!\n";
+        return;
+    }
+    
+    auto start_time = std::chrono::steady_clock::now();
+    double score = 0.0;
+    bool cache_hit = g_score_cache.lookup(op_ptr->generation, f.user_id, f.item_id, &score);
+    if (!cache_hit) {
+        score = op_ptr->op->compute_score(f);
+        g_score_cache.insert(op_ptr->generation, f.user_id, f.item_id, score);
+    }
+    auto end_time = std::chrono::steady_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
+    
+    // 记录统计信息
+    g_stats.record_request(op_ptr->op->name());
+    g_stats.series.record(op_ptr->generation,
+                          std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count());
+    (cache_hit ? g_stats.cache_hits : g_stats.cache_misses)++;
+    g_traffic_sampler.record(f);
+    
+    // 线程安全的输出
+    {
+        std::lock_guard<std::mutex> lock(g_print_mutex);
+        std::cout << "[Client-" << std::setw(2) << tid 
+                  << "] Round " << std::setw(2) << i
+                  << " | Op: " << std::setw(16) << op_ptr->op->name()
+                  << " | Score: " << std::setw(8) << std::fixed << std::setprecision(3) << score
+                  << " | Time: " << std::setw(4) << duration.count() << "μs"
+                  << " | Cache: " << (cache_hit ? "hit" : "miss")
+                  << std::endl;
+    }
+}
+
+// ---- 客户端：每 300ms 每个客户端发一个请求，交给线程池执行 ----
+void client_driver(ElasticWorkerPool& pool, int client_num) {
+    const int total_rounds = 20;  // 增加轮次以便观察更多热插拔效果
     for (int i = 0; i < total_rounds; ++i) {
-        Feature f{tid, i, tid * 0.1 + i * 0.05, tid * 0.2 + i * 0.1};
-        
-        auto op_ptr = std::atomic_load(&g_operator);   // 原子读取
-        if (!op_ptr || !op_ptr->op) {
-            std::cerr << "[Thread-" << tid << "] 错误: 算子指针为空!\n";
-            continue;
-        }
-        
-        auto start_time = std::chrono::steady_clock::now();
-        double score = op_ptr->op->compute_score(f);
-        auto end_time = std::chrono::steady_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
-        
-        // 记录统计信息
-        g_stats.record_request(op_ptr->op->name());
-        
-        // 线程安全的输出
-        {
-            std::lock_guard<std::mutex> lock(g_print_mutex);
-            std::cout << "[Thread-" << std::setw(2) << tid 
-                      << "] Round " << std::setw(2) << i
-                      << " | Op: " << std::setw(16) << op_ptr->op->name()
-                      << " | Score: " << std::setw(8) << std::fixed << std::setprecision(3) << score
-                      << " | Time: " << std::setw(4) << duration.count() << "μs"
-                      << std::endl;
+        for (int tid = 0; tid < client_num; ++tid) {
+            pool.submit([tid, i] { handle_request(tid, i); });
         }
-        
         std::this_thread::sleep_for(std::chrono::milliseconds(300));  // 稍微加快节奏
     }
-    
+    pool.wait_idle();
     std::lock_guard<std::mutex> lock(g_print_mutex);
-    std::cout << "[Thread-" << tid << "] 完成所有任务\n";
+    std::cout << "[Clients] " << client_num << " 个客户端完成所有请求\n";
+}
+
+void print_pool_stats(const ElasticWorkerPool& pool) {
+    WorkerPoolStats s = pool.stats();
+    std::cout << "🧵 [WorkerPool] 线程 " << s.workers << " (醒着 " << s.awake << ", 区间 " << pool.options().min_workers
+              << "-" << pool.options().max_workers << ", 峰值 " << s.peak_workers << ") | 新建 " << s.spawned
+              << ", 退出 " << s.exited << ", futex 唤醒 " << s.wakeups << " | 完成 " << s.completed
+              << " 个任务, 排队 EWMA " << std::fixed << std::setprecision(1) << s.queue_wait_ewma_us << "us\n";
 }
 
 // ---- 热插拔测试控制线程 ----
@@ -170,21 +372,787 @@ void hot_swap_controller() {
     std::cout << "\n✅ [控制器] 热插拔测试完成\n";
 }
 
+// ---- 秒级时序演示：每次热更新前后各 2 秒的吞吐与延迟，切换所在的那一秒两边都不算 ----
+void timeseries_demo() {
+    constexpr int kWindow = 2;
+    TimeSeries& series = g_stats.series;
+    std::cout << "📈 [TimeSeries] 保留 " << series.retain_seconds() << " 秒, 固定占用 "
+              << series.memory_bytes() / 1024 << "KB\n";
+    for (const SwapEvent& swap : series.swaps()) {
+        SwapImpact impact = series.compare_around(swap, kWindow);
+        auto describe = [](const WindowSummary& w) -> std::string {
+            std::ostringstream out;
+            if (!w.requests) return std::string("无请求");
+            out << std::fixed << std::setprecision(1) << w.qps << " req/s, p50 " << w.p50_us << "us, p99 " << w.p99_us
+                << "us";
+            for (const auto& v : w.versions) out << ", 代际" << v.first << "×" << v.second;
+            return out.str();
+        };
+        std::cout << "   @" << std::fixed << std::setprecision(2) << swap.at_seconds << "s -> " << swap.label << "#"
+                  << swap.version << " | 前 " << kWindow << "s: " << describe(impact.before) << " | 后 " << kWindow
+                  << "s: " << describe(impact.after) << "\n";
+    }
+    std::cout << "\n";
+}
+
+// ---- top-K 剪枝演示：对一批合成候选取 top-K，打印省下的计算量 ----
+void topk_demo() {
+    auto op_ptr = std::atomic_load(&g_operator);
+    if (!op_ptr || !op_ptr->op) return;
+
+    std::vector<Feature> candidates;
+    for (int i = 0; i < 1000; ++i) {
+        candidates.push_back(Feature{i % 17, i, (i % 13) * 0.1, (i % 101) * 0.02});
+    }
+    TopKReport report;
+    auto top = score_topk(op_ptr->op, candidates, 10, &report);
+
+    std::cout << "📊 [Top-K] 算子: " << op_ptr->op->name()
+              << " | 候选: " << report.candidates
+              << " | 剪枝: " << report.pruned
+              << " | 阶段: " << report.stages_evaluated << "/" << report.stages_total
+              << " | 节省: " << std::setprecision(1) << report.work_saved() * 100 << "%"
+              << " | 精确: " << (report.exact ? "是" : "否")
+              << " | Top1: " << std::setprecision(3) << (top.empty() ? 0.0 : top[0].score) << "\n\n";
+}
+
+// ---- 级联演示：延迟目标设得很紧，观察截断比例自动下调 ----
+void cascade_demo() {
+    if (!hot_update_cascade("./score_op_v1.so", "./score_op_v2.so")) return;
+
+    std::vector<Feature> candidates;
+    for (int i = 0; i < 20000; ++i) {
+        candidates.push_back(Feature{i % 17, i, (i % 13) * 0.1, (i % 101) * 0.02});
+    }
+    CascadeConfig config;
+    config.latency_target_us = 200;
+    CascadeScorer scorer(config);
+    for (int round = 0; round < 5; ++round) {
+        auto snapshot = std::atomic_load(&g_cascade);  // 一次请求只取一次快照
+        CascadeResult result = scorer.score(*snapshot, candidates);
+        std::cout << "🪜 [Cascade] Round " << round
+                  << " | 粗排: " << result.prescored
+                  << " | 精排: " << result.rescored
+                  << " | 比例: " << std::setprecision(3) << result.keep_fraction
+                  << " | 延迟EWMA: " << std::setprecision(0) << scorer.latency_ewma_us() << "μs"
+                  << " | Top1: " << std::setprecision(3) << result.ranked[0].score << "\n";
+    }
+    std::cout << "\n";
+}
+
+// ---- 检索演示：全量内积检索 top-N，直接组装成 FeatureBatch 交给当前算子 ----
+void retrieval_demo() {
+    std::vector<float> rows(CATALOG_SIZE * EMBEDDING_DIM);
+    for (size_t i = 0; i < rows.size(); ++i) rows[i] = float((i * 2654435761u) % 2001) / 1000.0f - 1.0f;
+    if (!write_embedding_file("./item_embeddings.bin", EmbeddingType::Int8, EMBEDDING_DIM, rows.data(), CATALOG_SIZE) ||
+        !hot_update_embeddings("./item_embeddings.bin")) {
+        return;
+    }
+
+    auto index = std::atomic_load(&g_embedding_index);
+    auto op_ptr = std::atomic_load(&g_operator);
+    std::vector<float> user_vec(EMBEDDING_DIM);
+    for (uint32_t d = 0; d < EMBEDDING_DIM; ++d) user_vec[d] = (d % 3 == 0) ? 0.5f : -0.25f;
+
+    auto start_time = std::chrono::steady_clock::now();
+    auto items = retrieve_topn(*index, user_vec.data(), 200, int(std::thread::hardware_concurrency()));
+    auto cost = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time);
+
+    FeatureBatchBuffer buffer;
+    retrieval_to_batch(items, op_ptr->projection, g_item_catalog, UserContext{3, 0.35}, buffer);
+    std::vector<double> scores(buffer.size());
+    score_feature_batch(*op_ptr, buffer, scores.data());
+    std::cout << "🔎 [Retrieval] 全量: " << index->count() << " | top-N: " << items.size()
+              << " | 耗时: " << cost.count() << "μs | Top1 item: " << items[0].item_id
+              << " 内积: " << std::setprecision(3) << items[0].score << " | 打分: " << scores[0] << "\n\n";
+}
+
+// ---- ANN 演示：查询线程持续检索，期间换入重建的索引，查询不中断 ----
+void ann_demo() {
+    std::vector<float> rows(CATALOG_SIZE * EMBEDDING_DIM);
+    for (size_t i = 0; i < rows.size(); ++i) rows[i] = float((i * 2654435761u) % 2001) / 1000.0f - 1.0f;
+    AnnBuildParams params;
+    params.nlist = 64;
+    params.m = 8;
+    params.train_samples = 5000;
+    params.kmeans_iters = 4;
+    if (!build_ann_index("./item_ann_v1.idx", rows.data(), CATALOG_SIZE, EMBEDDING_DIM, params) ||
+        !hot_update_ann("./item_ann_v1.idx")) {
+        return;
+    }
+
+    std::atomic<bool> stop{false};
+    std::atomic<long> queries{0}, max_us{0};
+    std::thread searcher([&] {
+        std::vector<float> user_vec(EMBEDDING_DIM);
+        for (long q = 0; !stop.load(); ++q) {
+            for (uint32_t d = 0; d < EMBEDDING_DIM; ++d) user_vec[d] = float((q + d) % 7) / 7.0f - 0.4f;
+            auto start_time = std::chrono::steady_clock::now();
+            auto index = std::atomic_load(&g_ann_index);
+            auto items = index->search(user_vec.data(), 200, 8);
+            long us = long(std::chrono::duration_cast<std::chrono::microseconds>(
+                               std::chrono::steady_clock::now() - start_time).count());
+            if (us > max_us.load()) max_us.store(us);
+            if (!items.empty()) queries++;
+        }
+    });
+
+    // 物品向量更新后重建索引并换入
+    for (size_t i = 0; i < rows.size(); i += 3) rows[i] = -rows[i];
+    params.seed = 2;
+    auto start_time = std::chrono::steady_clock::now();
+    bool ok = build_ann_index("./item_ann_v2.idx", rows.data(), CATALOG_SIZE, EMBEDDING_DIM, params) &&
+              hot_update_ann("./item_ann_v2.idx");
+    auto cost = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    stop = true;
+    searcher.join();
+
+    std::cout << "🧭 [ANN] 重建+切换: " << (ok ? "成功" : "失败") << " 耗时 " << cost.count() << "ms"
+              << " | 期间完成查询: " << queries.load() << " | 单次最大延迟: " << max_us.load() << "μs\n\n";
+}
+
+// ---- 资格过滤演示：打分前剔除不可用候选，规则换版本后立即生效 ----
+void eligibility_demo() {
+    std::vector<uint32_t> region, out_of_stock, blocked;
+    for (uint32_t id = 0; id < CATALOG_SIZE; ++id) {
+        if (id % 4 != 0) region.push_back(id);                            // 地域可见
+        if ((id * 2654435761u) % 10 == 0) out_of_stock.push_back(id);     // 无库存
+    }
+    for (uint32_t id = 0; id < CATALOG_SIZE; id += 397) blocked.push_back(id);
+    std::vector<EligibilityRule> rules = {
+        {"region", false, RoaringBitmap::from_ids(region)},
+        {"in_stock", false, RoaringBitmap::subtract(RoaringBitmap::range(0, CATALOG_SIZE),
+                                                    RoaringBitmap::from_ids(out_of_stock))},
+        {"blocklist", true, RoaringBitmap::from_ids(blocked)},
+    };
+    if (!hot_update_eligibility(rules, 1)) return;
+
+    std::vector<int> candidates;
+    for (int i = 0; i < 2000; ++i) candidates.push_back((i * 7919) % int(CATALOG_SIZE));
+    auto run = [&](const char* label) {
+        auto snapshot = std::atomic_load(&g_eligibility);
+        auto op_ptr = std::atomic_load(&g_operator);
+        std::vector<int> eligible(candidates.size());
+        auto start_time = std::chrono::steady_clock::now();
+        size_t kept = filter_item_ids(*snapshot, candidates.data(), candidates.size(), eligible.data());
+        auto cost = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time);
+
+        FeatureBatchBuffer buffer;
+        gather_features(op_ptr->projection, g_item_catalog, UserContext{3, 0.35}, eligible.data(), kept, buffer);
+        std::vector<double> scores(buffer.size());
+        score_feature_batch(*op_ptr, buffer, scores.data());
+        std::cout << "🚦 [Eligibility] " << label << " v" << snapshot->version << " | 候选: " << candidates.size()
+                  << " -> 送入算子: " << kept << " | 过滤耗时: " << cost.count() << "μs\n";
+    };
+    run("首版规则");
+
+    // 黑名单扩大，重建后替换
+    for (uint32_t id = 1; id < CATALOG_SIZE; id += 53) blocked.push_back(id);
+    rules[2].items = RoaringBitmap::from_ids(blocked);
+    if (hot_update_eligibility(rules, 2)) run("黑名单扩大");
+    std::cout << "\n";
+}
+
+// ---- pipeline 演示：请求持续执行，期间分别替换校准阶段和算子，每个请求只看到一个完整快照 ----
+void pipeline_demo() {
+    auto index = std::atomic_load(&g_embedding_index);
+    auto eligibility = std::atomic_load(&g_eligibility);
+    auto op_ptr = std::atomic_load(&g_operator);
+    auto calibrate = load_stage("./stage_calibrate_v1.so");
+    if (!index || !eligibility || !op_ptr || !calibrate) return;
+
+    PipelineStageList stages = {
+        {"retrieve", make_builtin_stage(new RetrievalStage(index, 1), "retrieve")},
+        {"filter", make_builtin_stage(new EligibilityStage(eligibility), "filter:v" + std::to_string(eligibility->version))},
+    };
+    for (auto& entry : make_operator_stages(op_ptr, g_item_catalog)) stages.push_back(entry);
+    stages.push_back({"calibrate", calibrate});
+    stages.push_back({"topk", make_builtin_stage(new TopKStage(), "topk")});
+    if (!g_pipeline.configure(stages)) return;
+
+    std::vector<float> user_vec(EMBEDDING_DIM);
+    for (uint32_t d = 0; d < EMBEDDING_DIM; ++d) user_vec[d] = (d % 3 == 0) ? 0.5f : -0.25f;
+    StageRequest req{3, 0.35, user_vec.data(), EMBEDDING_DIM, 10};
+
+    auto print_result = [&](const PipelineResult& result) {
+        const PipelineSnapshot& snap = *result.snapshot;
+        std::cout << "🧬 [Pipeline] 快照 v" << snap.version << " | 候选: " << result.candidates
+                  << " -> 打分: " << result.scored << " | Top1 item: " << result.items[0].item_id
+                  << " 分数: " << std::setprecision(3) << result.items[0].score << "\n   阶段耗时:";
+        for (size_t s = 0; s < snap.names.size(); ++s) {
+            std::cout << " " << snap.names[s] << "(" << snap.stages[s]->stage->name() << ")="
+                      << std::setprecision(0) << std::fixed << result.stage_us[s] << "μs";
+        }
+        std::cout << std::defaultfloat << "\n";
+    };
+    PipelineResult first;
+    g_pipeline.run(req, 2000, &first);
+    print_result(first);
+
+    std::atomic<bool> stop{false};
+    std::atomic<long> requests{0}, failed{0};
+    std::thread worker([&] {
+        PipelineResult result;
+        while (!stop.load()) {
+            if (!g_pipeline.run(req, 2000, &result) || result.items.empty()) failed++;
+            requests++;
+        }
+    });
+
+    // 只换校准阶段
+    auto calibrate_v2 = load_stage("./stage_calibrate_v2.so");
+    if (calibrate_v2 && g_pipeline.swap_stage("calibrate", calibrate_v2)) {
+        std::cout << "[HotUpdate] pipeline 校准阶段切换到: " << calibrate_v2->source << std::endl;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // 换算子：gather 与 score 一起替换
+    auto v1 = load_operator("./score_op_v1.so");
+    if (v1 && resolve_projection(v1->op, g_item_catalog, &v1->projection)) {
+        precompute_item_terms(*v1, g_item_catalog);
+        if (g_pipeline.swap_stages(make_operator_stages(v1, g_item_catalog))) {
+            std::cout << "[HotUpdate] pipeline 打分阶段切换到: " << v1->so_file << std::endl;
+        }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    stop = true;
+    worker.join();
+
+    PipelineResult last;
+    g_pipeline.run(req, 2000, &last);
+    print_result(last);
+    std::cout << "   切换期间请求: " << requests.load() << " | 失败: " << failed.load() << "\n\n";
+}
+
+// ---- 多样性重排演示：在当前 pipeline 的 sink 之后接一个 MMR 阶段，对比结果的两两相似度与增量/朴素 MMR ----
+void diversity_demo() {
+    // 多样性用单独的内容 embedding：每个物品属于 16 个主题之一，向量是主题中心加噪声，同主题物品彼此相近
+    constexpr uint32_t kTopics = 16;
+    std::vector<float> centers(kTopics * EMBEDDING_DIM), rows(CATALOG_SIZE * EMBEDDING_DIM);
+    std::mt19937 rng(7);
+    std::normal_distribution<float> gauss(0.0f, 1.0f);
+    for (float& x : centers) x = gauss(rng);
+    for (size_t i = 0; i < CATALOG_SIZE; ++i) {
+        const size_t topic = (i * 2654435761u >> 7) % kTopics;
+        for (uint32_t d = 0; d < EMBEDDING_DIM; ++d) {
+            rows[i * EMBEDDING_DIM + d] = centers[topic * EMBEDDING_DIM + d] + 0.4f * gauss(rng);
+        }
+    }
+    auto snap = g_pipeline.snapshot();
+    std::shared_ptr<EmbeddingIndex> index;
+    if (write_embedding_file("./item_topic_embeddings.bin", EmbeddingType::Float32, EMBEDDING_DIM, rows.data(),
+                             CATALOG_SIZE)) {
+        index = EmbeddingIndex::open("./item_topic_embeddings.bin");
+    }
+    if (!snap || !index) return;
+    MMROptions options;
+    options.lambda = 0.5;
+    options.pool = 200;
+    PipelineStageList stages;
+    for (size_t s = 0; s < snap->stages.size(); ++s) stages.push_back({snap->names[s], snap->stages[s]});
+    stages.push_back({"mmr", make_builtin_stage(new DiversityStage(index, options), "mmr")});
+    PipelineExecutor diversified;
+    if (!diversified.configure(stages)) return;
+
+    std::vector<float> user_vec(EMBEDDING_DIM);
+    for (uint32_t d = 0; d < EMBEDDING_DIM; ++d) user_vec[d] = (d % 3 == 0) ? 0.5f : -0.25f;
+    StageRequest req{3, 0.35, user_vec.data(), EMBEDDING_DIM, 10};
+    PipelineResult plain, reranked;
+    if (!g_pipeline.run(req, 2000, &plain) || !diversified.run(req, 2000, &reranked)) return;
+
+    std::vector<int> ids;
+    std::vector<uint32_t> order;
+    auto similarity = [&](const PipelineResult& result) {
+        ids.clear();
+        for (const StageRankedItem& item : result.items) ids.push_back(item.item_id);
+        load_normalized_embeddings(*index, ids.data(), ids.size(), rows);
+        order.resize(ids.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = uint32_t(i);
+        return mean_pairwise_similarity(rows.data(), order.data(), order.size(), EMBEDDING_DIM);
+    };
+    size_t kept = 0;
+    for (const StageRankedItem& a : reranked.items) {
+        for (const StageRankedItem& b : plain.items) kept += a.item_id == b.item_id ? 1 : 0;
+    }
+
+    // 同一个候选池上，增量 SIMD MMR 与朴素 MMR 的选择应一致
+    StageRequest pool_req = req;
+    pool_req.k = options.pool;
+    PipelineResult pool;
+    if (!g_pipeline.run(pool_req, 2000, &pool)) return;
+    std::vector<double> scores;
+    ids.clear();
+    for (const StageRankedItem& item : pool.items) {
+        ids.push_back(item.item_id);
+        scores.push_back(item.score);
+    }
+    load_normalized_embeddings(*index, ids.data(), ids.size(), rows);
+    std::vector<float> work = rows;
+    std::vector<uint32_t> fast(req.k), naive(req.k);
+    auto t0 = std::chrono::steady_clock::now();
+    size_t picked = mmr_select(work.data(), scores.data(), ids.size(), EMBEDDING_DIM, req.k, options.lambda, fast.data());
+    auto t1 = std::chrono::steady_clock::now();
+    mmr_select_naive(rows.data(), scores.data(), ids.size(), EMBEDDING_DIM, req.k, options.lambda, naive.data());
+    auto t2 = std::chrono::steady_clock::now();
+    fast.resize(picked);
+    naive.resize(picked);
+
+    const double plain_similarity = similarity(plain);
+    const double reranked_similarity = similarity(reranked);
+    std::cout << "🎯 [Diversity] MMR(λ=" << options.lambda << ", 前 " << options.pool << " 取 " << req.k
+              << ") | top" << req.k << " 两两相似度: " << std::fixed << std::setprecision(3) << plain_similarity
+              << " -> " << reranked_similarity << " | 保留原 top" << req.k << " 中 " << kept << " 个 | mmr 阶段 "
+              << std::setprecision(0) << reranked.stage_us.back() << "μs | 增量 SIMD " << std::setprecision(1)
+              << std::chrono::duration<double, std::micro>(t1 - t0).count() << "μs vs 朴素 "
+              << std::chrono::duration<double, std::micro>(t2 - t1).count() << "μs, 选择一致: "
+              << (fast == naive ? "是" : "否") << std::defaultfloat << "\n\n";
+}
+
+// ---- 列裁剪演示：按当前算子声明的列 gather，对比全量物化的搬运字节数 ----
+void gather_demo() {
+    auto op_ptr = std::atomic_load(&g_operator);
+    std::vector<int> item_ids;
+    for (int i = 0; i < 1000; ++i) item_ids.push_back((i * 7919) % int(CATALOG_SIZE));
+
+    FeatureBatchBuffer buffer;
+    gather_features(op_ptr->projection, g_item_catalog, UserContext{3, 0.35}, item_ids.data(), item_ids.size(), buffer);
+    std::vector<double> scores(buffer.size());
+    score_feature_batch(*op_ptr, buffer, scores.data());
+
+    ColumnProjection full;
+    for (size_t c = 0; c < g_item_catalog.column_names.size(); ++c) full.catalog_columns.push_back(c);
+    std::cout << "📐 [Gather] 算子: " << op_ptr->op->name()
+              << " | 目录列: " << op_ptr->projection.catalog_columns.size() << "/" << g_item_catalog.column_names.size()
+              << " | 搬运: " << gathered_bytes(op_ptr->projection, item_ids.size()) << "B (全量 "
+              << gathered_bytes(full, item_ids.size()) << "B)"
+              << " | Score[0]: " << std::setprecision(3) << scores[0] << "\n\n";
+}
+
+// ---- SMT 流水演示：兄弟超线程 gather 下一块、本线程给上一块打分，与单线程逐块 gather + 打分对拍 ----
+void smt_demo() {
+    auto op_ptr = std::atomic_load(&g_operator);
+    std::vector<int> item_ids;
+    for (int i = 0; i < 50000; ++i) item_ids.push_back(int((uint64_t(i) * 7919) % CATALOG_SIZE));
+    const UserContext user{3, 0.35};
+    const size_t chunk = smt_chunk_rows(*op_ptr, g_item_catalog);
+
+    std::vector<double> expected(item_ids.size()), scores(item_ids.size());
+    FeatureBatchBuffer buffer;
+    auto t0 = std::chrono::steady_clock::now();
+    gather_score_chunked(*op_ptr, g_item_catalog, user, item_ids.data(), item_ids.size(), expected.data(), chunk, buffer);
+    auto t1 = std::chrono::steady_clock::now();
+
+    // 有兄弟线程时取最后一对（0 号核常处理中断），打分线程绑 cpu、gather 线程绑 sibling；否则都不绑
+    std::vector<SmtSiblings> pairs = smt_sibling_pairs();
+    SmtSiblings pair = pairs.empty() ? SmtSiblings{-1, -1} : pairs.back();
+    SmtGatherScorer smt(pair.sibling);
+    double smt_us = 0;
+    std::thread scorer([&] {
+        pin_current_thread(pair.cpu);
+        auto start = std::chrono::steady_clock::now();
+        smt.run(*op_ptr, g_item_catalog, user, item_ids.data(), item_ids.size(), scores.data(), chunk);
+        smt_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    });
+    scorer.join();
+
+    SmtPipelineStats stats = smt.stats();
+    std::cout << "🧵 [SMT] 超线程对: " << pairs.size();
+    if (pairs.empty()) {
+        std::cout << "（未检测到兄弟线程，不绑核）";
+    } else {
+        std::cout << "（打分 cpu" << pair.cpu << " / gather cpu" << pair.sibling << "）";
+    }
+    std::cout << " | L2: " << (l2_cache_bytes(std::max(pair.cpu, 0)) >> 10) << "KB | 块: " << chunk << " 行 x "
+              << stats.chunks << " | 单线程: " << std::fixed << std::setprecision(0)
+              << std::chrono::duration<double, std::micro>(t1 - t0).count() << "μs | 流水: " << smt_us
+              << "μs | 打分等 gather: " << stats.score_stall_us << "μs | 与单线程一致: "
+              << (scores == expected ? "是" : "否") << std::defaultfloat << "\n\n";
+}
+
+// ---- 参数文件演示：V3 的 embedding 表写成分块压缩的 .params，加载时并行解压 + 校验，损坏的块拒绝加载 ----
+void params_demo() {
+    std::vector<ParamTensorData> tensors(2);
+    tensors[0].name = "embedding";
+    tensors[0].values.resize(size_t(1 << 16) * 16);
+    uint32_t state = 2024;
+    for (float& v : tensors[0].values) {
+        state = state * 1664525u + 1013904223u;
+        v = float(int(state >> 24) - 128) / 1024.0f;  // 量化到 1/1024，可压缩
+    }
+    tensors[1].name = "score_weights";
+    for (int d = 0; d < 16; ++d) tensors[1].values.push_back(0.04f * float(d % 4 + 1));
+    if (!write_param_file("./score_op_v3.params", tensors, 256 << 10)) {
+        std::cerr << "[Params] 写参数文件失败" << std::endl;
+        return;
+    }
+
+    auto v3 = load_operator("./score_op_v3.so");
+    ParamLoadStats stats;
+    if (!v3 || !attach_parameters(*v3, ParamLoadOptions(), &stats)) return;
+
+    // 翻转一个数据字节后应当被块校验拒绝
+    std::ifstream in("./score_op_v3.params", std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    bytes[bytes.size() - 100] ^= 0x5a;
+    std::ofstream("./score_op_v3_corrupt.params", std::ios::binary) << bytes;
+    bool rejected = !ParamBlob::load("./score_op_v3_corrupt.params");
+    std::remove("./score_op_v3_corrupt.params");
+
+    std::cout << "📦 [Params] " << v3->op->name() << " | 文件: " << stats.file_bytes / 1024 << "KB -> 解压: "
+              << stats.raw_bytes / 1024 << "KB | " << stats.blocks << " 块 / " << stats.threads << " 线程 | 页: "
+              << stats.page_mode << " | 耗时: " << std::setprecision(3) << stats.millis << "ms | 损坏文件被拒绝: "
+              << (rejected ? "是" : "否") << "\n\n";
+}
+
+// ---- 稀疏特征演示：请求带上变长的点击类目列表（CSR），V3 做 embedding-bag 池化 ----
+void sparse_demo() {
+    auto v3 = load_operator("./score_op_v3.so");
+    if (!v3 || !attach_parameters(*v3) || !resolve_projection(v3->op, g_item_catalog, &v3->projection)) return;
+
+    std::vector<int> item_ids;
+    for (int i = 0; i < 1000; ++i) item_ids.push_back((i * 7919) % int(CATALOG_SIZE));
+    FeatureBatchBuffer buffer;
+    gather_features(v3->projection, g_item_catalog, UserContext{3, 0.35}, item_ids.data(), item_ids.size(), buffer);
+
+    SparseColumnBuffer& clicks = buffer.add_sparse_column("clicked_categories");
+    size_t total_ids = 0;
+    for (size_t i = 0; i < item_ids.size(); ++i) {
+        uint32_t ids[8];
+        float weights[8];
+        size_t len = i % 9;  // 每行 0~8 个类目
+        for (size_t k = 0; k < len; ++k) {
+            ids[k] = uint32_t(item_ids[i] * 31 + k * 7);
+            weights[k] = 1.0f / float(k + 1);
+        }
+        clicks.push_row(ids, weights, len);
+        total_ids += len;
+    }
+
+    FeatureBatch batch = buffer.view();
+    if (const char* missing = missing_sparse_column(v3->op, batch)) {
+        std::cerr << "[Sparse] 缺少稀疏特征: " << missing << std::endl;
+        return;
+    }
+    std::vector<double> scores(batch.size);
+    v3->op->compute_score_soa(batch, scores.data());
+    std::cout << "🧺 [Sparse] 算子: " << v3->op->name() << " | 行: " << batch.size << " | 稀疏 id: " << total_ids
+              << " | Score[1]: " << std::setprecision(4) << scores[1]
+              << " (无稀疏: " << v3->op->compute_score(batch.row(1)) << ")\n\n";
+}
+
+// ---- 变换演示：原始特征 -> 列式变换 -> 算子按列打分 ----
+void transform_demo() {
+    if (!hot_update_transform("./transform.spec")) return;
+    auto spec = std::atomic_load(&g_transform_spec);
+    auto op_ptr = std::atomic_load(&g_operator);
+
+    std::vector<Feature> candidates;
+    for (int i = 0; i < 1000; ++i) {
+        candidates.push_back(Feature{i % 17, i, (i % 13) * 0.1, (i % 101) * 0.02});
+    }
+    FeatureBatchBuffer buffer;
+    buffer.assign(candidates.data(), candidates.size());
+    apply_transforms(*spec, buffer);
+
+    FeatureBatch batch = buffer.view();
+    std::vector<double> scores(batch.size);
+    score_feature_batch(*op_ptr, buffer, scores.data());  // 会 gather 该版本的物品预计算列
+    batch = buffer.view();
+
+    std::cout << "🧮 [Transform] 派生列:";
+    for (size_t i = 0; i < batch.num_extra; ++i) std::cout << " " << batch.extra[i].name;
+    std::cout << "\n🧮 [Transform] 第7行: item_feature=" << std::setprecision(3) << batch.item_feature[7]
+              << " item_bucket=" << batch.find("item_bucket")[7]
+              << " user_x_bucket=" << std::setprecision(0) << batch.find("user_x_bucket")[7]
+              << " | Score: " << std::setprecision(3) << scores[7] << "\n\n";
+}
+
+// ---- 压缩列演示：目录宽列换成无损编码，V4 在打分内核里按 item_id 直接解码 ----
+void encoding_demo() {
+    auto v4 = load_operator("./score_op_v4.so");
+    if (!v4 || !resolve_projection(v4->op, g_item_catalog, &v4->projection)) return;
+
+    std::vector<int> item_ids;
+    for (int i = 0; i < 1000; ++i) item_ids.push_back((i * 7919) % int(CATALOG_SIZE));
+    item_ids.push_back(-1);  // 目录外物品按 0 处理
+    const UserContext user{3, 0.35};
+    auto score = [&](const ColumnProjection& projection, std::vector<double>& out) {
+        FeatureBatchBuffer buffer;
+        gather_features(projection, g_item_catalog, user, item_ids.data(), item_ids.size(), buffer);
+        out.resize(buffer.size());
+        v4->op->compute_score_soa(buffer.view(), out.data());
+        return gathered_bytes(projection, item_ids.size(), &g_item_catalog);
+    };
+
+    std::vector<double> raw_scores, fused_scores;
+    size_t raw_moved = score(v4->projection, raw_scores);
+    size_t raw_bytes = 0, encoded_bytes = 0;
+    const char* encoding_names[] = {"raw", "dict", "bitpack", "int8"};
+    std::ostringstream chosen;
+    for (size_t c = 0; c < g_item_catalog.column_names.size(); ++c) {
+        raw_bytes += g_item_catalog.column_bytes(c);
+        uint32_t encoding = choose_encoding(g_item_catalog.columns[c], false);
+        if (g_item_catalog.encode_column(c, encoding)) {
+            chosen << (c ? "," : "") << encoding_names[encoding];
+            if (encoding == ENC_BITPACKED) chosen << g_item_catalog.encoded[c].bits;
+        }
+        encoded_bytes += g_item_catalog.column_bytes(c);
+    }
+    size_t fused_moved = score(v4->projection, fused_scores);
+    double max_diff = 0;
+    for (size_t i = 0; i < raw_scores.size(); ++i) max_diff = std::max(max_diff, std::fabs(raw_scores[i] - fused_scores[i]));
+
+    std::cout << "🗜️ [Encoding] 宽列编码: " << chosen.str() << " | 目录宽列: " << raw_bytes / 1024 << "KB -> "
+              << encoded_bytes / 1024 << "KB | 每批搬运: " << raw_moved << "B -> " << fused_moved << "B"
+              << " | 与 double 列最大差: " << std::scientific << std::setprecision(1) << max_diff << std::defaultfloat
+              << " | Score[0]: " << std::setprecision(4) << fused_scores[0] << "\n\n";
+}
+
+// ---- so 校验演示：启用校验清单后，被改过一个字节的 so 和清单外的 so 都拒绝加载 ----
+void verify_demo() {
+    auto trusted = load_operator("./score_op_v1.so");
+    if (!trusted) return;
+    SoManifest::instance().set("score_op_v1.so", trusted->so_digest);
+
+    std::ifstream in("./score_op_v1.so", std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    bytes[bytes.size() / 2] ^= 0x01;
+    mkdir("/tmp/hotplug_tampered", 0755);
+    std::ofstream("/tmp/hotplug_tampered/score_op_v1.so", std::ios::binary) << bytes;
+
+    bool trusted_ok = load_operator("./score_op_v1.so") != nullptr;
+    bool tampered_rejected = load_operator("/tmp/hotplug_tampered/score_op_v1.so") == nullptr;
+    bool unlisted_rejected = load_operator("./score_op_v2.so") == nullptr;
+    SoManifest::instance().clear();
+    std::remove("/tmp/hotplug_tampered/score_op_v1.so");
+
+    std::cout << "🔏 [Verify] " << trusted->op->name() << " BLAKE3: " << trusted->so_digest.substr(0, 16)
+              << "… | 清单内加载: " << (trusted_ok ? "通过" : "失败") << " | 篡改副本: "
+              << (tampered_rejected ? "拒绝" : "未拒绝!") << " | 清单外 so: " << (unlisted_rejected ? "拒绝" : "未拒绝!")
+              << "\n\n";
+}
+
+// ---- 特征抓取演示：本地替身特征服务，逐请求同步抓取 vs 合批 + 多批在途 + 与打分重叠 ----
+void feature_fetch_demo() {
+    FeatureServiceOptions service;
+    service.latency_us = 500;
+    auto client = FeatureClient::spawn("./feature_server", service, 8);
+    auto holder = std::atomic_load(&g_operator);
+    if (!client || !holder) return;
+
+    constexpr size_t kRequests = 64, kCandidates = 128;
+    std::vector<FeatureRequest> requests(kRequests);
+    for (size_t r = 0; r < kRequests; ++r) {
+        for (size_t i = 0; i < kCandidates; ++i) {
+            requests[r].keys.push_back(FeatureKey{int32_t(r % 16), int32_t((r * 131 + i * 7) % CATALOG_SIZE)});
+        }
+    }
+
+    // 逐请求：抓取 -> 等待 -> 打分，核心在等待期间空转
+    auto sync_start = std::chrono::steady_clock::now();
+    std::vector<FeatureValue> values(kCandidates);
+    std::vector<Feature> features(kCandidates);
+    std::vector<std::vector<double>> sync_scores(kRequests, std::vector<double>(kCandidates));
+    for (size_t r = 0; r < kRequests; ++r) {
+        if (!client->fetch(requests[r].keys.data(), kCandidates, values.data())) return;
+        for (size_t i = 0; i < kCandidates; ++i) {
+            features[i] = Feature{requests[r].keys[i].user_id, requests[r].keys[i].item_id, values[i].user_feature,
+                                  values[i].item_feature};
+        }
+        holder->op->compute_score_batch(features.data(), kCandidates, sync_scores[r].data());
+    }
+    double sync_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sync_start).count();
+
+    FetchPipelineOptions options;
+    options.requests_per_batch = 8;
+    options.depth = 4;
+    FetchPipelineStats stats;
+    auto pipe_start = std::chrono::steady_clock::now();
+    if (!score_with_prefetch(*client, holder->op, requests, options, &stats)) return;
+    double pipe_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pipe_start).count();
+
+    // 两条路径的分数都要与本地按同一特征公式直接打分一致
+    bool same = true;
+    for (size_t r = 0; r < kRequests; ++r) {
+        for (size_t i = 0; i < kCandidates; ++i) {
+            FeatureValue v = feature_service_lookup(requests[r].keys[i]);
+            double local = holder->op->compute_score(
+                Feature{requests[r].keys[i].user_id, requests[r].keys[i].item_id, v.user_feature, v.item_feature});
+            same = same && std::fabs(sync_scores[r][i] - local) < 1e-9 && std::fabs(requests[r].scores[i] - local) < 1e-9;
+        }
+    }
+    std::cout << "🛰️  [FeatureFetch] " << kRequests << " 请求 × " << kCandidates << " 候选, 服务延迟 " << service.latency_us
+              << "us | 逐请求同步: " << std::fixed << std::setprecision(1) << sync_ms << "ms | 合批+流水线("
+              << options.requests_per_batch << " 请求/批, " << options.depth << " 批在途): " << pipe_ms << "ms (等待 "
+              << stats.wait_us / 1000 << "ms, 打分 " << stats.score_us / 1000 << "ms) | 分数一致: "
+              << (same ? "是" : "否") << "\n\n";
+}
+
+// ---- 大页演示：目录列、预计算表、参数等大块的页模式，以及 smaps 核对的实际大页字节数 ----
+void huge_pages_demo() {
+    HugePageRegistry::Usage usage = HugePageRegistry::instance().usage();
+    auto holder = std::atomic_load(&g_operator);
+    std::cout << "🧱 [HugePages] 策略: " << huge_page_policy_name(HugePageRegistry::instance().policy())
+              << " | 目录列: " << HugePageRegistry::instance().mode_of(g_item_catalog.item_feature.data())
+              << " | 大块 " << usage.blocks << " 个, 共 " << usage.mapped_bytes / (1 << 20) << "MB (hugetlb "
+              << usage.hugetlb_bytes / (1 << 20) << "MB, THP " << usage.thp_bytes / (1 << 20) << "MB) | smaps 核对在大页上: "
+              << usage.verified_bytes / (1 << 20) << "MB";
+    if (holder && holder->parameters) std::cout << " | 参数: " << holder->parameters->page_mode();
+    std::cout << "\n\n";
+}
+
+// ---- 弹性线程池演示：低流量只用一个线程，突发时几毫秒内扩到上限，空闲后收缩回下限 ----
+void worker_pool_demo() {
+    typedef std::chrono::steady_clock Clock;
+    constexpr int kTrickle = 50;   // 低流量：每 1ms 一个任务
+    constexpr int kBurst = 2000;   // 突发：一次性提交
+    WorkerPoolOptions options;
+    options.min_workers = 1;
+    options.max_workers = 4;
+    options.idle_exit_ms = 50;
+    ElasticWorkerPool pool(options);
+    auto work = [] {
+        volatile double x = 0;
+        for (int k = 0; k < 20000; ++k) x = x + k * 1e-9;  // 约几十微秒的打分
+    };
+
+    size_t trickle_peak = 0;
+    for (int i = 0; i < kTrickle; ++i) {
+        pool.submit(work);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        trickle_peak = std::max(trickle_peak, pool.stats().workers);
+    }
+    pool.wait_idle();
+
+    auto burst_start = Clock::now();
+    double full_ms = -1;
+    for (int i = 0; i < kBurst; ++i) {
+        pool.submit(work);
+        if (full_ms < 0 && pool.stats().workers == options.max_workers) {
+            full_ms = std::chrono::duration<double, std::milli>(Clock::now() - burst_start).count();
+        }
+    }
+    pool.wait_idle();
+    double burst_ms = std::chrono::duration<double, std::milli>(Clock::now() - burst_start).count();
+    std::this_thread::sleep_for(std::chrono::milliseconds(options.idle_exit_ms * 3));
+    WorkerPoolStats after = pool.stats();
+
+    std::cout << "🧵 [WorkerPool] 低流量 " << kTrickle << " 个任务(1/ms): 最多 " << trickle_peak << " 个线程 | 突发 "
+              << kBurst << " 个任务: ";
+    if (full_ms >= 0) {
+        std::cout << std::fixed << std::setprecision(2) << full_ms << "ms 扩到 " << options.max_workers << " 个线程, ";
+    } else {
+        std::cout << "峰值 " << after.peak_workers << " 个线程, ";
+    }
+    std::cout << std::fixed << std::setprecision(1) << burst_ms << "ms 完成 | 空闲 " << options.idle_exit_ms * 3
+              << "ms 后剩 " << after.workers << " 个线程 (新建 " << after.spawned << ", 退出 " << after.exited
+              << ")\n\n";
+}
+
+// ---- 多租户演示：两个租户各用一个槽位；租户 1 换上新版本并压满 CPU，对比有无配额时租户 0 的延迟 ----
+void tenant_demo() {
+    typedef std::chrono::steady_clock Clock;
+    constexpr int kTicks = 300;          // 每 1ms 一个租户 0 的轻请求
+    constexpr size_t kLight = 256;       // 轻请求候选数
+    constexpr size_t kHeavy = 100000;    // 重请求候选数，租户 1 每 1ms 提交两个，远超单核
+    constexpr size_t kHeavyOutstanding = 64;  // 租户 1 客户端最多积压这么多
+
+    if (!hot_update_tenant_slot(0, "./score_op_v1.so") || !hot_update_tenant_slot(1, "./score_op_v1.so")) return;
+    g_tenant_router.assign(0, 0);
+    g_tenant_router.assign(1, 1);
+    if (!hot_update_tenant_slot(1, "./score_op_v2.so")) return;  // 只换租户 1
+
+    auto score_request = [](int tenant, size_t n, uint64_t seq) {
+        auto holder = g_tenant_router.route(tenant, seq);
+        if (!holder) return;
+        thread_local std::vector<Feature> features;
+        thread_local std::vector<double> scores;
+        features.resize(n);
+        scores.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            int item = int((seq * 131 + i) % CATALOG_SIZE);
+            features[i] = Feature{tenant, item, tenant * 0.1 + item * 0.05, tenant * 0.2 + item * 0.1};
+        }
+        holder->op->compute_score_batch(features.data(), n, scores.data());
+    };
+
+    auto run_phase = [&](double heavy_cores) {
+        WorkerPoolOptions pool_options;
+        pool_options.min_workers = 1;
+        pool_options.max_workers = 4;
+        ElasticWorkerPool pool(pool_options);
+        TenantScheduler scheduler(pool);
+        if (heavy_cores > 0) {
+            TenantQuota quota;
+            quota.cores = heavy_cores;
+            quota.burst_ms = 5;
+            scheduler.set_quota(1, quota);
+        }
+
+        std::vector<double> latency(kTicks);
+        for (int i = 0; i < kTicks; ++i) {
+            auto submitted = Clock::now();
+            scheduler.submit(0, [&, i, submitted] {
+                score_request(0, kLight, uint64_t(i));
+                latency[i] = std::chrono::duration<double, std::micro>(Clock::now() - submitted).count();
+            });
+            for (int h = 0; h < 2; ++h) {
+                TenantUsage heavy = scheduler.usage(1);
+                if (heavy.queued + heavy.in_flight >= kHeavyOutstanding) break;
+                scheduler.submit(1, [&, i] { score_request(1, kHeavy, uint64_t(i)); });
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        scheduler.wait_idle();
+        TenantUsage heavy = scheduler.usage(1);
+        std::sort(latency.begin(), latency.end());
+        std::cout << std::fixed << std::setprecision(0) << "租户0 延迟 p50 " << latency[kTicks / 2] << "us p99 "
+                  << latency[kTicks * 99 / 100] << "us | 租户1 完成 " << heavy.completed << " 个重请求, CPU "
+                  << heavy.cpu_ms << "ms";
+        if (heavy_cores > 0) std::cout << " (提交时被限流 " << heavy.throttled << " 次)";
+        std::cout << std::defaultfloat << "\n";
+    };
+
+    auto t0 = g_tenant_router.slot(g_tenant_router.slot_of(0, 0));
+    auto t1 = g_tenant_router.slot(g_tenant_router.slot_of(1, 0));
+    std::cout << "🏢 [Tenant] 租户0 -> 槽位" << g_tenant_router.slot_of(0, 0) << " (" << t0->op->name() << "), 租户1 -> 槽位"
+              << g_tenant_router.slot_of(1, 0) << " (" << t1->op->name() << "), 路由表 epoch " << g_tenant_router.epoch()
+              << "\n   无配额:              ";
+    run_phase(0);
+    std::cout << "   租户1 配额 0.25 核:  ";
+    run_phase(0.25);
+    std::cout << "\n";
+}
+
 int main() {
     std::cout << "🚀 ========== 热插拔能力测试开始 ==========\n\n";
+    g_stats.series.start();
+    SamplingProfiler::instance().start();
     
+    // 0. 构造物品目录
+    g_item_catalog.item_feature.resize(CATALOG_SIZE);
+    for (size_t i = 0; i < CATALOG_SIZE; ++i) g_item_catalog.item_feature[i] = (i % 101) * 0.02;
+    for (int c = 0; c < CATALOG_WIDE_COLUMNS; ++c) {
+        g_item_catalog.column_names.push_back("item_f" + std::to_string(c));
+        g_item_catalog.columns.emplace_back(CATALOG_SIZE);
+        for (size_t i = 0; i < CATALOG_SIZE; ++i) g_item_catalog.columns[c][i] = double((i * (c + 3)) % 97);
+    }
+
     // 1. 首次加载v1
     std::cout << "📦 [初始化] 加载初始算子...\n";
     assert(hot_update("./score_op_v1.so"));
 
-    // 2. 启动多条业务线程（模拟高并发场景）
-    constexpr int THREAD_NUM = 4;  // 增加线程数
-    std::vector<std::thread> business_threads;
+    // 2. 启动弹性业务线程池和多个并发客户端（模拟高并发场景）
+    constexpr int CLIENT_NUM = 4;
+    WorkerPoolOptions pool_options;
+    pool_options.min_workers = 1;  // 低流量时只留一个线程
+    pool_options.max_workers = 4;  // 突发时最多扩到 4 个
+    ElasticWorkerPool business_pool(pool_options);
     
-    std::cout << "🏭 [启动] 启动 " << THREAD_NUM << " 个业务线程...\n\n";
-    for (int i = 0; i < THREAD_NUM; ++i) {
-        business_threads.emplace_back(business_thread_func, i);
-    }
+    std::cout << "🏭 [启动] 业务线程池 " << pool_options.min_workers << "-" << pool_options.max_workers << " 个线程, "
+              << CLIENT_NUM << " 个客户端...\n\n";
+    std::thread driver_thread(client_driver, std::ref(business_pool), CLIENT_NUM);
 
     // 3. 启动热插拔控制线程
     std::thread controller_thread(hot_swap_controller);
@@ -198,15 +1166,40 @@ int main() {
     });
 
     // 5. 等待所有线程结束
-    for (auto &th : business_threads) {
-        th.join();
-    }
+    driver_thread.join();
     controller_thread.join();
     stats_thread.join();
 
     // 6. 最终统计
     std::cout << "\n🎉 ========== 测试完成 ==========\n";
     g_stats.print_stats();
+    print_pool_stats(business_pool);
+    timeseries_demo();
+    topk_demo();
+    cascade_demo();
+    transform_demo();
+    gather_demo();
+    smt_demo();
+    params_demo();
+    sparse_demo();
+    retrieval_demo();
+    ann_demo();
+    eligibility_demo();
+    pipeline_demo();
+    diversity_demo();
+    encoding_demo();
+    verify_demo();
+    feature_fetch_demo();
+    huge_pages_demo();
+    worker_pool_demo();
+    tenant_demo();
+
+    // 采样剖析：按版本归属，folded stacks 可用 flamegraph.pl 生成火焰图
+    SamplingProfiler::instance().stop();
+    SamplingProfiler::instance().print_flat_profile(std::cout);
+    std::ofstream folded("profile.folded");
+    SamplingProfiler::instance().write_folded(folded);
+    std::cout << "🔥 folded stacks 已写入 profile.folded\n\n";
     
     std::cout << "✨ 热插拔能力验证:\n";
     std::cout << "   - ✅ 多线程并发访问安全\n";
@@ -0,0 +1,100 @@
+// operator_holder.h
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <dlfcn.h>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "feature_batch.h"
+#include "operator_interface.h"
+#include "param_file.h"
+#include "so_loader.h"
+
+using CreateFunc = IScoreOperator* ();
+using DestroyFunc = void (IScoreOperator*);
+using InterfaceVersionFunc = uint32_t ();
+
+// 封装so和算子对象，析构时自动释放资源
+struct OperatorHolder {
+    void* handle = nullptr;
+    int memfd = -1;           // so 的封存副本，dlopen 的就是它，dlclose 之后才关闭
+    std::string so_digest;    // so 的 BLAKE3 摘要
+    IScoreOperator* op = nullptr;
+    DestroyFunc* destroy_func = nullptr;
+    uint64_t generation = 0;  // 每次加载递增，用作缓存分区
+    std::string so_file;
+    // 该版本的物品侧预计算列，按 item_id 排列，每个物品 item_precompute_width 个
+    HugeVector<double> item_precomputed;
+    int item_precompute_width = 0;
+    ColumnProjection projection;  // 该版本声明需要的列，加载时解析
+    std::shared_ptr<ParamBlob> parameters;  // so 同名 .params 文件解压后的参数，算子析构后才释放
+    // dlclose 之后依次调用，供剖析器等记录卸载时刻
+    std::vector<std::function<void()>> unload_hooks;
+
+    ~OperatorHolder() {
+        if (op && destroy_func) destroy_func(op);
+        if (handle) dlclose(handle);
+        if (memfd >= 0) close(memfd);
+        for (auto& hook : unload_hooks) hook();
+    }
+};
+
+inline uint64_t next_operator_generation() {
+    static std::atomic<uint64_t> next{1};
+    return next++;
+}
+
+// ---- 加载算子so并创建OperatorHolder ----
+// so 边哈希边拷进 memfd 后从 memfd 加载，配置了校验清单时摘要不符直接失败（见 so_loader.h）
+inline std::shared_ptr<OperatorHolder> load_operator(const std::string& so_file, SoLoadStats* stats = nullptr) {
+    auto holder = std::make_shared<OperatorHolder>();
+    VerifiedLibrary library;
+    if (!open_verified_library(so_file, &library, 0, stats)) return nullptr;
+    holder->handle = library.handle;
+    holder->memfd = library.memfd;
+    holder->so_digest = library.digest;
+    CreateFunc* create = (CreateFunc*) dlsym(holder->handle, "create_operator");
+    DestroyFunc* destroy = (DestroyFunc*) dlsym(holder->handle, "destroy_operator");
+    if (!create || !destroy) {
+        std::cerr << "dlsym fail" << std::endl;
+        return nullptr;  // holder 析构时 dlclose 并关闭 memfd
+    }
+    // 虚函数表布局随接口版本变化，版本不符的 so 调用会落到错误的槽位上，必须拒绝
+    InterfaceVersionFunc* version = (InterfaceVersionFunc*) dlsym(holder->handle, "operator_interface_version");
+    if (!version || version() != kOperatorInterfaceVersion) {
+        std::cerr << "[Loader] " << so_file << " 的算子接口版本 "
+                  << (version ? std::to_string(version()) : std::string("缺失")) << " 与 host 的 "
+                  << kOperatorInterfaceVersion << " 不一致，拒绝加载" << std::endl;
+        return nullptr;
+    }
+    holder->op = create();
+    holder->destroy_func = destroy;
+    holder->generation = next_operator_generation();
+    holder->so_file = so_file;
+    return holder;
+}
+
+// 算子参数文件与 so 同名：score_op_v3.so -> score_op_v3.params
+inline std::string parameter_file_for(const std::string& so_file) {
+    size_t dot = so_file.rfind(".so");
+    return (dot == std::string::npos ? so_file : so_file.substr(0, dot)) + ".params";
+}
+
+// 有参数文件时并行解压到 holder->parameters 并交给算子；没有参数文件直接返回 true
+inline bool attach_parameters(OperatorHolder& holder, const ParamLoadOptions& options = ParamLoadOptions(),
+                              ParamLoadStats* stats = nullptr) {
+    const std::string path = parameter_file_for(holder.so_file);
+    if (access(path.c_str(), R_OK) != 0) return true;
+    auto blob = ParamBlob::load(path, options, stats);
+    if (!blob || !holder.op->set_parameters(blob->view())) {
+        std::cerr << "[Params] 参数加载失败: " << path << std::endl;
+        return false;
+    }
+    holder.parameters = blob;
+    return true;
+}
@@ -1,6 +1,10 @@
 // operator_interface.h
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
 struct Feature {
     int user_id;
     int item_id;
@@ -8,9 +12,202 @@ struct Feature {
     double item_feature;
 };
 
-// 算子基类接口
+// 基础列位掩码，算子用 required_base_columns() 声明自己读哪些
+enum FeatureColumnMask : uint32_t {
+    COL_USER_ID = 1u << 0,
+    COL_ITEM_ID = 1u << 1,
+    COL_USER_FEATURE = 1u << 2,
+    COL_ITEM_FEATURE = 1u << 3,
+    COL_BASE_ALL = COL_USER_ID | COL_ITEM_ID | COL_USER_FEATURE | COL_ITEM_FEATURE,
+};
+
+// 派生特征列（由 host 的变换阶段等生成），按名字查找
+struct FeatureColumn {
+    const char* name;
+    const double* values;
+};
+
+// 变长稀疏特征（如点击过的类目、标签），CSR 排布：
+// 第 i 行的 id 为 ids[offsets[i] .. offsets[i+1])，weights 与 ids 一一对应，为 nullptr 时权重均为 1
+struct SparseFeatureColumn {
+    const char* name;
+    const uint32_t* offsets;  // size + 1 个
+    const uint32_t* ids;
+    const float* weights;
+};
+
+// 压缩编码的物品目录列：不随 batch 搬运，算子按 batch.item_id 直接在目录存储上解码。
+// 解码实现见 column_codec.h（标量与 AVX2 版本，插件可直接包含）。
+enum ColumnEncoding : uint32_t {
+    ENC_RAW = 0,         // double 原值
+    ENC_DICTIONARY = 1,  // uint8 码，值为 dictionary[code]
+    ENC_BITPACKED = 2,   // frame-of-reference：base + 第 i 个 bits 位无符号整数（小端位流）
+    ENC_INT8 = 3,        // int8 * scale，有损
+};
+
+struct EncodedColumn {
+    const char* name;
+    uint32_t encoding;
+    uint32_t bits;             // 仅 BITPACKED
+    size_t rows;               // 目录行数，范围外的 item_id 按 0 处理
+    const void* data;          // 编码数据，尾部至少有 8 字节可读的填充
+    const double* dictionary;  // 仅 DICTIONARY
+    double base;               // 仅 BITPACKED
+    double scale;              // 仅 INT8
+};
+
+// 算子参数：host 从 .params 文件解压到对齐内存后以只读视图交给算子（见 param_file.h），
+// 内存由 OperatorHolder 持有，算子卸载前一直有效，算子可以直接引用而不必拷贝
+struct ParamTensorView {
+    const char* name;
+    const float* data;  // 64 字节对齐
+    size_t count;
+};
+
+struct OperatorParameters {
+    const ParamTensorView* tensors;
+    size_t num_tensors;
+
+    // 找不到返回 nullptr
+    const ParamTensorView* find(const char* name) const {
+        for (size_t i = 0; i < num_tensors; ++i) {
+            if (std::strcmp(tensors[i].name, name) == 0) return &tensors[i];
+        }
+        return nullptr;
+    }
+};
+
+// 列式(SoA)批量输入：各列长度均为 size，内存归 host 所有，算子只读。
+// 按算子声明做了列裁剪时，未声明的基础列为 nullptr。
+struct FeatureBatch {
+    size_t size = 0;
+    const int* user_id = nullptr;
+    const int* item_id = nullptr;
+    const double* user_feature = nullptr;
+    const double* item_feature = nullptr;
+    const FeatureColumn* extra = nullptr;
+    size_t num_extra = 0;
+    // 物品侧预计算结果，按行排列，每行 item_precompute_width 个；算子未声明预计算时为 nullptr
+    const double* item_precomputed = nullptr;
+    int item_precompute_width = 0;
+    // 稀疏特征列，CSR 排布
+    const SparseFeatureColumn* sparse = nullptr;
+    size_t num_sparse = 0;
+    // 以压缩形式交给算子的目录列（算子 accepts_encoded_columns() 时才有），按 item_id 下标访问
+    const EncodedColumn* encoded = nullptr;
+    size_t num_encoded = 0;
+
+    // 找不到返回 nullptr
+    const double* find(const char* name) const {
+        for (size_t i = 0; i < num_extra; ++i) {
+            if (std::strcmp(extra[i].name, name) == 0) return extra[i].values;
+        }
+        return nullptr;
+    }
+    const SparseFeatureColumn* find_sparse(const char* name) const {
+        for (size_t i = 0; i < num_sparse; ++i) {
+            if (std::strcmp(sparse[i].name, name) == 0) return &sparse[i];
+        }
+        return nullptr;
+    }
+    const EncodedColumn* find_encoded(const char* name) const {
+        for (size_t i = 0; i < num_encoded; ++i) {
+            if (std::strcmp(encoded[i].name, name) == 0) return &encoded[i];
+        }
+        return nullptr;
+    }
+    // 被裁掉的列按 0 填充
+    Feature row(size_t i) const {
+        return Feature{user_id ? user_id[i] : 0, item_id ? item_id[i] : 0,
+                       user_feature ? user_feature[i] : 0.0, item_feature ? item_feature[i] : 0.0};
+    }
+};
+
+// float32 列式输入，只含基础列；带宽受限、对精度不敏感的批量场景使用。
+// 与 FeatureBatch 一样，未声明的列可以为 nullptr（按 0 处理）。
+struct FeatureBatchF32 {
+    size_t size = 0;
+    const int* user_id = nullptr;
+    const int* item_id = nullptr;
+    const float* user_feature = nullptr;
+    const float* item_feature = nullptr;
+
+    Feature row(size_t i) const {
+        return Feature{user_id ? user_id[i] : 0, item_id ? item_id[i] : 0,
+                       user_feature ? double(user_feature[i]) : 0.0, item_feature ? double(item_feature[i]) : 0.0};
+    }
+};
+
+// 算子接口版本：插件导出 operator_interface_version()（HOTPLUG_EXPORT_OPERATOR_INTERFACE_VERSION），
+// load_operator 不一致时拒绝加载。IScoreOperator 的虚函数表布局就是插件 ABI：新增虚函数只能追加在类的末尾，
+// 已有的不能删除、挪动或改签名；每次追加都要递增这个版本。
+constexpr uint32_t kOperatorInterfaceVersion = 2;
+
+#define HOTPLUG_EXPORT_OPERATOR_INTERFACE_VERSION() \
+    extern "C" uint32_t operator_interface_version() { return kOperatorInterfaceVersion; }
+
+// 算子基类接口（虚函数按加入的先后排列，见上）
 struct IScoreOperator {
     virtual ~IScoreOperator() = default;
     virtual double compute_score(const Feature& feature) = 0;
     virtual const char* name() const = 0; // 方便验证版本
+
+    // ---- 可选：分阶段评估，供 top-K 请求做阈值剪枝 ----
+    // num_stages() 返回 0 表示不支持，host 退化为完整计算。
+    // host 依次调用 stage = 0..num_stages()-1，state 为上一阶段的返回值（首阶段为 0），
+    // *upper_bound 输出"剩余阶段做完后最终分数"的上界。
+    // 约定：最后一阶段的返回值必须与 compute_score 完全相等，且上界必须真实有效，
+    // host 的剪枝才是精确的（被放弃的候选不可能进入 top-K）。
+    virtual int num_stages() const { return 0; }
+    virtual double evaluate_stage(const Feature& feature, int stage, double state, double* upper_bound) {
+        (void)stage; (void)state;
+        double score = compute_score(feature);
+        *upper_bound = score;
+        return score;
+    }
+
+    // 批量打分：一次虚调用处理 n 个候选，算子可覆盖以做向量化
+    virtual void compute_score_batch(const Feature* features, size_t n, double* scores) {
+        for (size_t i = 0; i < n; ++i) scores[i] = compute_score(features[i]);
+    }
+    // 列式批量打分：默认逐行还原成 Feature，算子可覆盖以直接按列计算。
+    // 稀疏特征只通过这个入口传给算子（单条 Feature 里没有变长字段）。
+    virtual void compute_score_soa(const FeatureBatch& batch, double* scores) {
+        for (size_t i = 0; i < batch.size; ++i) scores[i] = compute_score(batch.row(i));
+    }
+
+    // ---- 可选：物品侧预计算 ----
+    // 只依赖物品的子表达式对所有用户都一样。声明了宽度的算子，host 会在 load_operator 阶段
+    // （发布前）对全量物品目录并行调用 precompute_item，结果作为该版本独有的一列，
+    // 批量打分时通过 FeatureBatch::item_precomputed 读取，不再逐请求重复计算。
+    virtual int item_precompute_width() const { return 0; }
+    virtual void precompute_item(int item_id, double item_feature, double* out) {
+        (void)item_id; (void)item_feature; (void)out;
+    }
+
+    // ---- 可选：列裁剪声明 ----
+    // 加载时读取一次。host 的 gather 阶段只拉取并排布这里声明的列，宽特征表下能省大量内存带宽。
+    // required_catalog_columns 返回以 nullptr 结尾的目录列名数组；返回 nullptr 表示要全部目录列。
+    virtual uint32_t required_base_columns() const { return COL_BASE_ALL; }
+    virtual const char* const* required_catalog_columns() const { return nullptr; }
+    // 需要的稀疏特征列名，nullptr 结尾；返回 nullptr 表示不读稀疏特征
+    virtual const char* const* required_sparse_columns() const { return nullptr; }
+
+    // float32 列式批量打分：默认逐行按 double 计算后截断，算子可覆盖以用更宽的 float 向量
+    virtual void compute_score_f32(const FeatureBatchF32& batch, float* scores) {
+        for (size_t i = 0; i < batch.size; ++i) scores[i] = float(compute_score(batch.row(i)));
+    }
+
+    // 目录里以压缩编码存储的列，是否直接以 EncodedColumn 形式交给算子（在内核里解码）；
+    // 返回 false 时 host 先解码成 double 再 gather 进 extra 列
+    virtual bool accepts_encoded_columns() const { return false; }
+
+    // 可选：加载期（发布前）调用一次，传入 so 同名 .params 文件里的参数；返回 false 视为加载失败。
+    // 没有参数文件时不调用，算子应能用内置默认参数工作。
+    virtual bool set_parameters(const OperatorParameters& params) {
+        (void)params;
+        return true;
+    }
+
+    // 新增虚函数只能加在这里（类的末尾），并递增 kOperatorInterfaceVersion
 };
@@ -0,0 +1,277 @@
+// operator_sdk.h
+#pragma once
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "operator_interface.h"
+#include "simd_util.h"
+
+// ---- 算子 SDK ----
+// 插件作者只写一次打分内核（对"标量或向量"类型 V 的模板），SDK 据此生成全部入口：
+//   compute_score        标量，V = double
+//   compute_score_batch  AoS，按块转成列后走 compute_score_soa
+//   compute_score_soa    double 列：AVX-512（8 路）/ AVX2（4 路）/ 标量，运行时按 CPU 选择
+//   compute_score_f32    float 列：AVX-512（16 路）/ AVX2（8 路）/ 标量
+// 写法（见 score_op_v1.cpp）：
+//   struct MyOp : hotplug_sdk::Operator<MyOp> {
+//       template <class V> HOTPLUG_KERNEL static V score(const hotplug_sdk::Row<V>& r) { ... }
+//       const char* name() const override { ... }
+//   };
+//   HOTPLUG_EXPORT_OPERATOR(MyOp)
+// 内核里只用 + - * /、比较 + select 以及 hotplug_sdk 里的数学函数，同一份代码对标量和向量都成立。
+// 向量类型基于 GCC vector extension，不含指令集相关的 intrinsic：内核连同各运算被强制内联进带
+// target 属性的入口函数，在那里才按 AVX2 / AVX-512 生成代码，插件本身仍按基线指令集编译。
+// SDK 只把基础列交给内核；要读目录宽列、稀疏特征或预计算列的算子自行覆盖 compute_score_soa。
+// 环境变量 HOTPLUG_SDK_ISA=scalar|avx2|avx512 可以限制所用的最高路径（创建算子时读取），便于对拍。
+
+// vector 参数只出现在强制内联的函数里，不会跨越真正的调用边界
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+#define HOTPLUG_KERNEL __attribute__((always_inline)) inline
+
+namespace hotplug_sdk {
+
+// N 路向量，T 为 double 或 float
+template <class T, int N>
+struct simd {
+    typedef T native __attribute__((vector_size(sizeof(T) * N)));
+    typedef decltype(native() < native()) mask_native;
+    native v;
+};
+
+template <class T, int N>
+struct simd_mask {
+    typename simd<T, N>::mask_native m;
+};
+
+#define HOTPLUG_SDK_BINARY_OP(op)                                                     \
+    template <class T, int N>                                                         \
+    HOTPLUG_KERNEL simd<T, N> operator op(const simd<T, N>& a, const simd<T, N>& b) { \
+        return simd<T, N>{a.v op b.v};                                                \
+    }                                                                                 \
+    template <class T, int N>                                                         \
+    HOTPLUG_KERNEL simd<T, N> operator op(const simd<T, N>& a, double b) {            \
+        return simd<T, N>{a.v op T(b)};                                               \
+    }                                                                                 \
+    template <class T, int N>                                                         \
+    HOTPLUG_KERNEL simd<T, N> operator op(double a, const simd<T, N>& b) {            \
+        return simd<T, N>{T(a) op b.v};                                               \
+    }
+HOTPLUG_SDK_BINARY_OP(+)
+HOTPLUG_SDK_BINARY_OP(-)
+HOTPLUG_SDK_BINARY_OP(*)
+HOTPLUG_SDK_BINARY_OP(/)
+#undef HOTPLUG_SDK_BINARY_OP
+
+template <class T, int N>
+HOTPLUG_KERNEL simd<T, N> operator-(const simd<T, N>& a) { return simd<T, N>{-a.v}; }
+
+#define HOTPLUG_SDK_COMPARE_OP(op)                                                         \
+    template <class T, int N>                                                              \
+    HOTPLUG_KERNEL simd_mask<T, N> operator op(const simd<T, N>& a, const simd<T, N>& b) { \
+        return simd_mask<T, N>{a.v op b.v};                                                \
+    }                                                                                      \
+    template <class T, int N>                                                              \
+    HOTPLUG_KERNEL simd_mask<T, N> operator op(const simd<T, N>& a, double b) {            \
+        return simd_mask<T, N>{a.v op T(b)};                                               \
+    }
+HOTPLUG_SDK_COMPARE_OP(<)
+HOTPLUG_SDK_COMPARE_OP(<=)
+HOTPLUG_SDK_COMPARE_OP(>)
+HOTPLUG_SDK_COMPARE_OP(>=)
+#undef HOTPLUG_SDK_COMPARE_OP
+
+// select(cond, a, b)：逐路 cond ? a : b
+template <class T, int N>
+HOTPLUG_KERNEL simd<T, N> select(const simd_mask<T, N>& c, const simd<T, N>& a, const simd<T, N>& b) {
+    return simd<T, N>{c.m ? a.v : b.v};
+}
+// 标量版本允许 float / double 混用（内核里的常量是 double），结果取公共类型
+template <class A, class B>
+HOTPLUG_KERNEL auto select(bool c, A a, B b) -> decltype(a + b) { return c ? a : b; }
+
+template <class T, int N>
+HOTPLUG_KERNEL simd<T, N> min(const simd<T, N>& a, const simd<T, N>& b) { return simd<T, N>{a.v < b.v ? a.v : b.v}; }
+template <class T, int N>
+HOTPLUG_KERNEL simd<T, N> max(const simd<T, N>& a, const simd<T, N>& b) { return simd<T, N>{a.v > b.v ? a.v : b.v}; }
+template <class T, int N>
+HOTPLUG_KERNEL simd<T, N> abs(const simd<T, N>& a) { return simd<T, N>{a.v < 0 ? -a.v : a.v}; }
+template <class A, class B>
+HOTPLUG_KERNEL auto min(A a, B b) -> decltype(a + b) { return a < b ? a : b; }
+template <class A, class B>
+HOTPLUG_KERNEL auto max(A a, B b) -> decltype(a + b) { return a > b ? a : b; }
+HOTPLUG_KERNEL double abs(double a) { return std::fabs(a); }
+HOTPLUG_KERNEL float abs(float a) { return std::fabs(a); }
+
+// 超越函数逐路调用 libm；热点内核里尽量避免
+#define HOTPLUG_SDK_LANEWISE(fn)                                          \
+    template <class T, int N>                                             \
+    HOTPLUG_KERNEL simd<T, N> fn(const simd<T, N>& a) {                   \
+        simd<T, N> r;                                                     \
+        for (int k = 0; k < N; ++k) r.v[k] = std::fn(a.v[k]);             \
+        return r;                                                         \
+    }                                                                     \
+    HOTPLUG_KERNEL double fn(double a) { return std::fn(a); }             \
+    HOTPLUG_KERNEL float fn(float a) { return std::fn(a); }
+HOTPLUG_SDK_LANEWISE(sqrt)
+HOTPLUG_SDK_LANEWISE(exp)
+HOTPLUG_SDK_LANEWISE(log)
+HOTPLUG_SDK_LANEWISE(sin)
+HOTPLUG_SDK_LANEWISE(cos)
+HOTPLUG_SDK_LANEWISE(tanh)
+#undef HOTPLUG_SDK_LANEWISE
+
+// 内核输入：一行（标量）或 N 行（向量）的基础列，被裁剪掉的列为 0
+template <class V>
+struct Row {
+    V user_id;
+    V item_id;
+    V user_feature;
+    V item_feature;
+};
+
+namespace detail {
+
+template <class T, int N>
+HOTPLUG_KERNEL simd<T, N> load(const T* p, size_t i) {
+    simd<T, N> r;
+    if (p) std::memcpy(&r.v, p + i, sizeof(r.v));
+    else r.v = typename simd<T, N>::native();
+    return r;
+}
+
+template <class T, int N>
+HOTPLUG_KERNEL simd<T, N> load(const int* p, size_t i) {
+    typedef int ints __attribute__((vector_size(sizeof(int) * N)));
+    simd<T, N> r;
+    if (p) {
+        ints x;
+        std::memcpy(&x, p + i, sizeof(x));
+        r.v = __builtin_convertvector(x, typename simd<T, N>::native);
+    } else {
+        r.v = typename simd<T, N>::native();
+    }
+    return r;
+}
+
+template <class T, class S>
+HOTPLUG_KERNEL T load_one(const S* p, size_t i) { return p ? T(p[i]) : T(0); }
+
+// 逐行跑标量内核，处理 [begin, b.size)
+template <class Derived, class T, class Batch>
+HOTPLUG_KERNEL void run_rows(const Batch& b, size_t begin, T* out) {
+    for (size_t i = begin; i < b.size; ++i) {
+        Row<T> r{load_one<T>(b.user_id, i), load_one<T>(b.item_id, i), load_one<T>(b.user_feature, i),
+                 load_one<T>(b.item_feature, i)};
+        out[i] = T(Derived::template score<T>(r));
+    }
+}
+
+// 按列跑内核：整块走 N 路向量，尾部走标量
+template <class Derived, class T, int N, class Batch>
+HOTPLUG_KERNEL void run_columns(const Batch& b, T* out) {
+    typedef simd<T, N> V;
+    size_t i = 0;
+    for (; i + N <= b.size; i += N) {
+        Row<V> r{load<T, N>(b.user_id, i), load<T, N>(b.item_id, i), load<T, N>(b.user_feature, i),
+                 load<T, N>(b.item_feature, i)};
+        V s = Derived::template score<V>(r);
+        std::memcpy(out + i, &s.v, sizeof(s.v));
+    }
+    run_rows<Derived>(b, i, out);
+}
+
+}  // namespace detail
+
+enum class Isa { Scalar = 0, Avx2 = 1, Avx512 = 2 };
+
+inline Isa detect_isa() {
+    Isa best = cpu_has_avx512() ? Isa::Avx512 : (cpu_has_avx2() ? Isa::Avx2 : Isa::Scalar);
+    const char* env = std::getenv("HOTPLUG_SDK_ISA");
+    if (env) {
+        Isa want = std::strcmp(env, "scalar") == 0 ? Isa::Scalar : (std::strcmp(env, "avx2") == 0 ? Isa::Avx2 : best);
+        if (int(want) < int(best)) best = want;
+    }
+    return best;
+}
+
+// CRTP 基类：Derived 提供 template <class V> static V score(const Row<V>&)
+template <class Derived>
+class Operator : public IScoreOperator {
+public:
+    Operator() : isa_(detect_isa()) {}
+
+    Isa isa() const { return isa_; }
+
+    double compute_score(const Feature& f) override {
+        Row<double> r{double(f.user_id), double(f.item_id), f.user_feature, f.item_feature};
+        return Derived::template score<double>(r);
+    }
+
+    void compute_score_batch(const Feature* features, size_t n, double* scores) override {
+        // 按块转置成列，块内数据留在 L1
+        const size_t kBlock = 64;
+        int user_id[kBlock], item_id[kBlock];
+        double user_feature[kBlock], item_feature[kBlock];
+        for (size_t begin = 0; begin < n; begin += kBlock) {
+            FeatureBatch batch;
+            batch.size = n - begin < kBlock ? n - begin : kBlock;
+            for (size_t i = 0; i < batch.size; ++i) {
+                const Feature& f = features[begin + i];
+                user_id[i] = f.user_id;
+                item_id[i] = f.item_id;
+                user_feature[i] = f.user_feature;
+                item_feature[i] = f.item_feature;
+            }
+            batch.user_id = user_id;
+            batch.item_id = item_id;
+            batch.user_feature = user_feature;
+            batch.item_feature = item_feature;
+            compute_score_soa(batch, scores + begin);
+        }
+    }
+
+    void compute_score_soa(const FeatureBatch& batch, double* scores) override {
+        switch (isa_) {
+        case Isa::Avx512: soa_avx512(batch, scores); break;
+        case Isa::Avx2: soa_avx2(batch, scores); break;
+        default: detail::run_rows<Derived>(batch, 0, scores); break;
+        }
+    }
+
+    void compute_score_f32(const FeatureBatchF32& batch, float* scores) override {
+        switch (isa_) {
+        case Isa::Avx512: f32_avx512(batch, scores); break;
+        case Isa::Avx2: f32_avx2(batch, scores); break;
+        default: detail::run_rows<Derived>(batch, 0, scores); break;
+        }
+    }
+
+private:
+    __attribute__((target("avx2,fma"))) static void soa_avx2(const FeatureBatch& b, double* out) {
+        detail::run_columns<Derived, double, 4>(b, out);
+    }
+    __attribute__((target("avx512f"))) static void soa_avx512(const FeatureBatch& b, double* out) {
+        detail::run_columns<Derived, double, 8>(b, out);
+    }
+    __attribute__((target("avx2,fma"))) static void f32_avx2(const FeatureBatchF32& b, float* out) {
+        detail::run_columns<Derived, float, 8>(b, out);
+    }
+    __attribute__((target("avx512f"))) static void f32_avx512(const FeatureBatchF32& b, float* out) {
+        detail::run_columns<Derived, float, 16>(b, out);
+    }
+
+    Isa isa_;
+};
+
+}  // namespace hotplug_sdk
+
+#pragma GCC diagnostic pop
+
+#define HOTPLUG_EXPORT_OPERATOR(Class)                                    \
+    extern "C" IScoreOperator* create_operator() { return new Class(); }  \
+    extern "C" void destroy_operator(IScoreOperator* op) { delete op; }   \
+    HOTPLUG_EXPORT_OPERATOR_INTERFACE_VERSION()
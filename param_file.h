@@ -0,0 +1,327 @@
+// param_file.h
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "housekeeping.h"
+#include "huge_pages.h"
+#include "operator_interface.h"
+
+// ---- 算子参数文件（分块压缩容器）----
+// 大参数（embedding 表等）压缩后随算子下发。整份参数按 block_size 切成独立压缩的块，
+// 每块带解压后的 crc32；加载时在 housekeeping 线程上并行解压 + 校验，直接写进最终的对齐内存，
+// 不经过中间缓冲，加载耗时随核数下降。张量只支持 float32，解压后的偏移按 64 字节对齐。
+//
+// 文件格式（小端）：
+//   ParamFileHeader (64 字节)
+//   张量表          num_tensors x ParamTensorEntry
+//   块表            num_blocks  x ParamBlockEntry
+//   各块数据        按块表顺序紧密排列
+// 第 i 块解压后落在 [i * block_size, i * block_size + raw_size)。
+
+struct ParamFileHeader {
+    char magic[8];  // "HPPARAM\0"
+    uint32_t version;
+    uint32_t num_tensors;
+    uint32_t num_blocks;
+    uint32_t block_size;  // 解压后每块字节数，最后一块可以更短
+    uint64_t raw_size;    // 解压后总字节数
+    uint32_t table_crc;   // 张量表 + 块表的 crc32
+    uint8_t reserved[28];
+};
+static_assert(sizeof(ParamFileHeader) == 64, "header must stay 64 bytes");
+
+struct ParamTensorEntry {
+    char name[48];  // '\0' 结尾
+    uint64_t offset;  // 解压后的字节偏移，64 字节对齐
+    uint64_t count;   // float 个数
+};
+static_assert(sizeof(ParamTensorEntry) == 64, "tensor entry must stay 64 bytes");
+
+enum ParamCodec : uint32_t {
+    PARAM_STORED = 0,  // 压缩后不变小的块原样存放
+    PARAM_ZLIB = 1,
+};
+
+struct ParamBlockEntry {
+    uint64_t file_offset;
+    uint32_t stored_size;
+    uint32_t raw_size;
+    uint32_t crc;  // 解压后数据的 crc32
+    uint32_t codec;
+};
+static_assert(sizeof(ParamBlockEntry) == 24, "block entry must stay 24 bytes");
+
+// 离线写参数文件用
+struct ParamTensorData {
+    std::string name;
+    std::vector<float> values;
+};
+
+namespace param_detail {
+
+constexpr size_t kTensorAlign = 64;
+
+inline uint32_t crc_of(const void* data, size_t size) {
+    return uint32_t(crc32(crc32(0L, Z_NULL, 0), static_cast<const Bytef*>(data), uInt(size)));
+}
+
+inline size_t align_up(size_t n, size_t align) { return (n + align - 1) / align * align; }
+
+}  // namespace param_detail
+
+// 块在 housekeeping 线程上并行压缩；level 为 zlib 压缩级别
+inline bool write_param_file(const std::string& path, const std::vector<ParamTensorData>& tensors,
+                             uint32_t block_size = 1u << 20, int level = 1) {
+    using namespace param_detail;
+    if (block_size == 0) return false;
+    std::vector<ParamTensorEntry> entries(tensors.size());
+    size_t raw_size = 0;
+    for (size_t t = 0; t < tensors.size(); ++t) {
+        if (tensors[t].name.size() >= sizeof(entries[t].name)) {
+            std::cerr << "[Params] 张量名过长: " << tensors[t].name << std::endl;
+            return false;
+        }
+        std::memset(&entries[t], 0, sizeof(entries[t]));
+        std::memcpy(entries[t].name, tensors[t].name.c_str(), tensors[t].name.size());
+        raw_size = align_up(raw_size, kTensorAlign);
+        entries[t].offset = raw_size;
+        entries[t].count = tensors[t].values.size();
+        raw_size += tensors[t].values.size() * sizeof(float);
+    }
+    std::vector<uint8_t> raw(raw_size, 0);
+    for (size_t t = 0; t < tensors.size(); ++t) {
+        if (!tensors[t].values.empty()) {
+            std::memcpy(raw.data() + entries[t].offset, tensors[t].values.data(), tensors[t].values.size() * sizeof(float));
+        }
+    }
+
+    const size_t num_blocks = (raw_size + block_size - 1) / block_size;
+    std::vector<ParamBlockEntry> blocks(num_blocks);
+    std::vector<std::vector<uint8_t>> stored(num_blocks);
+    housekeeping_parallel_for(num_blocks, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            const uint8_t* src = raw.data() + b * block_size;
+            const size_t n = std::min<size_t>(block_size, raw_size - b * block_size);
+            uLongf packed = compressBound(uLong(n));
+            stored[b].resize(packed);
+            blocks[b].raw_size = uint32_t(n);
+            blocks[b].crc = crc_of(src, n);
+            if (compress2(stored[b].data(), &packed, src, uLong(n), level) == Z_OK && packed < n) {
+                stored[b].resize(packed);
+                blocks[b].codec = PARAM_ZLIB;
+            } else {
+                stored[b].assign(src, src + n);
+                blocks[b].codec = PARAM_STORED;
+            }
+            blocks[b].stored_size = uint32_t(stored[b].size());
+        }
+    });
+    size_t offset = sizeof(ParamFileHeader) + entries.size() * sizeof(ParamTensorEntry) +
+                    blocks.size() * sizeof(ParamBlockEntry);
+    for (size_t b = 0; b < num_blocks; ++b) {
+        blocks[b].file_offset = offset;
+        offset += blocks[b].stored_size;
+    }
+
+    ParamFileHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, "HPPARAM", 8);
+    h.version = 1;
+    h.num_tensors = uint32_t(entries.size());
+    h.num_blocks = uint32_t(num_blocks);
+    h.block_size = block_size;
+    h.raw_size = raw_size;
+    uint32_t crc = uint32_t(crc32(0L, Z_NULL, 0));
+    crc = uint32_t(crc32(crc, reinterpret_cast<const Bytef*>(entries.data()), uInt(entries.size() * sizeof(ParamTensorEntry))));
+    crc = uint32_t(crc32(crc, reinterpret_cast<const Bytef*>(blocks.data()), uInt(blocks.size() * sizeof(ParamBlockEntry))));
+    h.table_crc = crc;
+
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) return false;
+    bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1;
+    ok = ok && std::fwrite(entries.data(), sizeof(ParamTensorEntry), entries.size(), f) == entries.size();
+    ok = ok && std::fwrite(blocks.data(), sizeof(ParamBlockEntry), blocks.size(), f) == blocks.size();
+    for (size_t b = 0; ok && b < num_blocks; ++b) {
+        ok = std::fwrite(stored[b].data(), 1, stored[b].size(), f) == stored[b].size();
+    }
+    return std::fclose(f) == 0 && ok;
+}
+
+struct ParamLoadOptions {
+    int threads = 0;          // 0：housekeeping 线程数
+    bool huge_pages = true;   // 目标内存按 HOTPLUG_HUGE_PAGES 策略用大页，false 时用 4K 页
+};
+
+struct ParamLoadStats {
+    size_t file_bytes = 0;
+    size_t raw_bytes = 0;
+    size_t blocks = 0;
+    int threads = 0;
+    double millis = 0;
+    const char* page_mode = "";  // hugetlb-1g / hugetlb-2m / thp / 4k
+};
+
+// 解压后的参数，持有对齐内存；由 OperatorHolder 持有，算子卸载后才释放
+class ParamBlob {
+public:
+    ~ParamBlob() { huge_page_unmap(block_); }
+
+    static std::shared_ptr<ParamBlob> load(const std::string& path, const ParamLoadOptions& options = ParamLoadOptions(),
+                                           ParamLoadStats* stats = nullptr) {
+        using namespace param_detail;
+        auto start = std::chrono::steady_clock::now();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "[Params] 无法打开: " << path << std::endl;
+            return nullptr;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            std::cerr << "[Params] fstat 失败: " << path << std::endl;
+            ::close(fd);
+            return nullptr;
+        }
+        const size_t file_size = size_t(st.st_size);
+        void* file = file_size >= sizeof(ParamFileHeader) ? mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0)
+                                                          : MAP_FAILED;
+        ::close(fd);
+        if (file == MAP_FAILED) {
+            std::cerr << "[Params] mmap 失败: " << path << std::endl;
+            return nullptr;
+        }
+        std::shared_ptr<ParamBlob> blob(new ParamBlob());
+        bool ok = blob->decode(static_cast<const uint8_t*>(file), file_size, options, path, stats);
+        munmap(file, file_size);
+        if (!ok) return nullptr;
+        if (stats) {
+            stats->file_bytes = file_size;
+            stats->millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+        return blob;
+    }
+
+    OperatorParameters view() const { return OperatorParameters{views_.data(), views_.size()}; }
+    size_t raw_size() const { return raw_size_; }
+    const char* page_mode() const { return page_mode_; }
+
+private:
+    ParamBlob() = default;
+    ParamBlob(const ParamBlob&) = delete;
+    ParamBlob& operator=(const ParamBlob&) = delete;
+
+    // 目标内存按 huge_pages.h 的策略分配（默认 hugetlb -> THP -> 4K），2MB 对齐
+    bool allocate(size_t size, bool huge_pages) {
+        block_ = huge_page_map(size, huge_pages ? default_huge_page_policy() : HUGE_PAGES_OFF);
+        data_ = static_cast<uint8_t*>(block_.data);
+        page_mode_ = block_.mode;
+        return data_ != nullptr;
+    }
+
+    bool decode(const uint8_t* file, size_t file_size, const ParamLoadOptions& options, const std::string& path,
+                ParamLoadStats* stats) {
+        using namespace param_detail;
+        const ParamFileHeader* h = reinterpret_cast<const ParamFileHeader*>(file);
+        const size_t tables = sizeof(ParamFileHeader) + size_t(h->num_tensors) * sizeof(ParamTensorEntry) +
+                              size_t(h->num_blocks) * sizeof(ParamBlockEntry);
+        if (std::memcmp(h->magic, "HPPARAM", 8) != 0 || h->version != 1 || h->block_size == 0 || tables > file_size ||
+            size_t(h->num_blocks) != (h->raw_size + h->block_size - 1) / h->block_size) {
+            std::cerr << "[Params] 文件格式错误: " << path << std::endl;
+            return false;
+        }
+        if (crc_of(file + sizeof(ParamFileHeader), tables - sizeof(ParamFileHeader)) != h->table_crc) {
+            std::cerr << "[Params] 表头校验失败: " << path << std::endl;
+            return false;
+        }
+        const ParamTensorEntry* tensors = reinterpret_cast<const ParamTensorEntry*>(file + sizeof(ParamFileHeader));
+        const ParamBlockEntry* blocks = reinterpret_cast<const ParamBlockEntry*>(tensors + h->num_tensors);
+        for (uint32_t t = 0; t < h->num_tensors; ++t) {
+            const ParamTensorEntry& e = tensors[t];
+            if (e.offset % kTensorAlign != 0 || e.count > (h->raw_size - std::min(e.offset, h->raw_size)) / sizeof(float) ||
+                std::memchr(e.name, '\0', sizeof(e.name)) == nullptr) {
+                std::cerr << "[Params] 张量表损坏: " << path << std::endl;
+                return false;
+            }
+        }
+        for (uint32_t b = 0; b < h->num_blocks; ++b) {
+            const ParamBlockEntry& e = blocks[b];
+            const size_t expect = std::min<uint64_t>(h->block_size, h->raw_size - uint64_t(b) * h->block_size);
+            if (e.raw_size != expect || e.file_offset < tables || e.file_offset > file_size ||
+                e.stored_size > file_size - e.file_offset ||
+                (e.codec == PARAM_STORED && e.stored_size != e.raw_size) || e.codec > PARAM_ZLIB) {
+                std::cerr << "[Params] 块表损坏: " << path << std::endl;
+                return false;
+            }
+        }
+        if (!allocate(h->raw_size, options.huge_pages)) {
+            std::cerr << "[Params] 分配 " << h->raw_size << " 字节失败: " << path << std::endl;
+            return false;
+        }
+        raw_size_ = h->raw_size;
+
+        // 每个线程负责一段连续的块，解压目标就是最终地址，缺页也在各线程上并行发生
+        std::atomic<int64_t> bad_block{-1};
+        const size_t threads = options.threads > 0 ? size_t(options.threads) : size_t(housekeeping_thread_num());
+        const uint32_t block_size = h->block_size;
+        housekeeping_parallel_for(h->num_blocks, [&](size_t begin, size_t end) {
+            for (size_t b = begin; b < end && bad_block.load(std::memory_order_relaxed) < 0; ++b) {
+                const ParamBlockEntry& e = blocks[b];
+                uint8_t* dst = data_ + b * block_size;
+                bool block_ok;
+                if (e.codec == PARAM_STORED) {
+                    std::memcpy(dst, file + e.file_offset, e.raw_size);
+                    block_ok = true;
+                } else {
+                    uLongf n = e.raw_size;
+                    block_ok = uncompress(dst, &n, file + e.file_offset, e.stored_size) == Z_OK && n == e.raw_size;
+                }
+                if (!block_ok || crc_of(dst, e.raw_size) != e.crc) {
+                    int64_t none = -1;
+                    bad_block.compare_exchange_strong(none, int64_t(b));
+                }
+            }
+        }, threads);
+        if (bad_block.load() >= 0) {
+            std::cerr << "[Params] 第 " << bad_block.load() << " 块解压或校验失败: " << path << std::endl;
+            return false;
+        }
+
+        names_.resize(h->num_tensors);
+        views_.resize(h->num_tensors);
+        for (uint32_t t = 0; t < h->num_tensors; ++t) {
+            names_[t] = tensors[t].name;
+            views_[t] = ParamTensorView{nullptr, reinterpret_cast<const float*>(data_ + tensors[t].offset),
+                                        size_t(tensors[t].count)};
+        }
+        for (uint32_t t = 0; t < h->num_tensors; ++t) views_[t].name = names_[t].c_str();
+        if (stats) {
+            stats->raw_bytes = raw_size_;
+            stats->blocks = h->num_blocks;
+            stats->threads = int(std::min<size_t>(threads, std::max<size_t>(h->num_blocks, 1)));
+            stats->page_mode = page_mode_;
+        }
+        return true;
+    }
+
+    HugePageBlock block_;
+    uint8_t* data_ = nullptr;
+    size_t raw_size_ = 0;
+    const char* page_mode_ = "";
+    std::vector<std::string> names_;
+    std::vector<ParamTensorView> views_;
+};
@@ -0,0 +1,403 @@
+// pipeline.h
+#pragma once
+
+#include <dlfcn.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "diversity.h"
+#include "eligibility.h"
+#include "feature_batch.h"
+#include "gather.h"
+#include "item_catalog.h"
+#include "item_precompute.h"
+#include "operator_holder.h"
+#include "retrieval.h"
+#include "stage_interface.h"
+
+// ---- pipeline 执行器 ----
+// 一条 pipeline = source 阶段 + 若干 transform 阶段 + sink 阶段 + 可选的若干 rerank 阶段，按名字排成一条链。
+// 整条链是一个不可变快照，用 shared_ptr + atomic_store 发布：请求开始时取一次快照，
+// 全程只用这一份，替换任意阶段都是"复制快照、换掉一格、整体发布"，进行中的请求不受影响。
+// source 产出的候选按 chunk_size 切块，每块依次流过所有 transform 后交给 sink，
+// 块内的特征列和分数始终留在缓存里。sink 汇总完后，rerank 阶段依次对整个排名重排一次。
+
+using StageCreateFunc = IPipelineStage* ();
+using StageDestroyFunc = void (IPipelineStage*);
+using StageInterfaceVersionFunc = uint32_t ();
+
+// 封装阶段实例：.so 加载的或 host 内建的，析构时自动释放
+struct StageHolder {
+    void* handle = nullptr;
+    int memfd = -1;                            // so 的封存副本，dlclose 之后才关闭
+    std::string so_digest;
+    IPipelineStage* stage = nullptr;
+    StageDestroyFunc* destroy_func = nullptr;  // 为 nullptr 时是 host 内建阶段，直接 delete
+    uint64_t generation = 0;
+    std::string source;                        // so 文件或内建阶段的描述
+
+    ~StageHolder() {
+        if (stage) {
+            if (destroy_func) destroy_func(stage);
+            else delete stage;
+        }
+        if (handle) dlclose(handle);
+        if (memfd >= 0) close(memfd);
+    }
+};
+
+inline uint64_t next_stage_generation() {
+    static std::atomic<uint64_t> next{1};
+    return next++;
+}
+
+inline std::shared_ptr<StageHolder> load_stage(const std::string& so_file) {
+    auto holder = std::make_shared<StageHolder>();
+    VerifiedLibrary library;
+    if (!open_verified_library(so_file, &library)) return nullptr;
+    holder->handle = library.handle;
+    holder->memfd = library.memfd;
+    holder->so_digest = library.digest;
+    StageCreateFunc* create = (StageCreateFunc*) dlsym(holder->handle, "create_stage");
+    StageDestroyFunc* destroy = (StageDestroyFunc*) dlsym(holder->handle, "destroy_stage");
+    if (!create || !destroy) {
+        std::cerr << "[Pipeline] dlsym fail: " << so_file << std::endl;
+        dlclose(holder->handle);
+        holder->handle = nullptr;
+        return nullptr;
+    }
+    StageInterfaceVersionFunc* version = (StageInterfaceVersionFunc*) dlsym(holder->handle, "stage_interface_version");
+    if (!version || version() != kStageInterfaceVersion) {
+        std::cerr << "[Pipeline] " << so_file << " 的阶段接口版本 "
+                  << (version ? std::to_string(version()) : std::string("缺失")) << " 与 host 的 "
+                  << kStageInterfaceVersion << " 不一致，拒绝加载" << std::endl;
+        return nullptr;
+    }
+    holder->stage = create();
+    holder->destroy_func = destroy;
+    holder->generation = next_stage_generation();
+    holder->source = so_file;
+    return holder;
+}
+
+inline std::shared_ptr<StageHolder> make_builtin_stage(IPipelineStage* stage, const std::string& description) {
+    auto holder = std::make_shared<StageHolder>();
+    holder->stage = stage;
+    holder->generation = next_stage_generation();
+    holder->source = description;
+    return holder;
+}
+
+// ---- host 内建阶段 ----
+// 它们依赖 host 侧数据（embedding 矩阵、资格位图、物品目录、算子版本），各自持有所需版本的引用。
+
+// 暴力内积召回
+class RetrievalStage : public IPipelineStage {
+public:
+    RetrievalStage(std::shared_ptr<EmbeddingIndex> index, int thread_num)
+        : index_(std::move(index)), thread_num_(thread_num) {}
+    const char* name() const override { return "retrieve"; }
+    StageKind kind() const override { return STAGE_SOURCE; }
+    size_t generate(const StageRequest& req, int* item_ids, double* retrieval_scores, size_t capacity) override {
+        if (!req.user_embedding || req.embedding_dim != index_->dim()) return 0;
+        auto items = retrieve_topn(*index_, req.user_embedding, capacity, thread_num_);
+        for (size_t i = 0; i < items.size(); ++i) {
+            item_ids[i] = int(items[i].item_id);
+            retrieval_scores[i] = items[i].score;
+        }
+        return items.size();
+    }
+
+private:
+    std::shared_ptr<EmbeddingIndex> index_;
+    int thread_num_;
+};
+
+// 资格过滤：原地压缩候选
+class EligibilityStage : public IPipelineStage {
+public:
+    explicit EligibilityStage(std::shared_ptr<EligibilitySnapshot> snapshot) : snapshot_(std::move(snapshot)) {}
+    const char* name() const override { return "filter"; }
+    StageKind kind() const override { return STAGE_TRANSFORM; }
+    void process(const StageRequest&, StageChunk& chunk) override {
+        size_t kept = 0;
+        for (size_t i = 0; i < chunk.size; ++i) {
+            int id = chunk.item_ids[i];
+            chunk.item_ids[kept] = id;
+            chunk.retrieval_scores[kept] = chunk.retrieval_scores[i];
+            kept += (id >= 0 && snapshot_->eligible.contains(uint32_t(id))) ? 1 : 0;
+        }
+        chunk.size = kept;
+    }
+
+private:
+    std::shared_ptr<EligibilitySnapshot> snapshot_;
+};
+
+// 按投影 gather 特征，并附上召回分列
+class GatherStage : public IPipelineStage {
+public:
+    GatherStage(const ColumnProjection& projection, const ItemCatalog& catalog)
+        : projection_(projection), catalog_(catalog) {}
+    const char* name() const override { return "gather"; }
+    StageKind kind() const override { return STAGE_TRANSFORM; }
+    void process(const StageRequest& req, StageChunk& chunk) override {
+        FeatureBatchBuffer& buf = *static_cast<FeatureBatchBuffer*>(chunk.host);
+        gather_features(projection_, catalog_, UserContext{req.user_id, req.user_feature}, chunk.item_ids,
+                        chunk.size, buf);
+        buf.add_column("retrieval_score").assign(chunk.retrieval_scores, chunk.retrieval_scores + chunk.size);
+        chunk.batch = buf.view();
+    }
+
+private:
+    ColumnProjection projection_;
+    const ItemCatalog& catalog_;
+};
+
+// 调用某个版本的算子打分
+class OperatorStage : public IPipelineStage {
+public:
+    explicit OperatorStage(std::shared_ptr<OperatorHolder> holder) : holder_(std::move(holder)) {}
+    const char* name() const override { return holder_->op->name(); }
+    StageKind kind() const override { return STAGE_TRANSFORM; }
+    void process(const StageRequest&, StageChunk& chunk) override {
+        FeatureBatchBuffer& buf = *static_cast<FeatureBatchBuffer*>(chunk.host);
+        score_feature_batch(*holder_, buf, chunk.scores);
+        chunk.batch = buf.view();
+    }
+
+private:
+    std::shared_ptr<OperatorHolder> holder_;
+};
+
+// 维护请求内的 top-K（ranking 为按分数的小顶堆）
+class TopKStage : public IPipelineStage {
+public:
+    const char* name() const override { return "topk"; }
+    StageKind kind() const override { return STAGE_SINK; }
+    void collect(const StageRequest&, const StageChunk& chunk, StageRanking& ranking) override {
+        auto cmp = [](const StageRankedItem& a, const StageRankedItem& b) { return a.score > b.score; };
+        for (size_t i = 0; i < chunk.size; ++i) {
+            StageRankedItem item{chunk.item_ids[i], chunk.scores[i]};
+            if (ranking.size < ranking.capacity) {
+                ranking.items[ranking.size++] = item;
+                std::push_heap(ranking.items, ranking.items + ranking.size, cmp);
+            } else if (ranking.capacity > 0 && item.score > ranking.items[0].score) {
+                std::pop_heap(ranking.items, ranking.items + ranking.size, cmp);
+                ranking.items[ranking.size - 1] = item;
+                std::push_heap(ranking.items, ranking.items + ranking.size, cmp);
+            }
+        }
+    }
+};
+
+// MMR 多样性重排：sink 保留前 pool 个，按 embedding 余弦相似度与分数挑出 req.k 个，分数保持算子给的值
+class DiversityStage : public IPipelineStage {
+public:
+    DiversityStage(std::shared_ptr<EmbeddingIndex> index, const MMROptions& options)
+        : index_(std::move(index)), options_(options) {}
+    const char* name() const override { return "mmr"; }
+    StageKind kind() const override { return STAGE_RERANK; }
+    size_t rerank_pool(const StageRequest& req) const override { return std::max(req.k, options_.pool); }
+    void rerank(const StageRequest& req, StageRanking& ranking) override {
+        thread_local std::vector<int> ids;
+        thread_local std::vector<double> scores;
+        thread_local std::vector<float> rows;
+        thread_local std::vector<uint32_t> order;
+        thread_local std::vector<StageRankedItem> picked;
+        const size_t n = ranking.size;
+        ids.resize(n);
+        scores.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            ids[i] = ranking.items[i].item_id;
+            scores[i] = ranking.items[i].score;
+        }
+        load_normalized_embeddings(*index_, ids.data(), n, rows);
+        order.resize(n);
+        const size_t k = mmr_select(rows.data(), scores.data(), n, index_->dim(), req.k, options_.lambda, order.data());
+        picked.resize(k);
+        for (size_t i = 0; i < k; ++i) picked[i] = ranking.items[order[i]];
+        std::copy(picked.begin(), picked.end(), ranking.items);
+        ranking.size = k;
+    }
+
+private:
+    std::shared_ptr<EmbeddingIndex> index_;
+    MMROptions options_;
+};
+
+// (阶段名, 阶段) 列表，用于定义或替换 pipeline
+using PipelineStageList = std::vector<std::pair<std::string, std::shared_ptr<StageHolder>>>;
+
+// 一个算子版本对应的 gather + score 两格：投影随算子走，必须一起替换
+inline PipelineStageList make_operator_stages(std::shared_ptr<OperatorHolder> holder, const ItemCatalog& catalog) {
+    return {
+        {"gather", make_builtin_stage(new GatherStage(holder->projection, catalog), "gather:" + holder->so_file)},
+        {"score", make_builtin_stage(new OperatorStage(holder), holder->so_file)},
+    };
+}
+
+// ---- 快照与执行器 ----
+struct PipelineSnapshot {
+    uint64_t version = 0;
+    size_t sink = 0;  // sink 阶段的下标，其后都是 rerank 阶段
+    std::vector<std::string> names;
+    std::vector<std::shared_ptr<StageHolder>> stages;
+};
+
+struct PipelineResult {
+    std::shared_ptr<PipelineSnapshot> snapshot;  // 本次请求使用的快照
+    size_t candidates = 0;                       // source 产出的候选数
+    size_t scored = 0;                           // 流到 sink 的候选数
+    std::vector<StageRankedItem> items;          // 按分数降序；有 rerank 阶段时按重排后的顺序
+    std::vector<double> stage_us;                // 各阶段累计耗时，与快照中的阶段一一对应
+};
+
+class PipelineExecutor {
+public:
+    explicit PipelineExecutor(size_t chunk_size = 256) : chunk_size_(std::max<size_t>(chunk_size, 1)) {}
+
+    // 定义整条链并发布。要求首个阶段为 source，之后是若干 transform、一个 sink、若干 rerank，名字不重复
+    bool configure(const PipelineStageList& stages) {
+        auto next = std::make_shared<PipelineSnapshot>();
+        for (const auto& entry : stages) {
+            next->names.push_back(entry.first);
+            next->stages.push_back(entry.second);
+        }
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        return publish(next);
+    }
+
+    // 按名字替换一个或多个阶段，一次发布；任一名字不存在或校验失败则整体不生效
+    bool swap_stages(const PipelineStageList& updates) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        auto current = std::atomic_load(&snapshot_);
+        if (!current) {
+            std::cerr << "[Pipeline] 尚未 configure" << std::endl;
+            return false;
+        }
+        auto next = std::make_shared<PipelineSnapshot>(*current);
+        for (const auto& entry : updates) {
+            auto it = std::find(next->names.begin(), next->names.end(), entry.first);
+            if (it == next->names.end()) {
+                std::cerr << "[Pipeline] 没有名为 " << entry.first << " 的阶段" << std::endl;
+                return false;
+            }
+            next->stages[size_t(it - next->names.begin())] = entry.second;
+        }
+        return publish(next);
+    }
+
+    bool swap_stage(const std::string& name, std::shared_ptr<StageHolder> holder) {
+        return swap_stages(PipelineStageList{{name, std::move(holder)}});
+    }
+
+    std::shared_ptr<PipelineSnapshot> snapshot() const { return std::atomic_load(&snapshot_); }
+
+    // 执行一次请求；source 至多产出 max_candidates 个候选
+    bool run(const StageRequest& req, size_t max_candidates, PipelineResult* result) const {
+        using Clock = std::chrono::steady_clock;
+        auto snap = std::atomic_load(&snapshot_);
+        if (!snap) return false;
+        const size_t num_stages = snap->stages.size();
+        result->snapshot = snap;
+        result->stage_us.assign(num_stages, 0.0);
+
+        // 每个线程复用自己的中间缓冲
+        thread_local std::vector<int> item_ids;
+        thread_local std::vector<double> retrieval_scores, scores;
+        thread_local FeatureBatchBuffer buffer;
+        item_ids.resize(max_candidates);
+        retrieval_scores.resize(max_candidates);
+        scores.resize(chunk_size_);
+
+        auto start = Clock::now();
+        size_t n = snap->stages[0]->stage->generate(req, item_ids.data(), retrieval_scores.data(), max_candidates);
+        n = std::min(n, max_candidates);
+        result->stage_us[0] += std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+        result->candidates = n;
+        result->scored = 0;
+
+        // 有 rerank 阶段时 sink 多保留一些，给重排留出挑选余地
+        size_t capacity = req.k;
+        for (size_t s = snap->sink + 1; s < num_stages; ++s) {
+            capacity = std::max(capacity, snap->stages[s]->stage->rerank_pool(req));
+        }
+        result->items.resize(capacity);
+        StageRanking ranking{result->items.data(), 0, capacity};
+        for (size_t begin = 0; begin < n; begin += chunk_size_) {
+            StageChunk chunk;
+            chunk.item_ids = item_ids.data() + begin;
+            chunk.retrieval_scores = retrieval_scores.data() + begin;
+            chunk.size = std::min(chunk_size_, n - begin);
+            chunk.batch = FeatureBatch();
+            chunk.scores = scores.data();
+            chunk.host = &buffer;
+            std::fill(scores.begin(), scores.end(), 0.0);
+            for (size_t s = 1; s <= snap->sink && chunk.size > 0; ++s) {
+                start = Clock::now();
+                IPipelineStage* stage = snap->stages[s]->stage;
+                if (s < snap->sink) stage->process(req, chunk);
+                else stage->collect(req, chunk, ranking);
+                result->stage_us[s] += std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+            }
+            result->scored += chunk.size;
+        }
+        std::sort(ranking.items, ranking.items + ranking.size,
+                  [](const StageRankedItem& a, const StageRankedItem& b) { return a.score > b.score; });
+        for (size_t s = snap->sink + 1; s < num_stages; ++s) {
+            start = Clock::now();
+            snap->stages[s]->stage->rerank(req, ranking);
+            ranking.size = std::min(ranking.size, capacity);
+            result->stage_us[s] += std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+        }
+        result->items.resize(std::min(ranking.size, req.k));
+        return true;
+    }
+
+private:
+    // 调用方持有 write_mutex_
+    bool publish(const std::shared_ptr<PipelineSnapshot>& next) {
+        const size_t n = next->stages.size();
+        if (n < 2) {
+            std::cerr << "[Pipeline] 至少需要 source 与 sink 两个阶段" << std::endl;
+            return false;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            if (!next->stages[i] || !next->stages[i]->stage) {
+                std::cerr << "[Pipeline] 阶段 " << next->names[i] << " 为空" << std::endl;
+                return false;
+            }
+        }
+        // sink 是末尾连续 rerank 阶段之前的那一个
+        size_t sink = n - 1;
+        while (sink > 1 && next->stages[sink]->stage->kind() == STAGE_RERANK) --sink;
+        for (size_t i = 0; i < n; ++i) {
+            StageKind expected = i == 0 ? STAGE_SOURCE
+                                        : (i < sink ? STAGE_TRANSFORM : (i == sink ? STAGE_SINK : STAGE_RERANK));
+            if (next->stages[i]->stage->kind() != expected ||
+                std::count(next->names.begin(), next->names.end(), next->names[i]) != 1) {
+                std::cerr << "[Pipeline] 阶段 " << next->names[i] << " 类型或位置不合法" << std::endl;
+                return false;
+            }
+        }
+        next->sink = sink;
+        next->version = next_version_++;
+        std::atomic_store(&snapshot_, next);
+        return true;
+    }
+
+    size_t chunk_size_;
+    std::mutex write_mutex_;
+    uint64_t next_version_ = 1;
+    std::shared_ptr<PipelineSnapshot> snapshot_;
+};
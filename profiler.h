@@ -0,0 +1,386 @@
+// profiler.h
+#pragma once
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <elf.h>
+#include <execinfo.h>
+#include <link.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <time.h>
+#include <ucontext.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "operator_holder.h"
+
+// ---- 采样剖析器 ----
+// so 被 dlclose 后 perf 无法再符号化它的地址，也分不清样本属于哪个版本。
+// 这里在加载时记下每个版本的可执行地址区间，并从 so 文件里读出符号表常驻内存（卸载后仍保留）；
+// SIGPROF 定时采样指令指针和调用栈，报告时按 "地址 + 采样时刻" 归属到具体版本，
+// 输出每个版本的 flat profile 和可直接喂给 flamegraph.pl 的 folded stacks。
+// 原始样本写进定长环形缓冲，后台线程定期把它们符号化、按调用栈聚合后腾出槽位，可以一直开着；
+// 排空赶不上采样速度时新样本计入 dropped_samples()，而不是悄悄丢掉。
+
+inline uint64_t profiler_now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);  // async-signal-safe
+    return uint64_t(ts.tv_sec) * 1000000000ULL + uint64_t(ts.tv_nsec);
+}
+
+// 一个已加载（或已卸载）的算子版本镜像
+struct VersionImage {
+    struct Symbol {
+        uintptr_t start;  // 绝对地址
+        uintptr_t size;
+        std::string name;
+    };
+    std::string label;  // 如 "ScoreOperatorV2#3"
+    std::string so_file;
+    std::vector<std::pair<uintptr_t, uintptr_t>> exec_ranges;  // [begin, end)
+    std::vector<Symbol> symbols;                               // 按 start 升序
+    uint64_t loaded_ns = 0;
+    std::atomic<uint64_t> unloaded_ns{UINT64_MAX};
+
+    bool contains(uintptr_t ip, uint64_t at_ns) const {
+        if (at_ns < loaded_ns || at_ns >= unloaded_ns.load()) return false;
+        for (const auto& r : exec_ranges) {
+            if (ip >= r.first && ip < r.second) return true;
+        }
+        return false;
+    }
+
+    std::string symbolize(uintptr_t ip) const {
+        auto it = std::upper_bound(symbols.begin(), symbols.end(), ip,
+                                   [](uintptr_t addr, const Symbol& s) { return addr < s.start; });
+        if (it != symbols.begin()) {
+            --it;
+            if (ip < it->start + std::max<uintptr_t>(it->size, 1)) return it->name;
+        }
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "+0x%lx", (unsigned long)(ip - (exec_ranges.empty() ? 0 : exec_ranges[0].first)));
+        return buf;
+    }
+};
+
+inline std::string profiler_demangle(const char* name) {
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    std::string result = (status == 0 && demangled) ? demangled : name;
+    std::free(demangled);
+    return result;
+}
+
+// 从 ELF 文件读函数符号（优先 .symtab，被 strip 时退回 .dynsym），地址加上装载基址
+inline std::vector<VersionImage::Symbol> read_elf_function_symbols(const std::string& path, uintptr_t base) {
+    std::vector<VersionImage::Symbol> symbols;
+    std::ifstream in(path, std::ios::binary);
+    std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(Elf64_Ehdr) || std::memcmp(data.data(), ELFMAG, SELFMAG) != 0) return symbols;
+
+    const Elf64_Ehdr* eh = reinterpret_cast<const Elf64_Ehdr*>(data.data());
+    if (eh->e_ident[EI_CLASS] != ELFCLASS64 || eh->e_shoff + uint64_t(eh->e_shnum) * sizeof(Elf64_Shdr) > data.size()) {
+        return symbols;
+    }
+    const Elf64_Shdr* sh = reinterpret_cast<const Elf64_Shdr*>(data.data() + eh->e_shoff);
+    for (uint32_t want : {uint32_t(SHT_SYMTAB), uint32_t(SHT_DYNSYM)}) {
+        for (int i = 0; i < eh->e_shnum; ++i) {
+            if (sh[i].sh_type != want || sh[i].sh_link >= eh->e_shnum) continue;
+            const Elf64_Shdr& strtab = sh[sh[i].sh_link];
+            if (sh[i].sh_offset + sh[i].sh_size > data.size() || strtab.sh_offset + strtab.sh_size > data.size()) continue;
+            const Elf64_Sym* syms = reinterpret_cast<const Elf64_Sym*>(data.data() + sh[i].sh_offset);
+            size_t count = sh[i].sh_size / sizeof(Elf64_Sym);
+            for (size_t j = 0; j < count; ++j) {
+                if (ELF64_ST_TYPE(syms[j].st_info) != STT_FUNC || syms[j].st_value == 0) continue;
+                if (syms[j].st_name >= strtab.sh_size) continue;
+                const char* name = data.data() + strtab.sh_offset + syms[j].st_name;
+                symbols.push_back(VersionImage::Symbol{base + syms[j].st_value, syms[j].st_size, profiler_demangle(name)});
+            }
+        }
+        if (!symbols.empty()) break;
+    }
+    std::sort(symbols.begin(), symbols.end(),
+              [](const VersionImage::Symbol& a, const VersionImage::Symbol& b) { return a.start < b.start; });
+    return symbols;
+}
+
+class SamplingProfiler {
+public:
+    static constexpr int kMaxDepth = 32;
+    static constexpr size_t kMaxSamples = 1 << 16;  // 环形缓冲槽位数（2 的幂），槽位未排空时新样本计入丢弃
+    static constexpr int kDrainIntervalMs = 100;
+
+    static SamplingProfiler& instance() {
+        static SamplingProfiler profiler;
+        return profiler;
+    }
+
+    // 加载后（发布前）调用：记录地址区间和符号表，并在 holder 析构时标记卸载时刻
+    void register_operator(OperatorHolder& holder) {
+        if (!holder.handle || !holder.op) return;
+        auto image = std::make_shared<VersionImage>();
+        image->label = std::string(holder.op->name()) + "#" + std::to_string(holder.generation);
+        image->so_file = holder.so_file;
+        image->loaded_ns = profiler_now_ns();
+
+        link_map* lm = nullptr;
+        if (dlinfo(holder.handle, RTLD_DI_LINKMAP, &lm) != 0 || !lm) return;
+        struct Ctx {
+            link_map* lm;
+            VersionImage* image;
+        } ctx{lm, image.get()};
+        dl_iterate_phdr([](dl_phdr_info* info, size_t, void* arg) -> int {
+            Ctx* c = static_cast<Ctx*>(arg);
+            if (info->dlpi_addr != c->lm->l_addr || std::strcmp(info->dlpi_name, c->lm->l_name) != 0) return 0;
+            for (int i = 0; i < info->dlpi_phnum; ++i) {
+                const ElfW(Phdr)& ph = info->dlpi_phdr[i];
+                if (ph.p_type == PT_LOAD && (ph.p_flags & PF_X)) {
+                    uintptr_t begin = info->dlpi_addr + ph.p_vaddr;
+                    c->image->exec_ranges.emplace_back(begin, begin + ph.p_memsz);
+                }
+            }
+            return 1;
+        }, &ctx);
+        image->symbols = read_elf_function_symbols(lm->l_name, lm->l_addr);
+
+        std::weak_ptr<VersionImage> weak = image;
+        holder.unload_hooks.push_back([weak] {
+            if (auto img = weak.lock()) img->unloaded_ns = profiler_now_ns();
+        });
+        std::lock_guard<std::mutex> lock(images_mutex_);
+        images_.push_back(image);
+    }
+
+    // 每秒 hz 次（按进程 CPU 时间计），同一进程只能有一个 ITIMER_PROF
+    bool start(int hz = 997) {
+        void* warmup[1];
+        backtrace(warmup, 1);  // 预先加载 libgcc 的 unwinder，避免在信号处理函数里首次 dlopen
+
+        struct sigaction sa;
+        std::memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = &SamplingProfiler::on_signal;
+        sa.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        if (sigaction(SIGPROF, &sa, nullptr) != 0) return false;
+
+        {
+            std::lock_guard<std::mutex> lock(drain_mutex_);
+            stopping_ = false;
+        }
+        if (!drainer_.joinable()) drainer_ = std::thread([this] { drain_loop(); });
+
+        itimerval timer;
+        timer.it_interval.tv_sec = 0;
+        timer.it_interval.tv_usec = 1000000 / std::max(1, hz);
+        timer.it_value = timer.it_interval;
+        return setitimer(ITIMER_PROF, &timer, nullptr) == 0;
+    }
+
+    void stop() {
+        itimerval timer;
+        std::memset(&timer, 0, sizeof(timer));
+        setitimer(ITIMER_PROF, &timer, nullptr);
+        signal(SIGPROF, SIG_IGN);
+        stop_drainer();
+        drain();
+    }
+
+    // 已聚合的样本数（不含仍在环形缓冲里的）
+    size_t sample_count() const {
+        std::lock_guard<std::mutex> lock(stacks_mutex_);
+        return aggregated_;
+    }
+
+    // 槽位还没被排空、只能丢掉的样本数
+    uint64_t dropped_samples() const { return dropped_.load(std::memory_order_relaxed); }
+
+    // 把环形缓冲里写完的样本符号化并按调用栈聚合，腾出槽位；报告前会自动调用
+    void drain() {
+        std::vector<std::shared_ptr<VersionImage>> images;
+        {
+            std::lock_guard<std::mutex> lock(images_mutex_);
+            images = images_;
+        }
+        std::lock_guard<std::mutex> lock(stacks_mutex_);
+        std::vector<Frame> frames;
+        for (size_t i = 0; i < kMaxSamples; ++i) {
+            RawSample& s = samples_[i];
+            if (s.state.load(std::memory_order_acquire) != kReady) continue;
+            frames.clear();
+            for (int d = 0; d < s.depth; ++d) frames.push_back(resolve_frame(images, s.ips[d], s.at_ns));
+            s.state.store(kFree, std::memory_order_release);
+            stacks_[frames]++;
+            aggregated_++;
+        }
+    }
+
+    // 每个版本的 flat profile：inclusive 为栈上任一帧落在该版本内的样本数，self 按叶子函数统计
+    void print_flat_profile(std::ostream& out, size_t top_n = 5) {
+        std::map<std::string, size_t> inclusive;
+        std::map<std::string, std::map<std::string, size_t>> self;
+        size_t total = for_each_stack([&](const std::vector<Frame>& frames, size_t count) {
+            std::string owner;
+            for (const Frame& f : frames) {
+                if (f.image) { owner = f.image->label; break; }
+            }
+            if (owner.empty()) owner = "[host]";
+            inclusive[owner] += count;
+            self[owner][frames.empty() ? "?" : frames[0].name] += count;
+        });
+
+        out << "========== 采样剖析 (共 " << total << " 个样本";
+        if (dropped_samples()) out << "，丢弃 " << dropped_samples() << " 个";
+        out << ") ==========\n";
+        for (const auto& kv : inclusive) {
+            out << std::setw(22) << std::left << kv.first << std::right << " " << std::setw(6) << kv.second
+                << " (" << std::fixed << std::setprecision(1) << (total ? 100.0 * kv.second / total : 0) << "%)\n";
+            std::vector<std::pair<size_t, std::string>> ranked;
+            for (const auto& s : self[kv.first]) ranked.emplace_back(s.second, s.first);
+            std::sort(ranked.rbegin(), ranked.rend());
+            for (size_t i = 0; i < ranked.size() && i < top_n; ++i) {
+                out << "    " << std::setw(6) << ranked[i].first << "  " << ranked[i].second << "\n";
+            }
+        }
+        out << "==============================================\n";
+    }
+
+    // folded stacks：根 -> 叶，以 ';' 分隔，后跟样本数；算子帧带版本前缀
+    void write_folded(std::ostream& out) {
+        std::map<std::string, size_t> stacks;
+        for_each_stack([&](const std::vector<Frame>& frames, size_t count) {
+            std::string line;
+            for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+                if (!line.empty()) line += ';';
+                line += it->image ? it->image->label + "`" + it->name : it->name;
+            }
+            stacks[line] += count;
+        });
+        for (const auto& kv : stacks) out << kv.first << " " << kv.second << "\n";
+    }
+
+private:
+    // 槽位状态：信号处理函数 kFree -> kWriting -> kReady，drain 读完后置回 kFree
+    enum : uint32_t { kFree = 0, kWriting = 1, kReady = 2 };
+
+    struct RawSample {
+        std::atomic<uint32_t> state{kFree};
+        uint64_t at_ns;
+        int depth;
+        void* ips[kMaxDepth];
+    };
+
+    struct Frame {
+        const VersionImage* image;  // nullptr 表示宿主进程；镜像卸载后仍保留在 images_ 里，指针一直有效
+        std::string name;
+        bool operator<(const Frame& o) const { return image != o.image ? image < o.image : name < o.name; }
+    };
+
+    SamplingProfiler() : samples_(new RawSample[kMaxSamples]) {}
+    ~SamplingProfiler() { stop_drainer(); }
+
+    void stop_drainer() {
+        {
+            std::lock_guard<std::mutex> lock(drain_mutex_);
+            stopping_ = true;
+        }
+        drain_cv_.notify_one();
+        if (drainer_.joinable()) drainer_.join();
+    }
+
+    static void on_signal(int, siginfo_t*, void* ucontext) {
+        SamplingProfiler& self = instance();
+        size_t idx = self.next_.fetch_add(1, std::memory_order_relaxed);
+        RawSample& s = self.samples_[idx & (kMaxSamples - 1)];
+        uint32_t expected = kFree;
+        if (!s.state.compare_exchange_strong(expected, kWriting, std::memory_order_acquire)) {
+            self.dropped_.fetch_add(1, std::memory_order_relaxed);  // 绕了一圈还没被排空
+            return;
+        }
+        s.at_ns = profiler_now_ns();
+        // 叶子帧取被打断处的 RIP，其余由 unwinder 回溯（跳过信号处理函数自身的帧）
+        void* ips[kMaxDepth + 3];
+        int n = backtrace(ips, kMaxDepth + 3);
+        int skip = std::min(n, 2);
+        s.ips[0] = reinterpret_cast<void*>(static_cast<ucontext_t*>(ucontext)->uc_mcontext.gregs[REG_RIP]);
+        s.depth = 1;
+        for (int i = skip; i < n && s.depth < kMaxDepth; ++i) {
+            if (ips[i] != s.ips[0]) s.ips[s.depth++] = ips[i];
+        }
+        s.state.store(kReady, std::memory_order_release);
+    }
+
+    void drain_loop() {
+        std::unique_lock<std::mutex> lock(drain_mutex_);
+        while (!stopping_) {
+            drain_cv_.wait_for(lock, std::chrono::milliseconds(kDrainIntervalMs), [this] { return stopping_; });
+            lock.unlock();
+            drain();
+            lock.lock();
+        }
+    }
+
+    // 先排空环形缓冲，再按聚合后的调用栈回调 fn(frames, count)，返回样本总数
+    template <typename Fn>
+    size_t for_each_stack(Fn fn) {
+        drain();
+        std::lock_guard<std::mutex> lock(stacks_mutex_);
+        for (const auto& kv : stacks_) fn(kv.first, kv.second);
+        return aggregated_;
+    }
+
+    // 地址 + 采样时刻归属到版本镜像，否则按宿主进程符号化
+    Frame resolve_frame(const std::vector<std::shared_ptr<VersionImage>>& images, void* addr, uint64_t at_ns) {
+        uintptr_t ip = reinterpret_cast<uintptr_t>(addr);
+        for (const auto& img : images) {
+            if (img->contains(ip, at_ns)) return Frame{img.get(), img->symbolize(ip)};
+        }
+        auto cached = host_names_.find(addr);  // 宿主地址符号缓存
+        if (cached == host_names_.end()) {
+            Dl_info info;
+            std::string name;
+            if (dladdr(addr, &info) && info.dli_sname) name = profiler_demangle(info.dli_sname);
+            else if (dladdr(addr, &info) && info.dli_fname) name = std::string("[") + basename_of(info.dli_fname) + "]";
+            else name = "[unknown]";
+            cached = host_names_.emplace(addr, name).first;
+        }
+        return Frame{nullptr, cached->second};
+    }
+
+    static const char* basename_of(const char* path) {
+        const char* slash = std::strrchr(path, '/');
+        return slash ? slash + 1 : path;
+    }
+
+    std::unique_ptr<RawSample[]> samples_;
+    std::atomic<size_t> next_{0};
+    std::atomic<uint64_t> dropped_{0};
+
+    mutable std::mutex stacks_mutex_;  // 保护以下聚合结果
+    std::map<std::vector<Frame>, size_t> stacks_;
+    std::map<void*, std::string> host_names_;
+    size_t aggregated_ = 0;
+
+    std::mutex drain_mutex_;
+    std::condition_variable drain_cv_;
+    bool stopping_ = false;
+    std::thread drainer_;
+    mutable std::mutex images_mutex_;
+    std::vector<std::shared_ptr<VersionImage>> images_;  // 卸载后仍保留，用于事后符号化
+};
@@ -0,0 +1,344 @@
+// retrieval.h
+#pragma once
+
+#include <fcntl.h>
+#include <immintrin.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gather.h"
+#include "simd_util.h"
+
+// ---- 暴力检索阶段 ----
+// 物品 embedding 矩阵以文件形式离线生成，加载时 mmap（MAP_POPULATE 预先缺页，发布后不抖动），
+// 像 OperatorHolder 一样用 shared_ptr + atomic_store 热替换。查询时把全量物品按线程切分，
+// 每个线程用分块 SIMD 内核（一次算 4 行，复用寄存器里的用户向量）求内积并维护局部 top-N，最后归并。
+//
+// 文件格式（小端）：
+//   EmbeddingFileHeader (64 字节)
+//   int8 时：count 个 float 行缩放系数，填充到 64 字节对齐
+//   数据：count x dim，float32 或 int8，按行连续
+
+enum class EmbeddingType : uint32_t { Float32 = 0, Int8 = 1 };
+
+struct EmbeddingFileHeader {
+    char magic[8];  // "HPEMB01\0"
+    uint32_t type;
+    uint32_t dim;
+    uint64_t count;
+    uint64_t data_offset;
+    uint8_t reserved[32];
+};
+static_assert(sizeof(EmbeddingFileHeader) == 64, "header must stay 64 bytes");
+
+struct RetrievedItem {
+    int item_id;
+    float score;
+};
+
+class EmbeddingIndex {
+public:
+    ~EmbeddingIndex() {
+        if (base_) munmap(base_, size_);
+    }
+
+    static std::shared_ptr<EmbeddingIndex> open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "[Retrieval] 无法打开: " << path << std::endl;
+            return nullptr;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            std::cerr << "[Retrieval] fstat 失败: " << path << std::endl;
+            ::close(fd);
+            return nullptr;
+        }
+        std::shared_ptr<EmbeddingIndex> index(new EmbeddingIndex());
+        index->size_ = size_t(st.st_size);
+        void* base = index->size_ >= sizeof(EmbeddingFileHeader)
+                         ? mmap(nullptr, index->size_, PROT_READ, MAP_SHARED | MAP_POPULATE, fd, 0)
+                         : MAP_FAILED;
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            std::cerr << "[Retrieval] mmap 失败: " << path << std::endl;
+            return nullptr;
+        }
+        index->base_ = base;
+        index->path_ = path;
+
+        const EmbeddingFileHeader* h = static_cast<const EmbeddingFileHeader*>(base);
+        // 各段边界用除法检查，头部字段再大也不会溢出：数据段在 [data_offset, size) 内，
+        // int8 的每行 scale 在头部之后、data_offset 之前
+        const uint64_t elem = h->type == uint32_t(EmbeddingType::Int8) ? 1 : 4;
+        const uint64_t header_bytes = sizeof(EmbeddingFileHeader);
+        bool valid = std::memcmp(h->magic, "HPEMB01", 8) == 0 && h->dim != 0 && h->type <= 1 &&
+                     h->data_offset >= header_bytes && h->data_offset <= index->size_ &&
+                     h->count <= (index->size_ - h->data_offset) / (h->dim * elem);
+        if (valid && h->type == uint32_t(EmbeddingType::Int8)) {
+            valid = h->count <= (h->data_offset - header_bytes) / sizeof(float);
+        }
+        if (!valid) {
+            std::cerr << "[Retrieval] 文件格式错误: " << path << std::endl;
+            return nullptr;
+        }
+        index->type_ = EmbeddingType(h->type);
+        index->dim_ = h->dim;
+        index->count_ = h->count;
+        const char* bytes = static_cast<const char*>(base);
+        index->data_ = bytes + h->data_offset;
+        if (index->type_ == EmbeddingType::Int8) {
+            index->scales_ = reinterpret_cast<const float*>(bytes + sizeof(EmbeddingFileHeader));
+        }
+        return index;
+    }
+
+    EmbeddingType type() const { return type_; }
+    uint32_t dim() const { return dim_; }
+    size_t count() const { return count_; }
+    const std::string& path() const { return path_; }
+    const float* f32_rows() const { return static_cast<const float*>(data_); }
+    const int8_t* i8_rows() const { return static_cast<const int8_t*>(data_); }
+    const float* scales() const { return scales_; }
+
+private:
+    EmbeddingIndex() = default;
+
+    void* base_ = nullptr;
+    size_t size_ = 0;
+    std::string path_;
+    EmbeddingType type_ = EmbeddingType::Float32;
+    uint32_t dim_ = 0;
+    size_t count_ = 0;
+    const void* data_ = nullptr;
+    const float* scales_ = nullptr;
+};
+
+// 离线生成 embedding 文件；int8 时按行对称量化（scale = max|x| / 127）
+inline bool write_embedding_file(const std::string& path, EmbeddingType type, uint32_t dim,
+                                 const float* rows, size_t count) {
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) return false;
+    EmbeddingFileHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, "HPEMB01", 8);
+    h.type = uint32_t(type);
+    h.dim = dim;
+    h.count = count;
+    h.data_offset = sizeof(h);
+    if (type == EmbeddingType::Int8) h.data_offset = (sizeof(h) + count * sizeof(float) + 63) / 64 * 64;
+    bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1;
+
+    if (type == EmbeddingType::Float32) {
+        ok = ok && std::fwrite(rows, sizeof(float) * dim, count, f) == count;
+    } else {
+        std::vector<float> scales(count);
+        std::vector<int8_t> quantized(size_t(count) * dim);
+        for (size_t i = 0; i < count; ++i) {
+            float max_abs = 0;
+            for (uint32_t d = 0; d < dim; ++d) max_abs = std::max(max_abs, std::fabs(rows[i * dim + d]));
+            scales[i] = max_abs > 0 ? max_abs / 127.0f : 1.0f;
+            for (uint32_t d = 0; d < dim; ++d) {
+                quantized[i * dim + d] = int8_t(std::lround(rows[i * dim + d] / scales[i]));
+            }
+        }
+        std::vector<char> pad(h.data_offset - sizeof(h) - count * sizeof(float), 0);
+        ok = ok && std::fwrite(scales.data(), sizeof(float), count, f) == count;
+        ok = ok && std::fwrite(pad.data(), 1, pad.size(), f) == pad.size();
+        ok = ok && std::fwrite(quantized.data(), 1, quantized.size(), f) == quantized.size();
+    }
+    return std::fclose(f) == 0 && ok;
+}
+
+// ---- 内积内核：一次处理 4 行 ----
+namespace retrieval_kernels {
+
+inline void dot4_f32_scalar(const float* rows, uint32_t dim, const float* u, float* out) {
+    for (int r = 0; r < 4; ++r) {
+        float acc = 0;
+        for (uint32_t d = 0; d < dim; ++d) acc += rows[r * size_t(dim) + d] * u[d];
+        out[r] = acc;
+    }
+}
+
+__attribute__((target("avx2,fma")))
+inline float hsum256(__m256 v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_hadd_ps(s, s);
+    s = _mm_hadd_ps(s, s);
+    return _mm_cvtss_f32(s);
+}
+
+__attribute__((target("avx2,fma")))
+inline void dot4_f32_avx2(const float* rows, uint32_t dim, const float* u, float* out) {
+    const float* r0 = rows;
+    const float* r1 = rows + dim;
+    const float* r2 = rows + 2 * size_t(dim);
+    const float* r3 = rows + 3 * size_t(dim);
+    __m256 a0 = _mm256_setzero_ps(), a1 = _mm256_setzero_ps(), a2 = _mm256_setzero_ps(), a3 = _mm256_setzero_ps();
+    uint32_t d = 0;
+    for (; d + 8 <= dim; d += 8) {
+        __m256 vu = _mm256_loadu_ps(u + d);
+        a0 = _mm256_fmadd_ps(_mm256_loadu_ps(r0 + d), vu, a0);
+        a1 = _mm256_fmadd_ps(_mm256_loadu_ps(r1 + d), vu, a1);
+        a2 = _mm256_fmadd_ps(_mm256_loadu_ps(r2 + d), vu, a2);
+        a3 = _mm256_fmadd_ps(_mm256_loadu_ps(r3 + d), vu, a3);
+    }
+    out[0] = hsum256(a0);
+    out[1] = hsum256(a1);
+    out[2] = hsum256(a2);
+    out[3] = hsum256(a3);
+    for (; d < dim; ++d) {
+        out[0] += r0[d] * u[d];
+        out[1] += r1[d] * u[d];
+        out[2] += r2[d] * u[d];
+        out[3] += r3[d] * u[d];
+    }
+}
+
+__attribute__((target("avx512f")))
+inline void dot4_f32_avx512(const float* rows, uint32_t dim, const float* u, float* out) {
+    const float* r[4] = {rows, rows + dim, rows + 2 * size_t(dim), rows + 3 * size_t(dim)};
+    __m512 a0 = _mm512_setzero_ps(), a1 = _mm512_setzero_ps(), a2 = _mm512_setzero_ps(), a3 = _mm512_setzero_ps();
+    uint32_t d = 0;
+    for (; d + 16 <= dim; d += 16) {
+        __m512 vu = _mm512_loadu_ps(u + d);
+        a0 = _mm512_fmadd_ps(_mm512_loadu_ps(r[0] + d), vu, a0);
+        a1 = _mm512_fmadd_ps(_mm512_loadu_ps(r[1] + d), vu, a1);
+        a2 = _mm512_fmadd_ps(_mm512_loadu_ps(r[2] + d), vu, a2);
+        a3 = _mm512_fmadd_ps(_mm512_loadu_ps(r[3] + d), vu, a3);
+    }
+    if (d < dim) {  // 尾部用掩码加载
+        __mmask16 m = __mmask16((1u << (dim - d)) - 1);
+        __m512 vu = _mm512_maskz_loadu_ps(m, u + d);
+        a0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, r[0] + d), vu, a0);
+        a1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, r[1] + d), vu, a1);
+        a2 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, r[2] + d), vu, a2);
+        a3 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, r[3] + d), vu, a3);
+    }
+    out[0] = _mm512_reduce_add_ps(a0);
+    out[1] = _mm512_reduce_add_ps(a1);
+    out[2] = _mm512_reduce_add_ps(a2);
+    out[3] = _mm512_reduce_add_ps(a3);
+}
+
+inline void dot4_i8_scalar(const int8_t* rows, const float* scales, uint32_t dim, const float* u, float* out) {
+    for (int r = 0; r < 4; ++r) {
+        float acc = 0;
+        for (uint32_t d = 0; d < dim; ++d) acc += float(rows[r * size_t(dim) + d]) * u[d];
+        out[r] = acc * scales[r];
+    }
+}
+
+// int8 行在寄存器里扩展成 float 后做 FMA，内存带宽只有 float32 的 1/4
+__attribute__((target("avx2,fma")))
+inline void dot4_i8_avx2(const int8_t* rows, const float* scales, uint32_t dim, const float* u, float* out) {
+    __m256 acc[4] = {_mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps()};
+    uint32_t d = 0;
+    for (; d + 8 <= dim; d += 8) {
+        __m256 vu = _mm256_loadu_ps(u + d);
+        for (int r = 0; r < 4; ++r) {
+            __m128i q = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(rows + r * size_t(dim) + d));
+            acc[r] = _mm256_fmadd_ps(_mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(q)), vu, acc[r]);
+        }
+    }
+    for (int r = 0; r < 4; ++r) {
+        float s = hsum256(acc[r]);
+        for (uint32_t k = d; k < dim; ++k) s += float(rows[r * size_t(dim) + k]) * u[k];
+        out[r] = s * scales[r];
+    }
+}
+
+}  // namespace retrieval_kernels
+
+// ---- 全量检索 top-N ----
+inline std::vector<RetrievedItem> retrieve_topn(const EmbeddingIndex& index, const float* user_vec,
+                                                size_t topn, int thread_num) {
+    using namespace retrieval_kernels;
+    const size_t count = index.count();
+    const uint32_t dim = index.dim();
+    topn = std::min(topn, count);
+    if (topn == 0) return {};
+    thread_num = std::max(1, std::min<int>(thread_num, int((count + 4095) / 4096)));
+
+    const bool avx512 = cpu_has_avx512();
+    const bool avx2 = cpu_has_avx2();
+    auto cmp = [](const RetrievedItem& a, const RetrievedItem& b) { return a.score > b.score; };  // 小顶堆
+
+    std::vector<std::vector<RetrievedItem>> partial(thread_num);
+    auto worker = [&](int t) {
+        size_t chunk = (count + thread_num - 1) / thread_num;
+        size_t begin = t * chunk, end = std::min(count, begin + chunk);
+        std::vector<RetrievedItem>& heap = partial[t];
+        heap.reserve(topn + 1);
+        auto offer = [&](size_t item, float score) {
+            if (heap.size() < topn) {
+                heap.push_back(RetrievedItem{int(item), score});
+                std::push_heap(heap.begin(), heap.end(), cmp);
+            } else if (score > heap.front().score) {
+                std::pop_heap(heap.begin(), heap.end(), cmp);
+                heap.back() = RetrievedItem{int(item), score};
+                std::push_heap(heap.begin(), heap.end(), cmp);
+            }
+        };
+
+        float out[4];
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            if (index.type() == EmbeddingType::Float32) {
+                const float* rows = index.f32_rows() + i * dim;
+                if (avx512) dot4_f32_avx512(rows, dim, user_vec, out);
+                else if (avx2) dot4_f32_avx2(rows, dim, user_vec, out);
+                else dot4_f32_scalar(rows, dim, user_vec, out);
+            } else {
+                const int8_t* rows = index.i8_rows() + i * dim;
+                if (avx2) dot4_i8_avx2(rows, index.scales() + i, dim, user_vec, out);
+                else dot4_i8_scalar(rows, index.scales() + i, dim, user_vec, out);
+            }
+            for (int r = 0; r < 4; ++r) offer(i + r, out[r]);
+        }
+        for (; i < end; ++i) {  // 不足 4 行的尾巴
+            float acc = 0;
+            for (uint32_t d = 0; d < dim; ++d) {
+                float x = index.type() == EmbeddingType::Float32 ? index.f32_rows()[i * dim + d]
+                                                                 : float(index.i8_rows()[i * dim + d]) * index.scales()[i];
+                acc += x * user_vec[d];
+            }
+            offer(i, acc);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 1; t < thread_num; ++t) threads.emplace_back(worker, t);
+    worker(0);
+    for (auto& th : threads) th.join();
+
+    std::vector<RetrievedItem> merged;
+    for (auto& p : partial) merged.insert(merged.end(), p.begin(), p.end());
+    std::partial_sort(merged.begin(), merged.begin() + topn, merged.end(),
+                      [](const RetrievedItem& a, const RetrievedItem& b) { return a.score > b.score; });
+    merged.resize(topn);
+    return merged;
+}
+
+// 检索结果直接按算子的列投影组装成 FeatureBatch，检索分数作为派生列 retrieval_score
+inline void retrieval_to_batch(const std::vector<RetrievedItem>& items, const ColumnProjection& projection,
+                               const ItemCatalog& catalog, const UserContext& user, FeatureBatchBuffer& buf) {
+    std::vector<int> item_ids(items.size());
+    for (size_t i = 0; i < items.size(); ++i) item_ids[i] = items[i].item_id;
+    gather_features(projection, catalog, user, item_ids.data(), item_ids.size(), buf);
+    std::vector<double>& scores = buf.add_column("retrieval_score");
+    for (size_t i = 0; i < items.size(); ++i) scores[i] = items[i].score;
+}
@@ -0,0 +1,174 @@
+// score_cache.h
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "operator_interface.h"
+
+// ---- 打分缓存 ----
+// key 中带上算子代际(generation)，热更新后老版本的分数天然失效，
+// 不会被新版本读到；被换下的代际由 retire 清理。代际来自全局计数，
+// 各租户槽位的代际交错，代际小不代表已下线，所以不能按新旧清理。
+class ScoreCache {
+public:
+    explicit ScoreCache(size_t capacity_per_shard = 4096)
+        : capacity_per_shard_(capacity_per_shard) {}
+
+    bool lookup(uint64_t generation, int user_id, int item_id, double* score) {
+        Shard& shard = shard_of(user_id, item_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(Key{generation, user_id, item_id});
+        if (it == shard.entries.end()) return false;
+        *score = it->second;
+        return true;
+    }
+
+    void insert(uint64_t generation, int user_id, int item_id, double score) {
+        Shard& shard = shard_of(user_id, item_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.entries.size() >= capacity_per_shard_) {
+            // 整片清空（简单粗暴，但不会无限增长）；下线的代际已由 retire 清掉，剩下的都可能仍在服务
+            shard.entries.clear();
+        }
+        shard.entries[Key{generation, user_id, item_id}] = score;
+    }
+
+    // 新版本发布并度过宽限期后调用，只清理被换下的那一个代际
+    void retire(uint64_t generation) {
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (auto it = shard.entries.begin(); it != shard.entries.end();) {
+                if (it->first.generation == generation) it = shard.entries.erase(it);
+                else ++it;
+            }
+        }
+    }
+
+    size_t size() {
+        size_t total = 0;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            total += shard.entries.size();
+        }
+        return total;
+    }
+
+private:
+    struct Key {
+        uint64_t generation;
+        int user_id;
+        int item_id;
+        bool operator==(const Key& o) const {
+            return generation == o.generation && user_id == o.user_id && item_id == o.item_id;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& k) const {
+            uint64_t h = k.generation * 0x9E3779B97F4A7C15ULL;
+            h ^= (uint64_t(uint32_t(k.user_id)) << 32 | uint32_t(k.item_id)) + (h << 6) + (h >> 2);
+            return size_t(h);
+        }
+    };
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<Key, double, KeyHash> entries;
+    };
+
+    static constexpr size_t kShardNum = 16;
+
+    Shard& shard_of(int user_id, int item_id) {
+        return shards_[(uint32_t(user_id) * 31u + uint32_t(item_id)) % kShardNum];
+    }
+
+    size_t capacity_per_shard_;
+    Shard shards_[kShardNum];
+};
+
+// ---- 近期流量采样 ----
+// 每 sample_every 个请求采一个写入环形缓冲，供热更新前挑出最热的 (user_id, item_id)。
+// 采样率保证了锁竞争可以忽略。
+class TrafficSampler {
+public:
+    explicit TrafficSampler(size_t capacity = 8192, uint32_t sample_every = 4)
+        : ring_(capacity), sample_every_(sample_every ? sample_every : 1) {}
+
+    void record(const Feature& feature) {
+        if (counter_.fetch_add(1, std::memory_order_relaxed) % sample_every_ != 0) return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        ring_[next_ % ring_.size()] = feature;
+        next_++;
+    }
+
+    // 按出现次数降序返回最多 n 个不同的 (user_id, item_id)，每个取最近一次的特征
+    std::vector<Feature> hottest(size_t n) {
+        std::vector<Feature> samples;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            size_t count = std::min<uint64_t>(next_, ring_.size());
+            samples.reserve(count);
+            for (size_t i = 0; i < count; ++i) {
+                samples.push_back(ring_[(next_ - 1 - i) % ring_.size()]);  // 新 -> 旧
+            }
+        }
+
+        std::unordered_map<uint64_t, std::pair<size_t, size_t>> freq;  // key -> (次数, 最新样本下标)
+        for (size_t i = 0; i < samples.size(); ++i) {
+            uint64_t key = uint64_t(uint32_t(samples[i].user_id)) << 32 | uint32_t(samples[i].item_id);
+            auto it = freq.find(key);
+            if (it == freq.end()) freq.emplace(key, std::make_pair(size_t(1), i));
+            else it->second.first++;
+        }
+
+        std::vector<std::pair<size_t, size_t>> ranked;
+        ranked.reserve(freq.size());
+        for (auto& kv : freq) ranked.push_back(kv.second);
+        n = std::min(n, ranked.size());
+        std::partial_sort(ranked.begin(), ranked.begin() + n, ranked.end(),
+                          [](const std::pair<size_t, size_t>& a, const std::pair<size_t, size_t>& b) {
+                              return a.first > b.first;
+                          });
+
+        std::vector<Feature> result;
+        result.reserve(n);
+        for (size_t i = 0; i < n; ++i) result.push_back(samples[ranked[i].second]);
+        return result;
+    }
+
+private:
+    std::vector<Feature> ring_;
+    uint64_t next_ = 0;
+    std::mutex mutex_;
+    std::atomic<uint64_t> counter_{0};
+    uint32_t sample_every_;
+};
+
+// ---- 发布前缓存预热 ----
+// 在 load_operator 之后、atomic_store 之前，用新版本算子在后台线程上并行给最热的样本打分，
+// 以新代际写入缓存，避免切换瞬间缓存全冷导致的 miss 风暴。返回写入条数。
+inline size_t prime_score_cache(IScoreOperator* op, uint64_t generation,
+                                const std::vector<Feature>& hot_features,
+                                ScoreCache& cache, int thread_num) {
+    if (!op || hot_features.empty()) return 0;
+    thread_num = std::max(1, std::min<int>(thread_num, int(hot_features.size())));
+
+    std::atomic<size_t> primed{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < thread_num; ++t) {
+        workers.emplace_back([&, t] {
+            for (size_t i = t; i < hot_features.size(); i += thread_num) {
+                const Feature& f = hot_features[i];
+                cache.insert(generation, f.user_id, f.item_id, op->compute_score(f));
+                primed++;
+            }
+        });
+    }
+    for (auto& th : workers) th.join();
+    return primed.load();
+}
@@ -1,21 +1,24 @@
 // score_op_v1.cpp
-#include "operator_interface.h"
-#include <iostream>
-#include <cmath>
+#include "operator_sdk.h"
 
-struct ScoreOperatorV1 : IScoreOperator {
-    double compute_score(const Feature& feature) override {
+// 内核只写一次，标量 / AVX2 / AVX-512 及 float32 入口由 SDK 生成
+struct ScoreOperatorV1 : hotplug_sdk::Operator<ScoreOperatorV1> {
+    template <class V>
+    HOTPLUG_KERNEL static V score(const hotplug_sdk::Row<V>& r) {
         // V1算法：简单线性组合
-        return feature.user_feature * 0.7 + feature.item_feature * 0.3;
+        return r.user_feature * 0.7 + r.item_feature * 0.3;
     }
     const char* name() const override {
         return "ScoreOperatorV1";
     }
+    // 只读这几个基础列，不需要任何目录宽特征
+    uint32_t required_base_columns() const override {
+        return COL_USER_FEATURE | COL_ITEM_FEATURE;
+    }
+    const char* const* required_catalog_columns() const override {
+        static const char* const none[] = {nullptr};
+        return none;
+    }
 };
 
-extern "C" IScoreOperator* create_operator() {
-    return new ScoreOperatorV1();
-}
-extern "C" void destroy_operator(IScoreOperator* op) {
-    delete op;
-}
+HOTPLUG_EXPORT_OPERATOR(ScoreOperatorV1)
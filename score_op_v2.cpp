@@ -12,8 +12,46 @@ struct ScoreOperatorV2 : IScoreOperator {
     const char* name() const override {
         return "ScoreOperatorV2";
     }
+    // 只读这几个基础列，不需要任何目录宽特征
+    uint32_t required_base_columns() const override {
+        return COL_USER_ID | COL_USER_FEATURE | COL_ITEM_FEATURE;
+    }
+    const char* const* required_catalog_columns() const override {
+        static const char* const none[] = {nullptr};
+        return none;
+    }
+
+    // 物品侧子表达式 item_feature * 0.6 与用户无关，交给 host 在加载期预计算
+    int item_precompute_width() const override { return 1; }
+    void precompute_item(int, double item_feature, double* out) override {
+        out[0] = item_feature * 0.6;
+    }
+    void compute_score_soa(const FeatureBatch& batch, double* scores) override {
+        const double* pre = batch.item_precompute_width == 1 ? batch.item_precomputed : nullptr;
+        for (size_t i = 0; i < batch.size; ++i) {
+            double item_term = pre ? pre[i] : batch.item_feature[i] * 0.6;
+            double base_score = batch.user_feature[i] * 0.4 + item_term;
+            scores[i] = base_score * (1.0 + 0.1 * sin(batch.user_id[i] * 0.1)) + 2.0;
+        }
+    }
+
+    // 阶段0：只算线性部分，调制系数 1+0.1*sin(...) 落在 [0.9, 1.1]，据此给出上界
+    // 阶段1：补上 sin 调制，得到与 compute_score 完全一致的分数
+    int num_stages() const override { return 2; }
+    double evaluate_stage(const Feature& feature, int stage, double state, double* upper_bound) override {
+        if (stage == 0) {
+            double base_score = feature.user_feature * 0.4 + feature.item_feature * 0.6;
+            *upper_bound = base_score * (base_score >= 0 ? 1.1 : 0.9) + 2.0;
+            return base_score;
+        }
+        double score = state * (1.0 + 0.1 * sin(feature.user_id * 0.1)) + 2.0;
+        *upper_bound = score;
+        return score;
+    }
 };
 
+HOTPLUG_EXPORT_OPERATOR_INTERFACE_VERSION()
+
 extern "C" IScoreOperator* create_operator() {
     return new ScoreOperatorV2();
 }
@@ -0,0 +1,138 @@
+// score_op_v3.cpp
+#include "operator_interface.h"
+#include "simd_util.h"
+#include <immintrin.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// V3算法：V1 的线性部分 + 点击类目的 embedding-bag 池化
+// 稀疏特征 clicked_categories 的每个 id 哈希到 embedding 表的一行，按权重求加权平均后与打分向量做内积。
+struct ScoreOperatorV3 : IScoreOperator {
+    static constexpr int kDim = 16;
+    static constexpr uint32_t kRows = 1u << 16;  // 哈希桶数
+
+    std::vector<float> table;      // kRows x kDim，内置默认参数
+    const float* rows;             // 实际使用的 embedding 表：内置表或参数文件里的 "embedding"
+    float score_weights[kDim];
+
+    ScoreOperatorV3() : table(size_t(kRows) * kDim), rows(table.data()) {
+        // 演示用的确定性"参数"
+        uint32_t state = 12345;
+        for (float& v : table) {
+            state = state * 1664525u + 1013904223u;
+            v = float(int32_t(state >> 8) % 2001 - 1000) / 10000.0f;
+        }
+        for (int d = 0; d < kDim; ++d) score_weights[d] = 0.05f * float(d % 5 + 1);
+    }
+
+    double compute_score(const Feature& feature) override {
+        // 单条 Feature 没有稀疏字段，池化项为 0
+        return feature.user_feature * 0.5 + feature.item_feature * 0.3;
+    }
+    const char* name() const override {
+        return "ScoreOperatorV3";
+    }
+    uint32_t required_base_columns() const override {
+        return COL_USER_FEATURE | COL_ITEM_FEATURE;
+    }
+    const char* const* required_catalog_columns() const override {
+        static const char* const none[] = {nullptr};
+        return none;
+    }
+    const char* const* required_sparse_columns() const override {
+        static const char* const names[] = {"clicked_categories", nullptr};
+        return names;
+    }
+
+    // 参数文件里的 embedding 表直接引用（host 保证算子存活期间内存有效），不再保留内置表
+    bool set_parameters(const OperatorParameters& params) override {
+        const ParamTensorView* embedding = params.find("embedding");
+        const ParamTensorView* weights = params.find("score_weights");
+        if (!embedding || embedding->count != size_t(kRows) * kDim || (weights && weights->count != size_t(kDim))) {
+            return false;
+        }
+        rows = embedding->data;
+        std::vector<float>().swap(table);
+        if (weights) std::copy(weights->data, weights->data + kDim, score_weights);
+        return true;
+    }
+
+    void compute_score_soa(const FeatureBatch& batch, double* scores) override {
+        const SparseFeatureColumn* clicks = batch.find_sparse("clicked_categories");
+        const bool avx2 = cpu_has_avx2();
+        for (size_t i = 0; i < batch.size; ++i) {
+            double score = batch.user_feature[i] * 0.5 + batch.item_feature[i] * 0.3;
+            if (clicks) {
+                const uint32_t begin = clicks->offsets[i], n = clicks->offsets[i + 1] - begin;
+                const uint32_t* ids = clicks->ids + begin;
+                // weights 为 nullptr 表示权重均为 1，走不读权重的版本
+                if (clicks->weights) {
+                    const float* w = clicks->weights + begin;
+                    score += avx2 ? pool_dot_avx2<true>(ids, w, n) : pool_dot_scalar<true>(ids, w, n);
+                } else {
+                    score += avx2 ? pool_dot_avx2<false>(ids, nullptr, n) : pool_dot_scalar<false>(ids, nullptr, n);
+                }
+            }
+            scores[i] = score;
+        }
+    }
+
+    static uint32_t bucket_of(uint32_t id) {
+        uint32_t h = id * 0x9E3779B1u;
+        return (h ^ (h >> 16)) & (kRows - 1);
+    }
+
+    // kWeighted 为 false 时不读 weights，每个 id 权重按 1 计
+    template <bool kWeighted>
+    float pool_dot_scalar(const uint32_t* ids, const float* weights, uint32_t n) const {
+        if (n == 0) return 0.0f;
+        float pooled[kDim] = {0};
+        float total_weight = 0;
+        for (uint32_t k = 0; k < n; ++k) {
+            const float* row = rows + size_t(bucket_of(ids[k])) * kDim;
+            const float w = kWeighted ? weights[k] : 1.0f;
+            for (int d = 0; d < kDim; ++d) pooled[d] += w * row[d];
+            total_weight += w;
+        }
+        if (total_weight == 0) return 0.0f;
+        float dot = 0;
+        for (int d = 0; d < kDim; ++d) dot += pooled[d] * score_weights[d];
+        return dot / total_weight;
+    }
+
+    // 每行 16 个 float 正好两个 ymm：逐 id 做 FMA 累加，最后一次性与打分向量做内积
+    template <bool kWeighted>
+    __attribute__((target("avx2,fma")))
+    float pool_dot_avx2(const uint32_t* ids, const float* weights, uint32_t n) const {
+        if (n == 0) return 0.0f;
+        __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+        float total_weight = 0;
+        for (uint32_t k = 0; k < n; ++k) {
+            if (k + 1 < n) _mm_prefetch((const char*)(rows + size_t(bucket_of(ids[k + 1])) * kDim), _MM_HINT_T0);
+            const float* row = rows + size_t(bucket_of(ids[k])) * kDim;
+            const float wk = kWeighted ? weights[k] : 1.0f;
+            __m256 w = _mm256_set1_ps(wk);
+            acc0 = _mm256_fmadd_ps(w, _mm256_loadu_ps(row), acc0);
+            acc1 = _mm256_fmadd_ps(w, _mm256_loadu_ps(row + 8), acc1);
+            total_weight += wk;
+        }
+        if (total_weight == 0) return 0.0f;
+        __m256 dot = _mm256_add_ps(_mm256_mul_ps(acc0, _mm256_loadu_ps(score_weights)),
+                                   _mm256_mul_ps(acc1, _mm256_loadu_ps(score_weights + 8)));
+        __m128 sum = _mm_add_ps(_mm256_castps256_ps128(dot), _mm256_extractf128_ps(dot, 1));
+        sum = _mm_hadd_ps(sum, sum);
+        sum = _mm_hadd_ps(sum, sum);
+        return _mm_cvtss_f32(sum) / total_weight;
+    }
+};
+
+HOTPLUG_EXPORT_OPERATOR_INTERFACE_VERSION()
+
+extern "C" IScoreOperator* create_operator() {
+    return new ScoreOperatorV3();
+}
+extern "C" void destroy_operator(IScoreOperator* op) {
+    delete op;
+}
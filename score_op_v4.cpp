@@ -0,0 +1,57 @@
+// score_op_v4.cpp
+#include "operator_interface.h"
+#include "column_codec.h"
+
+// V4算法：V1 的线性部分 + 8 个目录宽列 item_f0..item_f7 的线性项
+// 宽列在目录里压缩存储时直接拿 EncodedColumn，按 item_id 在寄存器里解码并累加；
+// host 传来的是解码后的 double 列时按普通 extra 列读取，两条路径只差浮点求和顺序。
+struct ScoreOperatorV4 : IScoreOperator {
+    static constexpr int kWide = 8;
+
+    const char* names[kWide + 1] = {"item_f0", "item_f1", "item_f2", "item_f3",
+                                    "item_f4", "item_f5", "item_f6", "item_f7", nullptr};
+    double weights[kWide] = {0.004, -0.002, 0.003, 0.001, -0.001, 0.002, 0.0005, -0.0015};
+
+    double compute_score(const Feature& feature) override {
+        // 单条 Feature 没有目录宽列，宽列项为 0
+        return feature.user_feature * 0.5 + feature.item_feature * 0.3;
+    }
+    const char* name() const override {
+        return "ScoreOperatorV4";
+    }
+    uint32_t required_base_columns() const override {
+        return COL_USER_FEATURE | COL_ITEM_FEATURE;
+    }
+    const char* const* required_catalog_columns() const override {
+        return names;
+    }
+    bool accepts_encoded_columns() const override { return true; }
+
+    void compute_score_soa(const FeatureBatch& batch, double* scores) override {
+        for (size_t i = 0; i < batch.size; ++i) {
+            scores[i] = batch.user_feature[i] * 0.5 + batch.item_feature[i] * 0.3;
+        }
+        // 压缩列：所有列一起在一个循环里解码 + FMA，每行只写一次 scores
+        EncodedColumn encoded[kWide];
+        double encoded_weights[kWide];
+        size_t num_encoded = 0;
+        for (int c = 0; c < kWide; ++c) {
+            if (const double* values = batch.find(names[c])) {
+                for (size_t i = 0; i < batch.size; ++i) scores[i] += weights[c] * values[i];
+            } else if (const EncodedColumn* col = batch.item_id ? batch.find_encoded(names[c]) : nullptr) {
+                encoded[num_encoded] = *col;
+                encoded_weights[num_encoded++] = weights[c];
+            }
+        }
+        if (num_encoded) score_linear_encoded(encoded, encoded_weights, num_encoded, batch.item_id, batch.size, scores);
+    }
+};
+
+HOTPLUG_EXPORT_OPERATOR_INTERFACE_VERSION()
+
+extern "C" IScoreOperator* create_operator() {
+    return new ScoreOperatorV4();
+}
+extern "C" void destroy_operator(IScoreOperator* op) {
+    delete op;
+}
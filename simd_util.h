@@ -0,0 +1,14 @@
+// simd_util.h
+#pragma once
+
+// 运行时检测指令集，SIMD 内核用 __attribute__((target(...))) 单独编译，
+// 这样整体仍按基线指令集构建，老机器上自动走标量路径。
+inline bool cpu_has_avx2() {
+    static const bool has = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return has;
+}
+
+inline bool cpu_has_avx512() {
+    static const bool has = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+    return has;
+}
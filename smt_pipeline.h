@@ -0,0 +1,265 @@
+// smt_pipeline.h
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <immintrin.h>
+
+#include "gather.h"
+#include "housekeeping.h"
+#include "item_precompute.h"
+
+// ---- SMT 兄弟线程流水 gather + 打分 ----
+// gather 按 item_id 随机读目录列和预计算列，基本在等内存；打分是纯计算。把两者放到同一物理核的两个超线程上：
+// 兄弟线程把下一块候选 gather 进共享的块缓冲，调用线程同时对上一块调用算子。两个超线程共享 L1/L2，
+// 块大小按 L2 估算，缓冲刚写完就被另一个线程读走，不回内存；一个线程等内存时另一个的算术单元照常干活。
+// 块之间用两个单调计数（已 gather / 已打分）做单生产者单消费者交接，等待时先 pause 自旋再 yield。
+// 拓扑来自 /sys/devices/system/cpu/cpu*/topology/thread_siblings_list；没有兄弟线程（关闭 SMT、单核虚拟机）时
+// 两个线程不绑核照样流水，但没有共享 L1/L2 的好处，这时单线程分块循环通常更划算。
+
+// 同一物理核上的一对超线程
+struct SmtSiblings {
+    int cpu;      // 打分线程
+    int sibling;  // gather 线程
+};
+
+namespace smt_detail {
+
+inline std::string read_sysfs_line(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+// "2048K" / "32M" -> 字节
+inline size_t parse_cache_size(const std::string& text) {
+    size_t value = std::strtoull(text.c_str(), nullptr, 10);
+    if (text.find('K') != std::string::npos) value <<= 10;
+    if (text.find('M') != std::string::npos) value <<= 20;
+    return value;
+}
+
+}  // namespace smt_detail
+
+// 本进程可用的超线程对（每个物理核取编号最小的两个），按 cpu 编号排序；
+// 读不到拓扑、未开 SMT 或兄弟线程不在本进程的 affinity 里时为空
+inline std::vector<SmtSiblings> smt_sibling_pairs(const std::string& root = "/sys/devices/system/cpu") {
+    using smt_detail::read_sysfs_line;
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return {};
+
+    std::vector<SmtSiblings> pairs;
+    for (int cpu : parse_cpu_list(read_sysfs_line(root + "/online"))) {
+        const std::string topology = root + "/cpu" + std::to_string(cpu) + "/topology/";
+        std::string list = read_sysfs_line(topology + "thread_siblings_list");
+        if (list.empty()) list = read_sysfs_line(topology + "core_cpus_list");
+        std::vector<int> siblings;
+        for (int s : parse_cpu_list(list)) {
+            if (s >= 0 && s < CPU_SETSIZE && CPU_ISSET(s, &allowed)) siblings.push_back(s);
+        }
+        std::sort(siblings.begin(), siblings.end());
+        if (siblings.size() < 2 || siblings[0] != cpu) continue;  // 每个核只在编号最小的线程处记一次
+        pairs.push_back(SmtSiblings{siblings[0], siblings[1]});
+    }
+    return pairs;
+}
+
+// cpu 的 L2 容量；sysfs 里没有缓存信息时按 256KB 估
+inline size_t l2_cache_bytes(int cpu = 0) {
+    using smt_detail::read_sysfs_line;
+    const std::string cache = "/sys/devices/system/cpu/cpu" + std::to_string(std::max(cpu, 0)) + "/cache/index";
+    for (int i = 0; i < 8; ++i) {
+        const std::string level = read_sysfs_line(cache + std::to_string(i) + "/level");
+        if (level.empty()) break;
+        const std::string type = read_sysfs_line(cache + std::to_string(i) + "/type");
+        if (level == "2" && type != "Instruction") {
+            size_t bytes = smt_detail::parse_cache_size(read_sysfs_line(cache + std::to_string(i) + "/size"));
+            if (bytes) return bytes;
+        }
+    }
+    return size_t(256) << 10;
+}
+
+// 按行宽（gather 的列 + 预计算列 + 分数）估块大小：在途的块缓冲合计占 L2 的一半，另一半留给目录列的访问
+inline size_t smt_chunk_rows(const OperatorHolder& holder, const ItemCatalog& catalog, size_t slots = 2,
+                             int cpu = 0) {
+    const size_t per_row = gathered_bytes(holder.projection, 1, &catalog) +
+                           size_t(std::max(holder.item_precompute_width, 0)) * sizeof(double) + sizeof(double);
+    const size_t rows = l2_cache_bytes(cpu) / 2 / std::max<size_t>(slots, 1) / per_row;
+    return std::min<size_t>(4096, std::max<size_t>(64, rows / 16 * 16));
+}
+
+// 把当前线程绑到 cpu；cpu < 0 时什么也不做
+inline bool pin_current_thread(int cpu) {
+    if (cpu < 0) return true;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+// 单线程基线：同样分块，逐块 gather 后打分
+inline void gather_score_chunked(const OperatorHolder& holder, const ItemCatalog& catalog, const UserContext& user,
+                                 const int* item_ids, size_t n, double* scores, size_t chunk,
+                                 FeatureBatchBuffer& buf) {
+    chunk = chunk ? chunk : n;
+    for (size_t begin = 0; begin < n; begin += chunk) {
+        const size_t rows = std::min(chunk, n - begin);
+        gather_features(holder.projection, catalog, user, item_ids + begin, rows, buf);
+        score_feature_batch(holder, buf, scores + begin);
+    }
+}
+
+struct SmtPipelineStats {
+    uint64_t runs = 0;
+    uint64_t chunks = 0;
+    double score_stall_us = 0;   // 打分线程等 gather 的时间：大说明 gather 是瓶颈
+    double gather_stall_us = 0;  // gather 线程等空闲缓冲的时间：大说明打分是瓶颈
+};
+
+class SmtGatherScorer {
+public:
+    static constexpr size_t kSlots = 2;  // 双缓冲：一块在打分，一块在 gather
+
+    // gather 线程绑到 gather_cpu（-1 不绑）。run 的调用线程负责打分，应事先用 pin_current_thread 绑到它的兄弟线程上
+    explicit SmtGatherScorer(int gather_cpu = -1) : gather_cpu_(gather_cpu) {
+        gatherer_ = std::thread([this] { gather_loop(); });
+    }
+
+    ~SmtGatherScorer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        job_cv_.notify_one();
+        gatherer_.join();
+    }
+
+    SmtGatherScorer(const SmtGatherScorer&) = delete;
+    SmtGatherScorer& operator=(const SmtGatherScorer&) = delete;
+
+    // 为 n 个候选打分，结果写入 scores；chunk 为 0 时用 smt_chunk_rows。只有一块时在调用线程上直接做完。
+    // 同一时刻只能有一个调用方
+    void run(const OperatorHolder& holder, const ItemCatalog& catalog, const UserContext& user, const int* item_ids,
+             size_t n, double* scores, size_t chunk = 0) {
+        if (n == 0) return;
+        chunk = chunk ? chunk : smt_chunk_rows(holder, catalog, kSlots);
+        const size_t num_chunks = (n + chunk - 1) / chunk;
+        runs_.fetch_add(1, std::memory_order_relaxed);
+        chunks_.fetch_add(num_chunks, std::memory_order_relaxed);
+        if (num_chunks == 1) {
+            gather_score_chunked(holder, catalog, user, item_ids, n, scores, 0, slots_[0]);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            job_ = Job{&holder, &catalog, user, item_ids, n, chunk, num_chunks};
+            produced_.store(0, std::memory_order_relaxed);
+            consumed_.store(0, std::memory_order_relaxed);
+            job_seq_++;
+        }
+        job_cv_.notify_one();
+
+        for (size_t c = 0; c < num_chunks; ++c) {
+            const double stall = wait_until([&] { return produced_.load(std::memory_order_acquire) > c; });
+            score_stall_ns_.fetch_add(uint64_t(stall), std::memory_order_relaxed);
+            FeatureBatchBuffer& buf = slots_[c % kSlots];
+            holder.op->compute_score_soa(buf.view(), scores + c * chunk);
+            consumed_.store(c + 1, std::memory_order_release);
+        }
+    }
+
+    bool pinned() const { return gather_cpu_ >= 0; }
+
+    SmtPipelineStats stats() const {
+        SmtPipelineStats s;
+        s.runs = runs_.load(std::memory_order_relaxed);
+        s.chunks = chunks_.load(std::memory_order_relaxed);
+        s.score_stall_us = score_stall_ns_.load(std::memory_order_relaxed) / 1e3;
+        s.gather_stall_us = gather_stall_ns_.load(std::memory_order_relaxed) / 1e3;
+        return s;
+    }
+
+private:
+    struct Job {
+        const OperatorHolder* holder;
+        const ItemCatalog* catalog;
+        UserContext user;
+        const int* item_ids;
+        size_t n;
+        size_t chunk;
+        size_t num_chunks;
+    };
+
+    // 先 pause 自旋，等久了 yield 让出 CPU（兄弟线程不在另一个超线程上时，自旋只会拖住对方）；返回等待的纳秒数
+    template <typename Pred>
+    static double wait_until(Pred ready) {
+        if (ready()) return 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (int spins = 0; !ready(); ++spins) {
+            if (spins < 256) {
+                _mm_pause();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void gather_loop() {
+        pin_current_thread(gather_cpu_);
+        uint64_t seen = 0;
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                job_cv_.wait(lock, [&] { return stopping_ || job_seq_ != seen; });
+                if (stopping_) return;
+                seen = job_seq_;
+                job = job_;
+            }
+            for (size_t c = 0; c < job.num_chunks; ++c) {
+                // 第 c 块复用第 c - kSlots 块的缓冲，等它打分完
+                const double stall = wait_until([&] { return consumed_.load(std::memory_order_acquire) + kSlots > c; });
+                gather_stall_ns_.fetch_add(uint64_t(stall), std::memory_order_relaxed);
+                const size_t begin = c * job.chunk, rows = std::min(job.chunk, job.n - begin);
+                FeatureBatchBuffer& buf = slots_[c % kSlots];
+                gather_features(job.holder->projection, *job.catalog, job.user, job.item_ids + begin, rows, buf);
+                gather_item_precomputed(*job.holder, buf);
+                produced_.store(c + 1, std::memory_order_release);
+            }
+        }
+    }
+
+    const int gather_cpu_;
+    FeatureBatchBuffer slots_[kSlots];
+    alignas(64) std::atomic<size_t> produced_{0};  // 已 gather 完的块数，gather 线程写；两个计数各占一个缓存行
+    alignas(64) std::atomic<size_t> consumed_{0};  // 已打分完的块数，打分线程写
+
+    std::mutex mutex_;
+    std::condition_variable job_cv_;
+    Job job_;
+    uint64_t job_seq_ = 0;
+    bool stopping_ = false;
+
+    std::atomic<uint64_t> runs_{0};
+    std::atomic<uint64_t> chunks_{0};
+    std::atomic<uint64_t> score_stall_ns_{0};
+    std::atomic<uint64_t> gather_stall_ns_{0};
+    std::thread gatherer_;
+};
@@ -0,0 +1,207 @@
+// so_loader.h
+#pragma once
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+#include "blake3.h"
+
+// ---- 校验后加载 .so ----
+// 先算校验和、再按路径 dlopen 有两个问题：文件多读了一遍，而且校验和加载之间文件仍可能被替换。
+// 这里把 so 只读一遍：housekeeping 线程各自负责一段，把这段写进 memfd 后趁数据还在缓存里做 BLAKE3，
+// 写完后封住 memfd（不可再写、不可改大小）再 dlopen("/proc/self/fd/N")，加载的正是算过摘要的那份字节。
+// memfd 要一直开着直到 dlclose：glibc 按路径名识别已加载的库，fd 号被复用会误命中旧库。
+//
+// 校验清单（b3sum 输出格式："<摘要>  <文件名>"，按文件名匹配）由环境变量 HOTPLUG_SO_MANIFEST 指定；
+// 配置了清单时，清单里没有或摘要不符的 so 拒绝加载；未配置时只记录摘要。
+
+class SoManifest {
+public:
+    static SoManifest& instance() {
+        static SoManifest manifest;
+        return manifest;
+    }
+
+    // 读入 b3sum 格式的清单并启用校验
+    bool load(const std::string& path) {
+        std::ifstream in(path);
+        if (!in) {
+            std::cerr << "[SoLoader] 无法读取校验清单: " << path << std::endl;
+            return false;
+        }
+        std::map<std::string, std::string> entries;
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream ss(line);
+            std::string digest, file;
+            if (!(ss >> digest >> file) || digest.size() != blake3::kOutLen * 2) continue;
+            entries[base_name(file)] = digest;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.swap(entries);
+        enforced_ = true;
+        return true;
+    }
+
+    void set(const std::string& so_file, const std::string& digest) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_[base_name(so_file)] = digest;
+        enforced_ = true;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+        enforced_ = false;
+    }
+
+    bool enforced() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return enforced_;
+    }
+
+    // 未启用时总是通过；启用后 so 必须在清单中且摘要一致，失败时 why 给出原因
+    bool check(const std::string& so_file, const std::string& digest, std::string* why) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!enforced_) return true;
+        auto it = entries_.find(base_name(so_file));
+        if (it == entries_.end()) {
+            *why = "不在校验清单中";
+            return false;
+        }
+        if (it->second != digest) {
+            *why = "摘要不符，期望 " + it->second;
+            return false;
+        }
+        return true;
+    }
+
+    static std::string base_name(const std::string& path) {
+        size_t slash = path.rfind('/');
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+private:
+    SoManifest() {
+        if (const char* env = std::getenv("HOTPLUG_SO_MANIFEST")) load(env);
+    }
+
+    mutable std::mutex mutex_;
+    std::map<std::string, std::string> entries_;
+    bool enforced_ = false;
+};
+
+struct SoLoadStats {
+    size_t bytes = 0;
+    double hash_copy_us = 0;  // 读 + 哈希 + 写 memfd
+    double dlopen_us = 0;
+};
+
+// 加载结果：handle 与 memfd 由调用方持有，dlclose 之后再 close(memfd)
+struct VerifiedLibrary {
+    void* handle = nullptr;
+    int memfd = -1;
+    std::string digest;  // BLAKE3 十六进制
+};
+
+// threads 为 0 时用 housekeeping 线程数；so 不大时只有一段，直接在当前线程完成
+inline bool open_verified_library(const std::string& so_file, VerifiedLibrary* out, size_t threads = 0,
+                                  SoLoadStats* stats = nullptr) {
+    auto start = std::chrono::steady_clock::now();
+    int fd = ::open(so_file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "[SoLoader] 无法打开: " << so_file << std::endl;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        std::cerr << "[SoLoader] fstat 失败: " << so_file << std::endl;
+        ::close(fd);
+        return false;
+    }
+    const size_t size = size_t(st.st_size);
+    void* src = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (src == MAP_FAILED) {
+        std::cerr << "[SoLoader] mmap 失败: " << so_file << std::endl;
+        return false;
+    }
+    int memfd = memfd_create(SoManifest::base_name(so_file).c_str(), MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memfd < 0 || ftruncate(memfd, off_t(size)) != 0) {
+        std::cerr << "[SoLoader] memfd 创建失败: " << so_file << std::endl;
+        if (memfd >= 0) ::close(memfd);
+        munmap(src, size);
+        return false;
+    }
+
+    const uint8_t* data = static_cast<const uint8_t*>(src);
+    std::atomic<bool> written{true};
+    blake3::HashOptions options;
+    options.threads = threads ? threads : size_t(housekeeping_thread_num());
+    blake3::Digest digest = blake3::hash_tree(data, size, options, [&](size_t offset, size_t n) {
+        size_t done = 0;
+        while (done < n) {
+            ssize_t w = pwrite(memfd, data + offset + done, n - done, off_t(offset + done));
+            if (w <= 0) {
+                written = false;
+                return;
+            }
+            done += size_t(w);
+        }
+    });
+    munmap(src, size);
+    const int seals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL;
+    if (!written || fcntl(memfd, F_ADD_SEALS, seals) != 0) {
+        std::cerr << "[SoLoader] 写入或封存 memfd 失败: " << so_file << std::endl;
+        ::close(memfd);
+        return false;
+    }
+    auto hashed = std::chrono::steady_clock::now();
+
+    std::string why;
+    if (!SoManifest::instance().check(so_file, digest.hex(), &why)) {
+        std::cerr << "[SoLoader] 拒绝加载 " << so_file << ": " << why << "，实际 " << digest.hex() << std::endl;
+        ::close(memfd);
+        return false;
+    }
+
+    // 同名路径若仍挂着一个未卸载的旧库（比如带 NODELETE 的库占着同一个 fd 号），换个 fd 号再加载
+    std::string path = "/proc/self/fd/" + std::to_string(memfd);
+    while (void* stale = dlopen(path.c_str(), RTLD_NOW | RTLD_NOLOAD)) {
+        dlclose(stale);
+        int moved = fcntl(memfd, F_DUPFD_CLOEXEC, memfd + 1);
+        ::close(memfd);
+        if (moved < 0) return false;
+        memfd = moved;
+        path = "/proc/self/fd/" + std::to_string(memfd);
+    }
+    void* handle = dlopen(path.c_str(), RTLD_NOW);
+    if (!handle) {
+        std::cerr << dlerror() << std::endl;
+        ::close(memfd);
+        return false;
+    }
+    out->handle = handle;
+    out->memfd = memfd;
+    out->digest = digest.hex();
+    if (stats) {
+        auto done = std::chrono::steady_clock::now();
+        stats->bytes = size;
+        stats->hash_copy_us = std::chrono::duration<double, std::micro>(hashed - start).count();
+        stats->dlopen_us = std::chrono::duration<double, std::micro>(done - hashed).count();
+    }
+    return true;
+}
@@ -0,0 +1,27 @@
+// stage_calibrate_v1.cpp
+#include "stage_interface.h"
+#include <cmath>
+
+// 校准阶段V1：Platt scaling，把算子原始分映射到 (0, 1) 的点击概率
+struct PlattCalibrationV1 : IPipelineStage {
+    const char* name() const override {
+        return "PlattCalibrationV1";
+    }
+    StageKind kind() const override {
+        return STAGE_TRANSFORM;
+    }
+    void process(const StageRequest&, StageChunk& chunk) override {
+        for (size_t i = 0; i < chunk.size; ++i) {
+            chunk.scores[i] = 1.0 / (1.0 + std::exp(-(1.5 * chunk.scores[i] - 2.0)));
+        }
+    }
+};
+
+HOTPLUG_EXPORT_STAGE_INTERFACE_VERSION()
+
+extern "C" IPipelineStage* create_stage() {
+    return new PlattCalibrationV1();
+}
+extern "C" void destroy_stage(IPipelineStage* stage) {
+    delete stage;
+}
@@ -0,0 +1,36 @@
+// stage_calibrate_v2.cpp
+#include "stage_interface.h"
+#include <algorithm>
+
+// 校准阶段V2：分段线性（保序回归拟合出的折线），并混入少量召回分
+struct PiecewiseCalibrationV2 : IPipelineStage {
+    static constexpr int kKnots = 6;
+    const double xs[kKnots] = {-1.0, 0.0, 0.5, 1.0, 2.0, 4.0};
+    const double ys[kKnots] = {0.01, 0.05, 0.12, 0.30, 0.65, 0.95};
+
+    const char* name() const override {
+        return "PiecewiseCalibrationV2";
+    }
+    StageKind kind() const override {
+        return STAGE_TRANSFORM;
+    }
+    void process(const StageRequest&, StageChunk& chunk) override {
+        for (size_t i = 0; i < chunk.size; ++i) {
+            double x = std::min(std::max(chunk.scores[i], xs[0]), xs[kKnots - 1]);
+            int k = int(std::upper_bound(xs, xs + kKnots, x) - xs);
+            k = std::min(std::max(k, 1), kKnots - 1);
+            double t = (x - xs[k - 1]) / (xs[k] - xs[k - 1]);
+            double p = ys[k - 1] + t * (ys[k] - ys[k - 1]);
+            chunk.scores[i] = p + 0.01 * chunk.retrieval_scores[i];
+        }
+    }
+};
+
+HOTPLUG_EXPORT_STAGE_INTERFACE_VERSION()
+
+extern "C" IPipelineStage* create_stage() {
+    return new PiecewiseCalibrationV2();
+}
+extern "C" void destroy_stage(IPipelineStage* stage) {
+    delete stage;
+}
@@ -0,0 +1,94 @@
+// stage_interface.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "operator_interface.h"
+
+// ---- pipeline 阶段接口 ----
+// 打分链路 retrieve -> filter -> gather -> score -> calibrate -> top-K [-> rerank] 中的每一步都是一个阶段，
+// 可以像算子一样编译成 .so（导出 create_stage / destroy_stage），也可以由 host 内建。
+// 同一个阶段实例会被多个请求并发调用，process / collect 不应修改实例自身的状态。
+
+enum StageKind {
+    STAGE_SOURCE = 0,     // 产生候选，每个请求调用一次
+    STAGE_TRANSFORM = 1,  // 逐 chunk 原地处理
+    STAGE_SINK = 2,       // 逐 chunk 汇总出最终结果
+    STAGE_RERANK = 3,     // sink 之后对整个排名重排，每个请求调用一次
+};
+
+// 请求上下文，整个请求内不变
+struct StageRequest {
+    int user_id;
+    double user_feature;
+    const float* user_embedding;  // 检索用，可为 nullptr
+    uint32_t embedding_dim;
+    size_t k;                     // 最终返回条数
+};
+
+// 流经 pipeline 的一段候选，chunk 较小，中间结果留在缓存里
+struct StageChunk {
+    int* item_ids;
+    double* retrieval_scores;  // source 给出的召回分
+    size_t size;               // 过滤类阶段原地压缩候选并改小 size
+    FeatureBatch batch;        // gather 阶段填写，其后的阶段只读
+    double* scores;            // score 阶段写入，calibrate 等阶段原地改写
+    void* host;                // host 内建阶段的 chunk 私有存储，插件阶段不应使用
+};
+
+struct StageRankedItem {
+    int item_id;
+    double score;
+};
+
+// sink 的请求内状态由 executor 持有，阶段实例本身保持无状态
+struct StageRanking {
+    StageRankedItem* items;
+    size_t size;
+    size_t capacity;
+};
+
+// 阶段接口版本：插件导出 stage_interface_version()（HOTPLUG_EXPORT_STAGE_INTERFACE_VERSION），
+// load_stage 不一致时拒绝加载。与算子接口一样，新增虚函数只能追加在类的末尾并递增这个版本
+// （版本 2 追加了 rerank_pool / rerank）。
+constexpr uint32_t kStageInterfaceVersion = 2;
+
+#define HOTPLUG_EXPORT_STAGE_INTERFACE_VERSION() \
+    extern "C" uint32_t stage_interface_version() { return kStageInterfaceVersion; }
+
+class IPipelineStage {
+public:
+    virtual ~IPipelineStage() = default;
+    virtual const char* name() const = 0;
+    virtual StageKind kind() const = 0;
+
+    // STAGE_SOURCE：写入至多 capacity 个候选，返回个数
+    virtual size_t generate(const StageRequest& req, int* item_ids, double* retrieval_scores, size_t capacity) {
+        (void)req; (void)item_ids; (void)retrieval_scores; (void)capacity;
+        return 0;
+    }
+    // STAGE_TRANSFORM
+    virtual void process(const StageRequest& req, StageChunk& chunk) {
+        (void)req; (void)chunk;
+    }
+    // STAGE_SINK
+    virtual void collect(const StageRequest& req, const StageChunk& chunk, StageRanking& ranking) {
+        (void)req; (void)chunk; (void)ranking;
+    }
+    // STAGE_RERANK：希望 sink 保留的条数（不少于 req.k）
+    virtual size_t rerank_pool(const StageRequest& req) const {
+        return req.k;
+    }
+    // STAGE_RERANK：ranking 进来时按分数降序；原地重排，可以改小 size，多出 req.k 的部分由 executor 截掉
+    virtual void rerank(const StageRequest& req, StageRanking& ranking) {
+        (void)req; (void)ranking;
+    }
+
+    // 新增虚函数只能加在这里（类的末尾），并递增 kStageInterfaceVersion
+};
+
+// .so 导出
+// extern "C" IPipelineStage* create_stage();
+// extern "C" void destroy_stage(IPipelineStage*);
+// extern "C" uint32_t stage_interface_version();  // HOTPLUG_EXPORT_STAGE_INTERFACE_VERSION() 生成
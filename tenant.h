@@ -0,0 +1,297 @@
+// tenant.h
+#pragma once
+
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "left_right.h"
+#include "operator_holder.h"
+#include "worker_pool.h"
+
+// ---- 多租户路由 ----
+// 租户经 LeftRight<RoutingTable> 映射到算子槽位（未固定的租户按槽位权重分流），每个槽位是一个独立的
+// shared_ptr<OperatorHolder>，和 g_operator 一样用 atomic_store 发布：换某个租户的版本只动它的槽位，
+// 其他租户手里的算子和缓存代际都不变。路由表的读只有两次 fetch_add，调整映射不阻塞请求。
+class TenantRouter {
+public:
+    static constexpr int kMaxSlots = RoutingTable::kMaxSlots;
+    static constexpr int kMaxTenants = RoutingTable::kMaxTenants;
+
+    // 把租户固定到槽位；slot 为 -1 时改回按权重分流。越界返回 false
+    bool assign(int tenant, int slot) {
+        if (tenant < 0 || tenant >= kMaxTenants || slot < -1 || slot >= kMaxSlots) return false;
+        routes_.modify([&](RoutingTable& t) {
+            t.tenant_slot[tenant] = slot;
+            t.epoch++;
+        });
+        return true;
+    }
+
+    bool set_weight(int slot, double weight) {
+        if (slot < 0 || slot >= kMaxSlots || weight < 0) return false;
+        routes_.modify([&](RoutingTable& t) {
+            t.slot_weight[slot] = weight;
+            t.epoch++;
+        });
+        return true;
+    }
+
+    // 发布槽位上的算子版本，返回旧版本；越界返回 nullptr 且不发布
+    std::shared_ptr<OperatorHolder> publish(int slot, std::shared_ptr<OperatorHolder> holder) {
+        if (slot < 0 || slot >= kMaxSlots) return nullptr;
+        auto old = std::atomic_load(&slots_[slot]);
+        std::atomic_store(&slots_[slot], std::move(holder));
+        return old;
+    }
+
+    std::shared_ptr<OperatorHolder> slot(int s) const {
+        if (s < 0 || s >= kMaxSlots) return nullptr;
+        return std::atomic_load(&slots_[s]);
+    }
+
+    int slot_of(int tenant, uint64_t request_hash) const {
+        return routes_.read([&](const RoutingTable& t) { return t.route(tenant, request_hash); });
+    }
+
+    // 请求路径：选槽位后原子读取该槽位的算子；槽位尚未发布时返回 nullptr
+    std::shared_ptr<OperatorHolder> route(int tenant, uint64_t request_hash) const {
+        return slot(slot_of(tenant, request_hash));
+    }
+
+    uint64_t epoch() const {
+        return routes_.read([](const RoutingTable& t) { return t.epoch; });
+    }
+
+private:
+    LeftRight<RoutingTable> routes_;
+    std::shared_ptr<OperatorHolder> slots_[kMaxSlots];
+};
+
+// ---- 按租户的 CPU 配额 ----
+// 每个租户一个令牌桶，单位是 CPU 纳秒：按 cores 的速率随墙钟补充，上限 burst_ms。
+// 请求先进租户自己的队列，桶里有令牌才放行到共享的线程池；放行时按该租户每请求 CPU 的 EWMA 预扣，
+// 执行完用 CLOCK_THREAD_CPUTIME_ID 实测的 CPU 时间多退少补。超额的租户只会在自己的队列里排队，
+// 线程池队列里始终只有在配额内的工作，其他租户的请求不会排在它的积压后面。
+// 有租户被限流时后台线程按最早补足令牌的时刻唤醒，继续放行。
+
+struct TenantQuota {
+    double cores = 0;       // 每秒可用的 CPU 秒数；<= 0 不限
+    double burst_ms = 10;   // 桶容量，CPU 毫秒
+};
+
+struct TenantUsage {
+    uint64_t submitted = 0;
+    uint64_t completed = 0;
+    uint64_t throttled = 0;  // 提交时因令牌不足留在租户队列里的请求数
+    size_t queued = 0;       // 在租户队列里等放行的
+    size_t in_flight = 0;    // 已放行未完成的
+    double cpu_ms = 0;       // 实测 CPU 时间
+    double tokens_ms = 0;
+};
+
+class TenantScheduler {
+public:
+    static constexpr int kMaxTenants = RoutingTable::kMaxTenants;
+
+    explicit TenantScheduler(ElasticWorkerPool& pool) : pool_(pool) {
+        ticker_ = std::thread([this] { ticker_loop(); });
+    }
+
+    // 等已提交的请求全部执行完再停
+    ~TenantScheduler() {
+        wait_idle();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        ticker_cv_.notify_all();
+        ticker_.join();
+    }
+
+    TenantScheduler(const TenantScheduler&) = delete;
+    TenantScheduler& operator=(const TenantScheduler&) = delete;
+
+    bool set_quota(int tenant, const TenantQuota& quota) {
+        if (tenant < 0 || tenant >= kMaxTenants) return false;
+        std::vector<Release> release;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            Tenant& t = tenants_[tenant];
+            t.quota = quota;
+            t.tokens_ns = quota.burst_ms * 1e6;
+            t.refilled = Clock::now();
+            pump_locked(tenant, &release);
+        }
+        dispatch(release);
+        return true;
+    }
+
+    // tenant 越界返回 false
+    bool submit(int tenant, std::function<void()> fn) {
+        if (tenant < 0 || tenant >= kMaxTenants) return false;
+        std::vector<Release> release;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            Tenant& t = tenants_[tenant];
+            t.queue.push_back(std::move(fn));
+            t.submitted++;
+            queued_++;
+            pump_locked(tenant, &release);
+            if (!t.queue.empty()) t.throttled++;
+        }
+        dispatch(release);
+        return true;
+    }
+
+    // 等所有租户队列为空且没有在途请求
+    void wait_idle() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_cv_.wait(lock, [&] { return queued_ == 0 && in_flight_ == 0; });
+    }
+
+    TenantUsage usage(int tenant) const {
+        TenantUsage u;
+        if (tenant < 0 || tenant >= kMaxTenants) return u;
+        std::lock_guard<std::mutex> lock(mutex_);
+        const Tenant& t = tenants_[tenant];
+        u.submitted = t.submitted;
+        u.completed = t.completed;
+        u.throttled = t.throttled;
+        u.queued = t.queue.size();
+        u.in_flight = t.in_flight;
+        u.cpu_ms = t.cpu_ns / 1e6;
+        u.tokens_ms = t.tokens_ns / 1e6;
+        return u;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Tenant {
+        TenantQuota quota;
+        std::deque<std::function<void()>> queue;
+        double tokens_ns = 0;
+        double estimate_ns = 100000;  // 每请求 CPU 的 EWMA，放行时按它预扣
+        Clock::time_point refilled = Clock::now();
+        size_t in_flight = 0;
+        uint64_t submitted = 0;
+        uint64_t completed = 0;
+        uint64_t throttled = 0;
+        double cpu_ns = 0;
+    };
+
+    struct Release {
+        int tenant;
+        double charged_ns;
+        std::function<void()> fn;
+    };
+
+    static int64_t thread_cpu_ns() {
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    static bool limited(const Tenant& t) { return t.quota.cores > 0; }
+
+    void refill_locked(Tenant& t, Clock::time_point now) {
+        if (limited(t)) {
+            double elapsed_ns = std::chrono::duration<double, std::nano>(now - t.refilled).count();
+            t.tokens_ns = std::min(t.quota.burst_ms * 1e6, t.tokens_ns + elapsed_ns * t.quota.cores);
+        }
+        t.refilled = now;
+    }
+
+    // 放行租户队列里令牌允许的请求；仍有积压时交给后台线程稍后再放
+    void pump_locked(int id, std::vector<Release>* release) {
+        Tenant& t = tenants_[id];
+        refill_locked(t, Clock::now());
+        while (!t.queue.empty() && (!limited(t) || t.tokens_ns > 0)) {
+            const double charged = limited(t) ? t.estimate_ns : 0;
+            t.tokens_ns -= charged;
+            release->push_back(Release{id, charged, std::move(t.queue.front())});
+            t.queue.pop_front();
+            t.in_flight++;
+            queued_--;
+            in_flight_++;
+        }
+        if (!t.queue.empty()) ticker_cv_.notify_one();
+    }
+
+    void dispatch(std::vector<Release>& release) {
+        for (Release& r : release) {
+            auto shared = std::make_shared<Release>(std::move(r));
+            pool_.submit([this, shared] { run(*shared); });
+        }
+    }
+
+    void run(Release& r) {
+        const int64_t cpu_start = thread_cpu_ns();
+        r.fn();
+        const double used = double(thread_cpu_ns() - cpu_start);
+        std::vector<Release> release;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            Tenant& t = tenants_[r.tenant];
+            if (limited(t)) t.tokens_ns += r.charged_ns - used;  // 预扣与实测的差额
+            t.estimate_ns = t.estimate_ns * 0.8 + used * 0.2;
+            t.cpu_ns += used;
+            t.completed++;
+            t.in_flight--;
+            in_flight_--;
+            pump_locked(r.tenant, &release);
+            if (queued_ == 0 && in_flight_ == 0) idle_cv_.notify_all();
+        }
+        dispatch(release);
+    }
+
+    // 有租户积压时，睡到最早有租户补足令牌的时刻，放行后继续
+    void ticker_loop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            double wait_ns = -1;
+            const Clock::time_point now = Clock::now();
+            for (Tenant& t : tenants_) {
+                if (t.queue.empty()) continue;
+                refill_locked(t, now);
+                double need = limited(t) && t.tokens_ns <= 0 ? -t.tokens_ns / t.quota.cores + 1000 : 0;
+                wait_ns = wait_ns < 0 ? need : std::min(wait_ns, need);
+            }
+            if (stopping_) return;
+            if (wait_ns < 0) {
+                ticker_cv_.wait(lock);
+                continue;
+            }
+            ticker_cv_.wait_for(lock, std::chrono::nanoseconds(int64_t(std::max(wait_ns, 50000.0))));
+            std::vector<Release> release;
+            for (int id = 0; id < kMaxTenants; ++id) {
+                if (!tenants_[id].queue.empty()) pump_locked(id, &release);
+            }
+            if (!release.empty()) {
+                lock.unlock();
+                dispatch(release);
+                lock.lock();
+            }
+        }
+    }
+
+    ElasticWorkerPool& pool_;
+    mutable std::mutex mutex_;
+    std::condition_variable ticker_cv_;
+    std::condition_variable idle_cv_;
+    Tenant tenants_[kMaxTenants];
+    size_t queued_ = 0;     // 所有租户队列里的请求数
+    size_t in_flight_ = 0;  // 所有租户已放行未完成的请求数
+    bool stopping_ = false;
+    std::thread ticker_;
+};
@@ -0,0 +1,471 @@
+// timeseries.h
+#pragma once
+
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// ---- 按秒滚动的请求时序 ----
+// 累计统计把一次切换的影响摊到整段运行时间上，看不出切换前后的差别。这里按 1 秒一个桶记录请求数、
+// 各版本请求数、延迟直方图和切换事件，环形保留最近一小时（内存固定），可以直接比较某次 hot_update 前后几秒。
+// 写入走每线程分片：分片按秒号轮转 kShardSlots 个槽，业务线程只碰自己分片的缓存行；
+// collect 把各分片槽自上次以来的增量并入环，后台线程每秒做一次，查询前也会先做一次。
+
+namespace timeseries_detail {
+
+// 延迟直方图按纳秒计：每个 2 的幂区间再分 4 档（相对误差 <= 25%），最后一档收纳约 34 秒以上
+constexpr size_t kLatencyBuckets = 140;
+constexpr size_t kVersionSlots = 4;  // 每秒最多分开统计 4 个版本，其余计入 other
+
+inline size_t latency_bucket(uint64_t ns) {
+    if (ns < 4) return size_t(ns);
+    uint32_t e = 63 - uint32_t(__builtin_clzll(ns));
+    if (e > 35) return kLatencyBuckets - 1;
+    return size_t(e - 1) * 4 + size_t((ns >> (e - 2)) & 3);
+}
+
+// 第 idx 档的下界（纳秒）
+inline uint64_t latency_bucket_floor(size_t idx) {
+    if (idx < 4) return idx;
+    return uint64_t(4 + idx % 4) << (idx / 4 - 1);
+}
+
+// 线程分片下标：线程第一次写时领一个，线程退出时还回空闲表，后来的线程优先复用最小的空闲下标。
+// 弹性线程池反复起停线程也不会把独占下标耗尽；独占下标都被占用时领到 shared，几个线程共用。
+// 故意不析构：线程局部对象在进程退出阶段还要往这里还
+class ShardIndexPool {
+public:
+    static ShardIndexPool& instance() {
+        static ShardIndexPool* pool = new ShardIndexPool();
+        return *pool;
+    }
+
+    size_t acquire(size_t shared) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!free_.empty()) {
+            auto it = std::min_element(free_.begin(), free_.end());
+            size_t index = *it;
+            *it = free_.back();
+            free_.pop_back();
+            return index;
+        }
+        return next_ < shared ? next_++ : shared;
+    }
+
+    void release(size_t index, size_t shared) {
+        if (index >= shared) return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(index);
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<size_t> free_;
+    size_t next_ = 0;
+};
+
+// 归还由线程局部对象的析构完成；还回之前本线程对分片的写都在 mutex 之前，复用它的线程能看到
+template <size_t kShared>
+struct ThreadShardIndex {
+    const size_t index;
+    ThreadShardIndex() : index(ShardIndexPool::instance().acquire(kShared)) {}
+    ~ThreadShardIndex() { ShardIndexPool::instance().release(index, kShared); }
+};
+
+}  // namespace timeseries_detail
+
+// 环里的一个秒桶
+struct SecondBucket {
+    int64_t second = -1;  // 自序列创建起的秒号，-1 为空
+    uint64_t requests = 0;
+    uint64_t latency_sum_ns = 0;
+    uint64_t version[timeseries_detail::kVersionSlots] = {};  // 算子代际，0 为空槽
+    uint64_t version_requests[timeseries_detail::kVersionSlots] = {};
+    uint64_t other_version_requests = 0;
+    uint32_t swaps = 0;
+    uint64_t latency[timeseries_detail::kLatencyBuckets] = {};
+
+    void add_version(uint64_t generation, uint64_t count) {
+        for (size_t k = 0; k < timeseries_detail::kVersionSlots; ++k) {
+            if (version[k] == 0) version[k] = generation;
+            if (version[k] == generation) {
+                version_requests[k] += count;
+                return;
+            }
+        }
+        other_version_requests += count;
+    }
+};
+
+struct SwapEvent {
+    int64_t second = 0;
+    double at_seconds = 0;  // 自序列创建起的时刻
+    uint64_t version = 0;
+    std::string label;
+};
+
+// [from_second, to_second) 的聚合，分位数取直方图档位中点
+struct WindowSummary {
+    int64_t from_second = 0;
+    int64_t to_second = 0;
+    size_t seconds = 0;  // 实际覆盖的已结束秒数
+    uint64_t requests = 0;
+    uint32_t swaps = 0;
+    double qps = 0;
+    double mean_us = 0;
+    double p50_us = 0;
+    double p99_us = 0;
+    std::vector<std::pair<uint64_t, uint64_t>> versions;  // (代际, 请求数)
+};
+
+struct SwapImpact {
+    SwapEvent swap;
+    WindowSummary before;  // 切换所在秒之前的 window 秒
+    WindowSummary after;   // 切换所在秒之后的 window 秒
+};
+
+class TimeSeries {
+public:
+    static constexpr size_t kShardSlots = 4;  // 每个分片轮转的秒槽数，collect 落后超过 3 秒才会丢数据
+    static constexpr size_t kMaxShards = 64;  // 同时存活的前 63 个线程各占一个分片，其余共用最后一个；线程退出后分片由新线程复用
+    static constexpr size_t kMaxSwapEvents = 256;
+
+    explicit TimeSeries(size_t retain_seconds = 3600)
+        : start_ns_(coarse_now_ns()), ring_(retain_seconds ? retain_seconds : 1) {
+        for (auto& shard : shards_) shard.store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~TimeSeries() {
+        stop();
+        for (auto& shard : shards_) delete shard.load(std::memory_order_relaxed);
+    }
+
+    TimeSeries(const TimeSeries&) = delete;
+    TimeSeries& operator=(const TimeSeries&) = delete;
+
+    // 秒桶只需要秒级精度：CLOCK_MONOTONIC_COARSE 只读内核更新的 tick 时间，不读 TSC，分辨率为一个 tick
+    static int64_t coarse_now_ns() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    int64_t now_second() const { return (coarse_now_ns() - start_ns_) / 1000000000; }
+
+    size_t retain_seconds() const { return ring_.size(); }
+
+    // 业务线程调用：只改本线程分片里当前秒的槽。独占分片的线程计数用 relaxed 读改写，
+    // 不需要带 lock 前缀的原子加；共用最后一个分片的线程才用 fetch_add
+    void record(uint64_t version, uint64_t latency_ns) {
+        const int64_t second = now_second();
+        bool exclusive = false;
+        ShardSlot& slot = local_shard(&exclusive).slots[size_t(second) % kShardSlots];
+        if (!enter(slot, second)) return;
+        bump(slot.requests, 1, exclusive);
+        bump(slot.latency_sum_ns, latency_ns, exclusive);
+        bump(slot.latency[timeseries_detail::latency_bucket(latency_ns)], 1, exclusive);
+        for (size_t k = 0; k < timeseries_detail::kVersionSlots; ++k) {
+            uint64_t v = slot.version[k].load(std::memory_order_relaxed);
+            if (v == 0 && slot.version[k].compare_exchange_strong(v, version, std::memory_order_relaxed)) v = version;
+            if (v == version) {
+                bump(slot.version_requests[k], 1, exclusive);
+                return;
+            }
+        }
+        bump(slot.other_version_requests, 1, exclusive);
+    }
+
+    // 控制路径调用：记一次切换到 version（label 用于打印，如算子名）
+    void record_swap(uint64_t version, const std::string& label) {
+        SwapEvent event;
+        event.at_seconds = double(coarse_now_ns() - start_ns_) / 1e9;
+        event.second = int64_t(event.at_seconds);
+        event.version = version;
+        event.label = label;
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (SecondBucket* bucket = bucket_for(event.second)) bucket->swaps++;
+        if (swaps_.size() < kMaxSwapEvents) {
+            swaps_.push_back(event);
+        } else {
+            swaps_[swap_next_ % kMaxSwapEvents] = event;
+        }
+        swap_next_++;
+    }
+
+    // 把各分片槽自上次 collect 以来的增量并入环；当前秒的部分数据也会并入，之后的增量下次再补
+    void collect() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t s = 0; s < kMaxShards; ++s) {
+            Shard* shard = shards_[s].load(std::memory_order_acquire);
+            if (!shard) continue;
+            for (size_t i = 0; i < kShardSlots; ++i) collect_slot(shard->slots[i], &shard->flushed[i]);
+        }
+    }
+
+    // 后台每秒 collect 一次
+    void start() {
+        std::lock_guard<std::mutex> lock(thread_mutex_);
+        if (collector_.joinable()) return;
+        stopping_ = false;
+        collector_ = std::thread([this] {
+            std::unique_lock<std::mutex> wait_lock(thread_mutex_);
+            while (!stopping_) {
+                wait_lock.unlock();
+                collect();
+                wait_lock.lock();
+                wake_.wait_for(wait_lock, std::chrono::seconds(1), [this] { return stopping_; });
+            }
+        });
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(thread_mutex_);
+            if (!collector_.joinable()) return;
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        collector_.join();
+        collect();
+    }
+
+    // 聚合 [from_second, to_second)，只统计已结束且仍在保留期内的秒
+    WindowSummary summarize(int64_t from_second, int64_t to_second) {
+        collect();
+        WindowSummary summary;
+        const int64_t now = now_second();
+        summary.from_second = std::max(from_second, std::max<int64_t>(0, now - int64_t(ring_.size()) + 1));
+        summary.to_second = std::min(to_second, now);
+        if (summary.to_second <= summary.from_second) {
+            summary.to_second = summary.from_second;
+            return summary;
+        }
+        summary.seconds = size_t(summary.to_second - summary.from_second);
+
+        SecondBucket total;
+        std::vector<std::pair<uint64_t, uint64_t>> versions;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (int64_t t = summary.from_second; t < summary.to_second; ++t) {
+                const SecondBucket& b = ring_[size_t(t) % ring_.size()];
+                if (b.second != t) continue;
+                total.requests += b.requests;
+                total.latency_sum_ns += b.latency_sum_ns;
+                total.swaps += b.swaps;
+                for (size_t i = 0; i < timeseries_detail::kLatencyBuckets; ++i) total.latency[i] += b.latency[i];
+                for (size_t k = 0; k < timeseries_detail::kVersionSlots && b.version[k]; ++k) {
+                    add_count(&versions, b.version[k], b.version_requests[k]);
+                }
+                if (b.other_version_requests) add_count(&versions, 0, b.other_version_requests);
+            }
+        }
+        summary.requests = total.requests;
+        summary.swaps = total.swaps;
+        summary.qps = double(total.requests) / double(summary.seconds);
+        summary.versions = versions;
+        if (total.requests) {
+            summary.mean_us = double(total.latency_sum_ns) / double(total.requests) / 1000.0;
+            summary.p50_us = percentile_us(total, 0.50);
+            summary.p99_us = percentile_us(total, 0.99);
+        }
+        return summary;
+    }
+
+    // 保留期内的切换事件，按时间先后
+    std::vector<SwapEvent> swaps() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<SwapEvent> events;
+        const size_t count = std::min(swap_next_, size_t(kMaxSwapEvents));
+        const int64_t oldest = now_second() - int64_t(ring_.size()) + 1;
+        for (size_t i = swap_next_ - count; i < swap_next_; ++i) {
+            const SwapEvent& e = swaps_[i % kMaxSwapEvents];
+            if (e.second >= oldest) events.push_back(e);
+        }
+        return events;
+    }
+
+    // 切换所在秒前后各 window 秒的对比；切换所在的那一秒新旧版本混杂，两边都不算
+    SwapImpact compare_around(const SwapEvent& swap, int window) {
+        SwapImpact impact;
+        impact.swap = swap;
+        impact.before = summarize(swap.second - window, swap.second);
+        impact.after = summarize(swap.second + 1, swap.second + 1 + window);
+        return impact;
+    }
+
+    // 固定占用：环 + 已分配的分片
+    size_t memory_bytes() const {
+        size_t shards = 0;
+        for (const auto& shard : shards_) shards += shard.load(std::memory_order_relaxed) != nullptr;
+        return ring_.size() * sizeof(SecondBucket) + shards * sizeof(Shard);
+    }
+
+private:
+    // 分片里的一个秒槽。second 为 kResetting 时表示正在被轮转清零
+    struct ShardSlot {
+        std::atomic<int64_t> second{-1};
+        std::atomic<uint64_t> requests{0};
+        std::atomic<uint64_t> latency_sum_ns{0};
+        std::atomic<uint64_t> version[timeseries_detail::kVersionSlots];
+        std::atomic<uint64_t> version_requests[timeseries_detail::kVersionSlots];
+        std::atomic<uint64_t> other_version_requests{0};
+        std::atomic<uint64_t> latency[timeseries_detail::kLatencyBuckets];
+
+        ShardSlot() { clear(); }
+
+        void clear() {
+            requests.store(0, std::memory_order_relaxed);
+            latency_sum_ns.store(0, std::memory_order_relaxed);
+            other_version_requests.store(0, std::memory_order_relaxed);
+            for (auto& v : version) v.store(0, std::memory_order_relaxed);
+            for (auto& v : version_requests) v.store(0, std::memory_order_relaxed);
+            for (auto& v : latency) v.store(0, std::memory_order_relaxed);
+        }
+    };
+
+    struct Shard {
+        ShardSlot slots[kShardSlots];
+        SecondBucket flushed[kShardSlots];  // 各槽已并入环的部分，只由 collect 在 mutex_ 下读写
+    };
+
+    static constexpr int64_t kResetting = -2;
+
+    // 让 slot 属于 second：槽里还是 kShardSlots 秒之前的数据时先清零再改秒号。
+    // 返回 false 表示这次写入已经晚于槽的当前秒（线程被挂起了好几秒），直接丢弃
+    static bool enter(ShardSlot& slot, int64_t second) {
+        for (;;) {
+            int64_t current = slot.second.load(std::memory_order_acquire);
+            if (current == second) return true;
+            if (current > second) return false;
+            if (current == kResetting) {
+                std::this_thread::yield();
+                continue;
+            }
+            if (slot.second.compare_exchange_weak(current, kResetting, std::memory_order_acquire)) {
+                slot.clear();
+                slot.second.store(second, std::memory_order_release);
+                return true;
+            }
+        }
+    }
+
+    static void bump(std::atomic<uint64_t>& counter, uint64_t n, bool exclusive) {
+        if (exclusive) {
+            counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        } else {
+            counter.fetch_add(n, std::memory_order_relaxed);
+        }
+    }
+
+    Shard& local_shard(bool* exclusive) {
+        static thread_local timeseries_detail::ThreadShardIndex<kMaxShards - 1> thread_index;
+        const size_t index = thread_index.index;
+        *exclusive = index < kMaxShards - 1;
+        std::atomic<Shard*>& entry = shards_[index];
+        Shard* shard = entry.load(std::memory_order_acquire);
+        if (shard) return *shard;
+        Shard* fresh = new Shard();
+        if (entry.compare_exchange_strong(shard, fresh, std::memory_order_acq_rel)) return *fresh;
+        delete fresh;
+        return *shard;
+    }
+
+    // 调用方持有 mutex_。读数前后秒号不变才算数，期间被轮转就放弃这次读数
+    void collect_slot(const ShardSlot& slot, SecondBucket* flushed) {
+        const int64_t second = slot.second.load(std::memory_order_acquire);
+        if (second < 0) return;
+        SecondBucket snapshot;
+        snapshot.second = second;
+        snapshot.requests = slot.requests.load(std::memory_order_relaxed);
+        snapshot.latency_sum_ns = slot.latency_sum_ns.load(std::memory_order_relaxed);
+        snapshot.other_version_requests = slot.other_version_requests.load(std::memory_order_relaxed);
+        for (size_t k = 0; k < timeseries_detail::kVersionSlots; ++k) {
+            snapshot.version[k] = slot.version[k].load(std::memory_order_relaxed);
+            snapshot.version_requests[k] = slot.version_requests[k].load(std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < timeseries_detail::kLatencyBuckets; ++i) {
+            snapshot.latency[i] = slot.latency[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.second.load(std::memory_order_relaxed) != second) return;
+
+        if (flushed->second != second) *flushed = SecondBucket();  // 槽已轮转到新的一秒，从 0 算增量
+        SecondBucket* bucket = bucket_for(second);
+        if (bucket && snapshot.requests > flushed->requests) {
+            bucket->requests += snapshot.requests - flushed->requests;
+            bucket->latency_sum_ns += snapshot.latency_sum_ns - flushed->latency_sum_ns;
+            for (size_t i = 0; i < timeseries_detail::kLatencyBuckets; ++i) {
+                bucket->latency[i] += snapshot.latency[i] - flushed->latency[i];
+            }
+            for (size_t k = 0; k < timeseries_detail::kVersionSlots; ++k) {
+                if (snapshot.version[k] && snapshot.version_requests[k] > flushed->version_requests[k]) {
+                    bucket->add_version(snapshot.version[k], snapshot.version_requests[k] - flushed->version_requests[k]);
+                }
+            }
+            if (snapshot.other_version_requests > flushed->other_version_requests) {
+                bucket->other_version_requests += snapshot.other_version_requests - flushed->other_version_requests;
+            }
+        }
+        *flushed = snapshot;
+    }
+
+    // 调用方持有 mutex_。环里对应位置还是一小时前的桶时直接覆盖；比环里更旧的秒返回 nullptr
+    SecondBucket* bucket_for(int64_t second) {
+        SecondBucket& bucket = ring_[size_t(second) % ring_.size()];
+        if (bucket.second > second) return nullptr;
+        if (bucket.second != second) {
+            bucket = SecondBucket();
+            bucket.second = second;
+        }
+        return &bucket;
+    }
+
+    static void add_count(std::vector<std::pair<uint64_t, uint64_t>>* counts, uint64_t key, uint64_t n) {
+        for (auto& kv : *counts) {
+            if (kv.first == key) {
+                kv.second += n;
+                return;
+            }
+        }
+        counts->push_back(std::make_pair(key, n));
+    }
+
+    static double percentile_us(const SecondBucket& total, double q) {
+        const uint64_t rank = uint64_t(q * double(total.requests - 1));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < timeseries_detail::kLatencyBuckets; ++i) {
+            seen += total.latency[i];
+            if (seen > rank) {
+                double lo = double(timeseries_detail::latency_bucket_floor(i));
+                double hi = i + 1 < timeseries_detail::kLatencyBuckets
+                                ? double(timeseries_detail::latency_bucket_floor(i + 1))
+                                : lo;
+                return (lo + hi) / 2 / 1000.0;
+            }
+        }
+        return 0;
+    }
+
+    const int64_t start_ns_;
+    std::atomic<Shard*> shards_[kMaxShards];
+
+    std::mutex mutex_;  // 保护 ring_、各分片的 flushed 与切换事件
+    std::vector<SecondBucket> ring_;
+    std::vector<SwapEvent> swaps_;
+    size_t swap_next_ = 0;
+
+    std::mutex thread_mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+    std::thread collector_;
+};
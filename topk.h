@@ -0,0 +1,117 @@
+// topk.h
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "operator_interface.h"
+
+struct ScoredItem {
+    size_t index;  // 在候选数组中的下标
+    double score;
+};
+
+// 剪枝报告：省下了多少阶段计算，结果是否精确
+struct TopKReport {
+    size_t candidates = 0;
+    size_t pruned = 0;              // 中途被放弃的候选数
+    uint64_t stages_evaluated = 0;  // 实际执行的阶段数
+    uint64_t stages_total = 0;      // 不剪枝时需要执行的阶段数
+    bool exact = true;              // 有剪枝且观察到算子违反上界约定（上界回升或终分高于上界）时为 false
+
+    double work_saved() const {
+        return stages_total ? 1.0 - double(stages_evaluated) / double(stages_total) : 0.0;
+    }
+};
+
+// ---- 带阈值剪枝的 top-K 打分 ----
+// 先对全部候选跑阶段0拿到上界，按上界降序继续评估；
+// 堆满后，上界严格小于当前第K名分数的候选直接放弃。
+// 由于按上界降序处理，一旦某个候选的阶段0上界低于阈值，后面的候选全部可以放弃。
+// 返回结果按分数降序排列，分数集合与完整计算后取 top-K 一致（同分时的取舍可能不同）。
+inline std::vector<ScoredItem> score_topk(IScoreOperator* op, const std::vector<Feature>& candidates,
+                                          size_t k, TopKReport* report = nullptr) {
+    TopKReport local;
+    TopKReport& rep = report ? *report : local;
+    rep = TopKReport();
+    rep.candidates = candidates.size();
+
+    auto heap_cmp = [](const ScoredItem& a, const ScoredItem& b) { return a.score > b.score; };  // 小顶堆
+    std::vector<ScoredItem> heap;
+    if (!op || k == 0) return heap;
+    heap.reserve(k + 1);
+
+    auto offer = [&](size_t index, double score) {
+        if (heap.size() < k) {
+            heap.push_back(ScoredItem{index, score});
+            std::push_heap(heap.begin(), heap.end(), heap_cmp);
+        } else if (score > heap.front().score) {
+            std::pop_heap(heap.begin(), heap.end(), heap_cmp);
+            heap.back() = ScoredItem{index, score};
+            std::push_heap(heap.begin(), heap.end(), heap_cmp);
+        }
+    };
+
+    const int stages = op->num_stages();
+    if (stages <= 0) {
+        // 算子不支持分阶段评估：完整计算，不剪枝
+        rep.stages_total = rep.stages_evaluated = candidates.size();
+        for (size_t i = 0; i < candidates.size(); ++i) offer(i, op->compute_score(candidates[i]));
+    } else {
+        rep.stages_total = uint64_t(candidates.size()) * stages;
+
+        // 算子给出 NaN 上界时视为 +inf，永不剪枝；否则排序比较不满足严格弱序，剪枝也会悄悄失效
+        auto sane_bound = [](double ub) { return std::isnan(ub) ? std::numeric_limits<double>::infinity() : ub; };
+
+        // 阶段0：全部候选
+        std::vector<double> state(candidates.size());
+        std::vector<double> bound(candidates.size());
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            state[i] = op->evaluate_stage(candidates[i], 0, 0.0, &bound[i]);
+            bound[i] = sane_bound(bound[i]);
+        }
+        rep.stages_evaluated += candidates.size();
+
+        std::vector<size_t> order(candidates.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::stable_sort(order.begin(), order.end(),
+                         [&](size_t a, size_t b) { return bound[a] > bound[b]; });
+
+        // 完整算完的候选可以顺带检查上界约定：每阶段上界不回升、终分不超过上界。
+        // 违反约定时按上界剪掉的候选可能本该进 top-K，只要发生过剪枝结果就不可信
+        bool violated = false;
+        for (size_t pos = 0; pos < order.size(); ++pos) {
+            size_t i = order[pos];
+            if (heap.size() == k && bound[i] < heap.front().score) {
+                rep.pruned += order.size() - pos;  // 后面的上界只会更低
+                break;
+            }
+            double s = state[i];
+            double ub = bound[i];
+            int stage = 1;
+            for (; stage < stages; ++stage) {
+                const double prev_ub = ub;
+                s = op->evaluate_stage(candidates[i], stage, s, &ub);
+                ub = sane_bound(ub);
+                rep.stages_evaluated++;
+                if (ub > prev_ub) violated = true;
+                if (stage + 1 < stages && heap.size() == k && ub < heap.front().score) break;
+            }
+            if (stage < stages) {
+                rep.pruned++;
+                continue;
+            }
+            if (s > ub || s > bound[i]) violated = true;
+            offer(i, s);
+        }
+        rep.exact = !(violated && rep.pruned);
+    }
+
+    std::sort(heap.begin(), heap.end(), [](const ScoredItem& a, const ScoredItem& b) {
+        return a.score > b.score || (a.score == b.score && a.index < b.index);
+    });
+    return heap;
+}
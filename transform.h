@@ -0,0 +1,280 @@
+// transform.h
+#pragma once
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "feature_batch.h"
+#include "simd_util.h"
+
+// ---- 特征变换阶段 ----
+// 在算子运行前，按一份可热更新的 spec 对 FeatureBatch 逐列做变换，结果作为派生列追加到 batch 上。
+// spec 为文本，每行一条，按顺序执行（后面的变换可以引用前面产出的列）：
+//   <输出列> zscore    <输入列> <mean> <std>
+//   <输出列> log1p     <输入列>
+//   <输出列> bucketize <输入列> <b1,b2,...>      输出桶号 = 不大于 x 的边界个数
+//   <输出列> cross     <输入列A> <输入列B> <桶数>  哈希交叉，桶数向上取整到 2 的幂
+// 输入列可以是 user_id / item_id / user_feature / item_feature 或之前的派生列。
+
+enum class TransformKind { ZScore, Log1p, Bucketize, Cross };
+
+struct TransformStep {
+    TransformKind kind;
+    std::string output;
+    std::string input_a;
+    std::string input_b;              // 仅 cross
+    double mean = 0, inv_std = 1;     // 仅 zscore
+    std::vector<double> boundaries;   // 仅 bucketize，升序
+    uint32_t bucket_mask = 0;         // 仅 cross
+};
+
+struct TransformSpec {
+    std::string source;  // 来源文件，便于日志
+    std::vector<TransformStep> steps;
+};
+
+// ---- 解析 ----
+// 解析一个分桶边界：必须整段是有限数（空串、尾随字符、溢出、NaN 都算失败）
+inline bool parse_boundary(const std::string& item, std::vector<double>* out) {
+    const char* begin = item.c_str();
+    char* end = nullptr;
+    errno = 0;
+    double value = std::strtod(begin, &end);
+    if (end == begin || *end != '\0' || errno == ERANGE || !std::isfinite(value)) return false;
+    out->push_back(value);
+    return true;
+}
+
+inline std::shared_ptr<TransformSpec> parse_transform_spec(std::istream& in, const std::string& source) {
+    auto spec = std::make_shared<TransformSpec>();
+    spec->source = source;
+    std::string line;
+    int line_no = 0;
+    while (std::getline(in, line)) {
+        line_no++;
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.resize(hash);
+        std::istringstream ls(line);
+        TransformStep step;
+        std::string kind;
+        if (!(ls >> step.output)) continue;  // 空行
+        bool ok = bool(ls >> kind >> step.input_a);
+        if (ok && kind == "zscore") {
+            double stddev = 0;
+            ok = bool(ls >> step.mean >> stddev) && stddev > 0;
+            step.kind = TransformKind::ZScore;
+            step.inv_std = ok ? 1.0 / stddev : 1.0;
+        } else if (ok && kind == "log1p") {
+            step.kind = TransformKind::Log1p;
+        } else if (ok && kind == "bucketize") {
+            std::string list, item;
+            ok = bool(ls >> list);
+            std::istringstream ss(list);
+            while (ok && std::getline(ss, item, ',')) {
+                ok = parse_boundary(item, &step.boundaries);
+            }
+            ok = ok && !step.boundaries.empty() &&
+                 std::is_sorted(step.boundaries.begin(), step.boundaries.end());
+            step.kind = TransformKind::Bucketize;
+        } else if (ok && kind == "cross") {
+            uint64_t buckets = 0;
+            ok = bool(ls >> step.input_b >> buckets) && buckets > 0 && buckets <= (1u << 30);
+            uint32_t pow2 = 1;
+            while (ok && pow2 < buckets) pow2 <<= 1;
+            step.bucket_mask = pow2 - 1;
+            step.kind = TransformKind::Cross;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            std::cerr << "[Transform] " << source << ":" << line_no << " 无法解析: " << line << std::endl;
+            return nullptr;
+        }
+        spec->steps.push_back(step);
+    }
+    return spec;
+}
+
+inline std::shared_ptr<TransformSpec> load_transform_spec(const std::string& spec_file) {
+    std::ifstream in(spec_file);
+    if (!in) {
+        std::cerr << "[Transform] 无法打开: " << spec_file << std::endl;
+        return nullptr;
+    }
+    return parse_transform_spec(in, spec_file);
+}
+
+// ---- 列内核：标量版本与 AVX2 版本结果逐位一致 ----
+namespace transform_kernels {
+
+inline void zscore_scalar(const double* x, size_t n, double mean, double inv_std, double* out) {
+    for (size_t i = 0; i < n; ++i) out[i] = (x[i] - mean) * inv_std;
+}
+
+__attribute__((target("avx2")))
+inline void zscore_avx2(const double* x, size_t n, double mean, double inv_std, double* out) {
+    __m256d vm = _mm256_set1_pd(mean), vs = _mm256_set1_pd(inv_std);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d v = _mm256_loadu_pd(x + i);
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_sub_pd(v, vm), vs));
+    }
+    zscore_scalar(x + i, n - i, mean, inv_std, out + i);
+}
+
+// NaN 不大于也不小于任何边界，统一落在 0 号桶（与 AVX2 版有序比较全为假的结果一致）
+inline void bucketize_scalar(const double* x, size_t n, const std::vector<double>& b, double* out) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = std::isnan(x[i]) ? 0.0 : double(std::upper_bound(b.begin(), b.end(), x[i]) - b.begin());
+    }
+}
+
+// 边界不多时，对每个边界做一次向量比较并累加，避免逐元素二分的分支预测失败；
+// _CMP_GE_OQ 对 NaN 恒为假，NaN 得到 0 号桶
+__attribute__((target("avx2")))
+inline void bucketize_avx2(const double* x, size_t n, const std::vector<double>& b, double* out) {
+    const __m256d one = _mm256_set1_pd(1.0);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d v = _mm256_loadu_pd(x + i);
+        __m256d count = _mm256_setzero_pd();
+        for (double boundary : b) {
+            __m256d ge = _mm256_cmp_pd(v, _mm256_set1_pd(boundary), _CMP_GE_OQ);
+            count = _mm256_add_pd(count, _mm256_and_pd(ge, one));
+        }
+        _mm256_storeu_pd(out + i, count);
+    }
+    bucketize_scalar(x + i, n - i, b, out + i);
+}
+
+inline uint32_t cross_hash(uint32_t a, uint32_t b) {
+    uint32_t h = a * 0x9E3779B1u;
+    h ^= b + 0x7F4A7C15u + (h << 6) + (h >> 2);
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+inline void cross_scalar(const int32_t* a, const int32_t* b, size_t n, uint32_t mask, double* out) {
+    for (size_t i = 0; i < n; ++i) out[i] = double(cross_hash(uint32_t(a[i]), uint32_t(b[i])) & mask);
+}
+
+__attribute__((target("avx2")))
+inline void cross_avx2(const int32_t* a, const int32_t* b, size_t n, uint32_t mask, double* out) {
+    const __m256i golden = _mm256_set1_epi32(int(0x9E3779B1u));
+    const __m256i offset = _mm256_set1_epi32(0x7F4A7C15);
+    const __m256i m1 = _mm256_set1_epi32(int(0x85EBCA6Bu));
+    const __m256i m2 = _mm256_set1_epi32(int(0xC2B2AE35u));
+    const __m256i vmask = _mm256_set1_epi32(int(mask));
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(b + i));
+        __m256i h = _mm256_mullo_epi32(va, golden);
+        __m256i t = _mm256_add_epi32(_mm256_add_epi32(vb, offset),
+                                     _mm256_add_epi32(_mm256_slli_epi32(h, 6), _mm256_srli_epi32(h, 2)));
+        h = _mm256_xor_si256(h, t);
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+        h = _mm256_mullo_epi32(h, m1);
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 13));
+        h = _mm256_mullo_epi32(h, m2);
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+        h = _mm256_and_si256(h, vmask);  // mask < 2^31，转 double 时按有符号处理也不会出错
+        _mm256_storeu_pd(out + i, _mm256_cvtepi32_pd(_mm256_castsi256_si128(h)));
+        _mm256_storeu_pd(out + i + 4, _mm256_cvtepi32_pd(_mm256_extracti128_si256(h, 1)));
+    }
+    cross_scalar(a + i, b + i, n - i, mask, out + i);
+}
+
+}  // namespace transform_kernels
+
+// ---- 执行 ----
+// 取输入列：double 列直接返回指针；int 列转换到 scratch 中
+inline const double* transform_input(FeatureBatchBuffer& buf, const std::string& name,
+                                     std::vector<double>& scratch) {
+    // 被列裁剪掉的基础列视为不存在
+    auto from_ints = [&](const std::vector<int>& col) -> const double* {
+        if (col.size() != buf.size()) return nullptr;
+        scratch.assign(col.begin(), col.end());
+        return scratch.data();
+    };
+    auto doubles = [&](const std::vector<double>& col) -> const double* {
+        return col.size() == buf.size() ? col.data() : nullptr;
+    };
+    if (name == "user_feature") return doubles(buf.user_feature);
+    if (name == "item_feature") return doubles(buf.item_feature);
+    if (name == "user_id") return from_ints(buf.user_id);
+    if (name == "item_id") return from_ints(buf.item_id);
+    for (size_t i = 0; i < buf.extra_names.size(); ++i) {
+        if (buf.extra_names[i] == name) return buf.extra_values[i].data();
+    }
+    return nullptr;
+}
+
+inline const int32_t* transform_int_input(FeatureBatchBuffer& buf, const std::string& name,
+                                          std::vector<int32_t>& scratch) {
+    if (name == "user_id") return buf.user_id.size() == buf.size() ? buf.user_id.data() : nullptr;
+    if (name == "item_id") return buf.item_id.size() == buf.size() ? buf.item_id.data() : nullptr;
+    std::vector<double> tmp;
+    const double* col = transform_input(buf, name, tmp);
+    if (!col) return nullptr;
+    scratch.resize(buf.size());
+    // 与 bucketize 对 NaN 的处理一致：非有限值取 0，超出 int32 的截到边界，避免浮点转整数的未定义行为
+    for (size_t i = 0; i < scratch.size(); ++i) {
+        const double v = std::isfinite(col[i]) ? std::floor(col[i]) : 0.0;
+        scratch[i] = int32_t(std::min(std::max(v, double(INT32_MIN)), double(INT32_MAX)));
+    }
+    return scratch.data();
+}
+
+// 按 spec 逐列变换，派生列追加到 buffer。输入列不存在时返回 false（已产出的列保留）。
+inline bool apply_transforms(const TransformSpec& spec, FeatureBatchBuffer& buf) {
+    using namespace transform_kernels;
+    const bool avx2 = cpu_has_avx2();
+    const size_t n = buf.size();
+    std::vector<double> scratch;
+    std::vector<int32_t> scratch_a, scratch_b;
+
+    for (const TransformStep& step : spec.steps) {
+        // 先取输出列，add_column 可能使之前拿到的列指针失效
+        std::vector<double>& out = buf.add_column(step.output);
+        if (step.kind == TransformKind::Cross) {
+            const int32_t* a = transform_int_input(buf, step.input_a, scratch_a);
+            const int32_t* b = transform_int_input(buf, step.input_b, scratch_b);
+            if (!a || !b) return false;
+            (avx2 ? cross_avx2 : cross_scalar)(a, b, n, step.bucket_mask, out.data());
+            continue;
+        }
+        const double* x = transform_input(buf, step.input_a, scratch);
+        if (!x) return false;
+        switch (step.kind) {
+        case TransformKind::ZScore:
+            (avx2 ? zscore_avx2 : zscore_scalar)(x, n, step.mean, step.inv_std, out.data());
+            break;
+        case TransformKind::Log1p:
+            for (size_t i = 0; i < n; ++i) out[i] = std::log1p(std::max(x[i], 0.0));
+            break;
+        case TransformKind::Bucketize:
+            if (avx2 && step.boundaries.size() <= 64) bucketize_avx2(x, n, step.boundaries, out.data());
+            else bucketize_scalar(x, n, step.boundaries, out.data());
+            break;
+        default:
+            break;
+        }
+    }
+    return true;
+}
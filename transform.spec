@@ -0,0 +1,6 @@
+# 特征变换 spec：<输出列> <变换> <参数...>，按顺序执行
+user_feature_z  zscore     user_feature  0.5  0.3
+item_feature_z  zscore     item_feature  1.0  0.6
+item_feature_l  log1p      item_feature
+item_bucket     bucketize  item_feature  0.1,0.25,0.5,1.0,1.5,2.0
+user_x_bucket   cross      user_id       item_bucket  1024
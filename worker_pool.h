@@ -0,0 +1,252 @@
+// worker_pool.h
+#pragma once
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <immintrin.h>
+
+// ---- 弹性工作线程池 ----
+// 线程数在 [min_workers, max_workers] 之间随负载伸缩：
+//   扩容：提交任务时醒着的空闲线程取不完队列，且多出的积压到 scale_up_depth 或排队等待 EWMA 超过 target_wait_us，
+//         就唤醒一个停车的线程，没有停车的就新建一个；一个线程都没醒时总会唤醒一个。
+//   空闲：线程取不到任务先自旋 spin_us，再在自己的 futex 字上停车，不占 CPU；唤醒只是一次 FUTEX_WAKE。
+//   缩容：停车超过 idle_exit_ms 没被叫醒且线程数 > min_workers 的线程退出。
+// 低流量时只有一两个线程在转，突发时每个提交都可能再拉起一个线程，几毫秒内到达 max_workers。
+
+struct WorkerPoolOptions {
+    size_t min_workers = 1;
+    size_t max_workers = 4;
+    size_t scale_up_depth = 2;      // 醒着的线程取不完、多出的积压到这么多时扩容
+    uint32_t target_wait_us = 200;  // 排队等待 EWMA 超过它时扩容
+    uint32_t spin_us = 20;          // 空闲后停车前的自旋时间，单核机器上自动置 0
+    uint32_t idle_exit_ms = 1000;   // 停车超过这么久的多余线程退出；停车本身不占 CPU，这里只是归还线程栈
+};
+
+struct WorkerPoolStats {
+    size_t workers = 0;  // 存活线程数
+    size_t awake = 0;    // 未停车的线程数
+    size_t running = 0;  // 正在执行任务的线程数
+    size_t queued = 0;
+    size_t peak_workers = 0;
+    uint64_t spawned = 0;
+    uint64_t exited = 0;
+    uint64_t wakeups = 0;  // FUTEX_WAKE 次数
+    uint64_t completed = 0;
+    double queue_wait_ewma_us = 0;
+};
+
+class ElasticWorkerPool {
+public:
+    explicit ElasticWorkerPool(const WorkerPoolOptions& options = WorkerPoolOptions()) : options_(options) {
+        options_.max_workers = std::max<size_t>(1, options_.max_workers);
+        options_.min_workers = std::min(options_.min_workers, options_.max_workers);
+        if (std::thread::hardware_concurrency() <= 1) options_.spin_us = 0;  // 单核上自旋只会拖住提交方
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < options_.min_workers; ++i) spawn_locked();
+    }
+
+    // 排空队列后停止所有线程
+    ~ElasticWorkerPool() {
+        std::vector<Worker*> parked;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+            parked.swap(parked_);
+            for (Worker* w : parked) claim_locked(w);
+        }
+        for (Worker* w : parked) unpark(w);
+        for (auto& w : workers_) {
+            if (w->thread.joinable()) w->thread.join();
+        }
+    }
+
+    ElasticWorkerPool(const ElasticWorkerPool&) = delete;
+    ElasticWorkerPool& operator=(const ElasticWorkerPool&) = delete;
+
+    void submit(std::function<void()> fn) {
+        Worker* wake = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(Task{std::move(fn), std::chrono::steady_clock::now()});
+            depth_.store(queue_.size(), std::memory_order_relaxed);
+            if (!need_worker_locked()) return;
+            if (!parked_.empty()) {
+                wake = parked_.back();  // 最近停车的线程栈和缓存最热
+                parked_.pop_back();
+                claim_locked(wake);
+                wakeups_++;
+            } else if (alive_ < options_.max_workers) {
+                reap_locked();
+                spawn_locked();
+            }
+        }
+        if (wake) unpark(wake);
+    }
+
+    // 等到队列为空且没有任务在执行
+    void wait_idle() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [&] { return queue_.empty() && running_ == 0; });
+    }
+
+    WorkerPoolStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        WorkerPoolStats s;
+        s.workers = alive_;
+        s.awake = awake_;
+        s.running = running_;
+        s.queued = queue_.size();
+        s.peak_workers = peak_;
+        s.spawned = spawned_;
+        s.exited = exited_;
+        s.wakeups = wakeups_;
+        s.completed = completed_;
+        s.queue_wait_ewma_us = wait_ewma_us_;
+        return s;
+    }
+
+    const WorkerPoolOptions& options() const { return options_; }
+
+private:
+    struct Task {
+        std::function<void()> fn;
+        std::chrono::steady_clock::time_point enqueued;
+    };
+
+    struct Worker {
+        std::atomic<int> futex_word{0};  // 0：停车中；1：已被提交方领走并唤醒
+        std::thread thread;
+        bool exited = false;
+    };
+
+    static long futex(std::atomic<int>* word, int op, int value, const timespec* timeout) {
+        return syscall(SYS_futex, reinterpret_cast<int*>(word), op, value, timeout, nullptr, 0);
+    }
+
+    // 领走一个已出栈的停车线程。标记在锁内写，停车方超时醒来后在锁内看到 1 就知道已被领走，
+    // 不会再去 parked_ 里找自己；真正的 FUTEX_WAKE 放到锁外
+    void claim_locked(Worker* w) {
+        w->futex_word.store(1, std::memory_order_relaxed);
+        awake_++;
+    }
+
+    static void unpark(Worker* w) { futex(&w->futex_word, FUTEX_WAKE_PRIVATE, 1, nullptr); }
+
+    // 调用方持有 mutex_，任务已入队
+    // 醒着的空闲线程（含刚被唤醒、还没排上 CPU 的）各自会取走一个任务，只有超出它们的积压才算数
+    bool need_worker_locked() const {
+        if (awake_ == 0) return true;
+        const size_t idle = awake_ - running_;
+        if (queue_.size() <= idle) return false;
+        return queue_.size() - idle >= options_.scale_up_depth || wait_ewma_us_ >= options_.target_wait_us;
+    }
+
+    void spawn_locked() {
+        workers_.emplace_back(new Worker());
+        Worker* w = workers_.back().get();
+        alive_++;
+        awake_++;
+        spawned_++;
+        peak_ = std::max(peak_, alive_);
+        w->thread = std::thread([this, w] { run(w); });
+    }
+
+    // 回收已退出的线程对象
+    void reap_locked() {
+        for (size_t i = 0; i < workers_.size();) {
+            if (workers_[i]->exited) {
+                workers_[i]->thread.join();
+                workers_[i] = std::move(workers_.back());
+                workers_.pop_back();
+            } else {
+                ++i;
+            }
+        }
+    }
+
+    void run(Worker* w) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            if (!queue_.empty()) {
+                Task task = std::move(queue_.front());
+                queue_.pop_front();
+                depth_.store(queue_.size(), std::memory_order_relaxed);
+                double waited = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() -
+                                                                          task.enqueued).count();
+                wait_ewma_us_ = wait_ewma_us_ * 0.9 + waited * 0.1;
+                running_++;
+                lock.unlock();
+                task.fn();
+                lock.lock();
+                running_--;
+                completed_++;
+                if (queue_.empty() && running_ == 0) idle_.notify_all();
+                continue;
+            }
+            if (stopping_) break;
+
+            // 先不持锁自旋一小会儿，紧接着到来的任务不必付一次停车 + 唤醒
+            if (options_.spin_us) {
+                lock.unlock();
+                auto spin_end = std::chrono::steady_clock::now() + std::chrono::microseconds(options_.spin_us);
+                while (depth_.load(std::memory_order_relaxed) == 0 && std::chrono::steady_clock::now() < spin_end) {
+                    _mm_pause();
+                }
+                lock.lock();
+                if (!queue_.empty() || stopping_) continue;
+            }
+
+            w->futex_word.store(0, std::memory_order_relaxed);
+            parked_.push_back(w);
+            awake_--;
+            lock.unlock();
+            timespec timeout = {time_t(options_.idle_exit_ms / 1000), long(options_.idle_exit_ms % 1000) * 1000000};
+            futex(&w->futex_word, FUTEX_WAIT_PRIVATE, 0, &timeout);
+            lock.lock();
+            if (w->futex_word.load(std::memory_order_relaxed) == 1) continue;  // 已被领走：移出了 parked_ 并计入 awake_
+
+            // 超时（或被信号打断）且没人领走：自己出栈；线程多于下限时退出
+            parked_.erase(std::find(parked_.begin(), parked_.end(), w));
+            awake_++;
+            if (alive_ > options_.min_workers && !stopping_) break;
+        }
+        alive_--;
+        awake_--;
+        exited_++;
+        w->exited = true;
+    }
+
+    WorkerPoolOptions options_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable idle_;
+    std::deque<Task> queue_;
+    std::atomic<size_t> depth_{0};  // queue_.size() 的无锁副本，供自旋时查看
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<Worker*> parked_;
+    size_t alive_ = 0;
+    size_t awake_ = 0;
+    size_t running_ = 0;
+    size_t peak_ = 0;
+    uint64_t spawned_ = 0;
+    uint64_t exited_ = 0;
+    uint64_t wakeups_ = 0;
+    uint64_t completed_ = 0;
+    double wait_ewma_us_ = 0;
+    bool stopping_ = false;
+};